@@ -0,0 +1,155 @@
+// Frustum culling microbenchmark.
+//
+//   cull_bench [--objects n] [--views n]
+//
+// Scatters n bounding spheres (default 100000) over a square field the way
+// the scene scatters its items, then culls them for a number of camera
+// views: one Frustum::testSphere per object, testSpheres4 over four at a
+// time, and a Bvh.  The times are the best of each view, averaged over
+// the views.  The Bvh's result is checked against the brute force one.  The
+// BVH build, and a refit after every object moved, are timed as well.
+// Needs no GL context.
+
+#include "helper/bvh.h"
+#include "helper/frustum.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+    const int REPEAT = 5;
+
+    // Best of REPEAT runs, in milliseconds
+    double timeBest(const std::function<void()> &fn) {
+        double best = 1e30;
+        for (int i = 0; i < REPEAT; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // Spheres as separate arrays, padded to a multiple of four with spheres
+    // that can never be visible
+    struct SphereLanes {
+        std::vector<float> x, y, z, radius;
+    };
+
+    SphereLanes lanes(const std::vector<glm::vec4> &spheres) {
+        SphereLanes result;
+        size_t padded = (spheres.size() + 3) / 4 * 4;
+        result.x.assign(padded, 0.0f);
+        result.y.assign(padded, 0.0f);
+        result.z.assign(padded, 0.0f);
+        result.radius.assign(padded, -1e30f);
+        for (size_t i = 0; i < spheres.size(); i++) {
+            result.x[i] = spheres[i].x;
+            result.y[i] = spheres[i].y;
+            result.z[i] = spheres[i].z;
+            result.radius[i] = spheres[i].w;
+        }
+        return result;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int objects = 100000, views = 16;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            objects = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--views") == 0 && i + 1 < argc) {
+            views = std::max(1, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "Usage: %s [--objects n] [--views n]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // A field that grows with the count, so density stays that of --items
+    std::mt19937 random(1);
+    float half = 20.0f * std::sqrt(objects / 2000.0f);
+    std::uniform_real_distribution<float> position(-half, half), height(0.0f, 4.0f), size(0.2f, 1.0f);
+    std::vector<glm::vec4> spheres(objects);
+    for (glm::vec4 &sphere : spheres)
+        sphere = glm::vec4(position(random), height(random), position(random), size(random));
+    SphereLanes soa = lanes(spheres);
+
+    Bvh bvh;
+    double buildMs = timeBest([&]() { bvh.build(spheres); });
+    printf("%d spheres over %.0f x %.0f; BVH of %zu nodes built in %.2f ms\n",
+           objects, 2.0f * half, 2.0f * half, bvh.nodeCount(), buildMs);
+
+    double scalarMs = 0.0, simdMs = 0.0, bvhMs = 0.0;
+    size_t visibleTotal = 0, mismatches = 0;
+    Bvh::Stats stats, statsTotal;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    for (int view = 0; view < views; view++) {
+        glm::vec3 eye(position(random), 1.5f, position(random));
+        float yaw = angle(random);
+        glm::mat4 lookAt = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), -0.1f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum = Frustum::fromMatrix(projection * lookAt);
+
+        std::vector<uint32_t> reference, simd, tree;
+        scalarMs += timeBest([&]() {
+            reference.clear();
+            for (size_t i = 0; i < spheres.size(); i++) {
+                if (frustum.testSphere(glm::vec3(spheres[i]), spheres[i].w))
+                    reference.push_back((uint32_t)i);
+            }
+        });
+        simdMs += timeBest([&]() {
+            simd.clear();
+            for (size_t i = 0; i < soa.x.size(); i += 4) {
+                unsigned hits = frustum.testSpheres4(&soa.x[i], &soa.y[i], &soa.z[i], &soa.radius[i]);
+                for (unsigned lane = 0; lane < 4; lane++) {
+                    if (hits & (1u << lane))
+                        simd.push_back((uint32_t)(i + lane));
+                }
+            }
+        });
+        bvhMs += timeBest([&]() {
+            tree.clear();
+            bvh.cull(frustum, tree, &stats);
+        });
+
+        std::sort(tree.begin(), tree.end());
+        mismatches += simd != reference;
+        mismatches += tree != reference;
+        visibleTotal += reference.size();
+        statsTotal.nodes += stats.nodes;
+        statsTotal.leaves += stats.leaves;
+        statsTotal.accepted += stats.accepted;
+    }
+
+    printf("%d views, %.0f visible on average\n", views, (double)visibleTotal / views);
+    printf("  %-24s %8.3f ms\n", "testSphere, each", scalarMs / views);
+    printf("  %-24s %8.3f ms %6.1fx\n", "testSpheres4, each", simdMs / views, scalarMs / simdMs);
+    printf("  %-24s %8.3f ms %6.1fx  (%d nodes, %d leaves tested, %d taken whole per view)\n", "Bvh::cull", bvhMs / views,
+           scalarMs / bvhMs, statsTotal.nodes / views, statsTotal.leaves / views, statsTotal.accepted / views);
+
+    // Every object moves a little, as if the whole field were animated
+    std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+    for (size_t i = 0; i < spheres.size(); i++)
+        bvh.update(i, spheres[i] + glm::vec4(nudge(random), 0.0f, nudge(random), 0.0f));
+    auto start = std::chrono::steady_clock::now();
+    bvh.refit();
+    double refitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Refit after moving every sphere: %.2f ms\n", refitMs);
+
+    if (mismatches > 0) {
+        fprintf(stderr, "%zu culled lists differ from testSphere's\n", mismatches);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
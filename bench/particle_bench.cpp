@@ -0,0 +1,159 @@
+// CPU particle update microbenchmark.
+//
+//   particle_bench [--steps n] [count...]
+//
+// Advances rings of 10k, 100k and 1M particles (or the given counts) for a
+// number of steps (default 30) the way the scene's ring moves, with
+// lifetimes spread out so some particles respawn every step.  The old
+// update, a loop over an array of Particle structures that builds a
+// rotation matrix, a normalize and a cross product per particle, is timed
+// against CpuParticles with its scalar, SSE2 and AVX2 kernels, on one
+// thread and on a ThreadPool.  The CpuParticles paths also write every
+// vertex out, as they do into the mapped buffer in the demo.  Every path's
+// positions are compared with the old loop's.  Needs no GL context.
+
+#include "helper/cpuparticles.h"
+#include "helper/threadpool.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+    const float DELTA_TIME = 1.0f / 60.0f;
+
+    // The scene's ring, with lives short enough to respawn during the run
+    ParticleSystem::Settings settings() {
+        ParticleSystem::Settings s;
+        s.emitterPosition = glm::vec3(8.0f, 0.0f, 0.0f);
+        s.emitterRadius = 5.0f;
+        s.speed = 3.0f;
+        s.lifeDecay = 2.0f;
+        s.rotationSpeed = 1.0f;
+        return s;
+    }
+
+    std::vector<ParticleSystem::Particle> startingRing(size_t count) {
+        std::vector<ParticleSystem::Particle> particles = ParticleSystem::ring(count, settings(), 1.5f);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> life(0.0f, 1.0f);
+        for (ParticleSystem::Particle &p : particles)
+            p.life = life(random);
+        return particles;
+    }
+
+    // The update as it was, over the mapped buffer
+    void oldUpdate(std::vector<ParticleSystem::Particle> &particles, const ParticleSystem::Settings &s) {
+        int particleCount = (int)particles.size();
+        for (int i = 0; i < particleCount; i++) {
+            float angle = s.rotationSpeed * DELTA_TIME;
+            glm::mat3 rotationMatrix = glm::mat3(
+                cos(angle), 0.0f, sin(angle),
+                0.0f, 1.0f, 0.0f,
+                -sin(angle), 0.0f, cos(angle)
+            );
+            particles[i].position = s.emitterPosition + rotationMatrix * (particles[i].position - s.emitterPosition);
+            glm::vec3 direction = glm::normalize(particles[i].position - s.emitterPosition);
+            particles[i].velocity = glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)) * s.speed;
+            particles[i].life -= s.lifeDecay * DELTA_TIME;
+            if (particles[i].life <= 0.0f) {
+                float theta = glm::radians(360.0f * (float(i) / float(particleCount)));
+                particles[i].position = s.emitterPosition + glm::vec3(s.emitterRadius * cos(theta), 0.0f, s.emitterRadius * sin(theta));
+                direction = glm::normalize(particles[i].position - s.emitterPosition);
+                particles[i].velocity = glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)) * s.speed;
+                particles[i].life = 1.0f;
+            }
+        }
+    }
+
+    double milliseconds(const std::function<void()> &fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    float maxDifference(const std::vector<ParticleSystem::Particle> &a, const std::vector<ParticleSystem::Particle> &b) {
+        float worst = 0.0f;
+        for (size_t i = 0; i < a.size(); i++)
+            worst = std::max(worst, glm::length(a[i].position - b[i].position));
+        return worst;
+    }
+
+    bool run(size_t count, int steps, ThreadPool &pool) {
+        ParticleSystem::Settings s = settings();
+        printf("%zu particles, %d steps\n", count, steps);
+
+        std::vector<ParticleSystem::Particle> reference = startingRing(count);
+        double oldMs = milliseconds([&]() {
+            for (int step = 0; step < steps; step++)
+                oldUpdate(reference, s);
+        }) / steps;
+        printf("  %-24s %8.3f ms/step\n", "array of structures", oldMs);
+
+        std::vector<CpuParticles::Vertex> vertices(count);
+        bool ok = true;
+        for (int simd = CpuFeatures::SIMD_SCALAR; simd <= (int)CpuFeatures::supported(); simd++) {
+            for (ThreadPool *threads : { (ThreadPool *)nullptr, &pool }) {
+                CpuParticles particles;
+                particles.setSimd((CpuFeatures::Simd)simd);
+                particles.create(startingRing(count));
+                double ms = milliseconds([&]() {
+                    for (int step = 0; step < steps; step++)
+                        particles.update(threads, DELTA_TIME, s, vertices.data());
+                }) / steps;
+
+                float difference = maxDifference(particles.particles(), reference);
+                bool vertexMismatch = false;
+                std::vector<ParticleSystem::Particle> last = particles.particles();
+                for (size_t i = 0; i < count; i++)
+                    vertexMismatch = vertexMismatch || vertices[i].position != last[i].position || vertices[i].size != last[i].size;
+                ok = ok && difference < 1e-3f && !vertexMismatch;
+
+                char name[64];
+                snprintf(name, sizeof(name), "%s, %s", CpuFeatures::name((CpuFeatures::Simd)simd), threads ? "pool" : "one thread");
+                printf("  %-24s %8.3f ms/step %6.1fx  max diff %.2g%s\n", name, ms, oldMs / ms, difference,
+                       vertexMismatch ? "  VERTICES DIFFER" : "");
+            }
+        }
+        printf("\n");
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int steps = 30;
+    std::vector<size_t> counts;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = std::max(1, atoi(argv[++i]));
+        } else if (argv[i][0] != '-' && atoi(argv[i]) > 0) {
+            counts.push_back((size_t)atoi(argv[i]));
+        } else {
+            fprintf(stderr, "Usage: %s [--steps n] [count...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (counts.empty())
+        counts = { 10000, 100000, 1000000 };
+
+    ThreadPool pool;
+    printf("Kernels up to %s; pool of %u workers plus the calling thread\n\n",
+           CpuFeatures::name(CpuFeatures::supported()), pool.size());
+    bool ok = true;
+    for (size_t count : counts)
+        ok = run(count, steps, pool) && ok;
+    if (!ok) {
+        fprintf(stderr, "Some paths differ from the array of structures loop\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+// Image resampler microbenchmark.
+//
+//   resample_bench [--repeat n] [image...]
+//
+// Times a 2x reduction (one mip step) and a full mip chain of each image,
+// the demo's textures by default, with the bundled stb_image_resize
+// (stbir_resize_uint8, one thread) and with ImageResampler's scalar, SSE2
+// and AVX2 kernels, on one thread and on a ThreadPool.  Every path's output
+// is compared with stbir's.  A Catmull-Rom and an sRGB reduction are timed
+// with the widest kernels as well.  The first image's first channel, cut to
+// an odd width, is run as a single-channel image too, since those rows end
+// in pixels the packed kernels have to decode one at a time.  Needs no GL context; run it from the
+// build directory, where the media has been copied.
+
+#include "helper/imageresampler.h"
+#include "helper/threadpool.h"
+#include "helper/stb_image.h"
+#include "stb_image_resize.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Image {
+        std::string name;
+        int width, height, channels;
+        std::vector<unsigned char> pixels;
+    };
+
+    // Best of n runs, in milliseconds
+    double timeBest(int repeat, const std::function<void()> &fn) {
+        double best = 1e30;
+        for (int i = 0; i < repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    int maxDifference(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b) {
+        int result = 0;
+        for (size_t i = 0; i < a.size() && i < b.size(); i++)
+            result = std::max(result, std::abs(a[i] - b[i]));
+        return result;
+    }
+
+    void report(const char *path, double halfMs, double chainMs, int difference, const Image &image, double referenceMs) {
+        double megapixels = (double)image.width * image.height / 1e6;
+        printf("  %-22s %8.2f ms %8.1f MP/s %8.2f ms chain %6.1fx  max diff %d\n",
+               path, halfMs, megapixels / (halfMs / 1000.0), chainMs, referenceMs / halfMs, difference);
+    }
+
+    // The first channel of image, one column narrower if its width is even
+    Image singleChannel(const Image &image) {
+        Image result;
+        result.name = image.name + " (1 channel)";
+        result.width = std::max(1, image.width - (image.width % 2 == 0 ? 1 : 0));
+        result.height = image.height;
+        result.channels = 1;
+        result.pixels.resize((size_t)result.width * result.height);
+        for (int y = 0; y < result.height; y++) {
+            for (int x = 0; x < result.width; x++)
+                result.pixels[(size_t)y * result.width + x] = image.pixels[((size_t)y * image.width + x) * image.channels];
+        }
+        return result;
+    }
+
+    void run(const Image &image, ThreadPool &pool, int repeat) {
+        int w = std::max(1, image.width / 2), h = std::max(1, image.height / 2);
+        std::vector<ImageResampler::Level> levels = ImageResampler::mipLevels(image.width, image.height, image.channels);
+        std::vector<unsigned char> chain(levels.back().offset + levels.back().size);
+        memcpy(chain.data(), image.pixels.data(), levels[0].size);
+
+        printf("%s: %dx%d, %d channels\n", image.name.c_str(), image.width, image.height, image.channels);
+
+        std::vector<unsigned char> reference((size_t)w * h * image.channels);
+        double referenceMs = timeBest(repeat, [&]() {
+            stbir_resize_uint8(image.pixels.data(), image.width, image.height, 0, reference.data(), w, h, 0, image.channels);
+        });
+        double referenceChainMs = timeBest(repeat, [&]() {
+            for (size_t i = 1; i < levels.size(); i++)
+                stbir_resize_uint8(chain.data() + levels[i - 1].offset, levels[i - 1].width, levels[i - 1].height, 0,
+                                   chain.data() + levels[i].offset, levels[i].width, levels[i].height, 0, image.channels);
+        });
+        report("stbir_resize_uint8", referenceMs, referenceChainMs, 0, image, referenceMs);
+
+        std::vector<unsigned char> output(reference.size());
+        CpuFeatures::Simd widest = CpuFeatures::supported();
+        for (int simd = CpuFeatures::SIMD_SCALAR; simd <= widest; simd++) {
+            ImageResampler::setSimd((CpuFeatures::Simd)simd);
+            for (ThreadPool *threads : { (ThreadPool *)nullptr, &pool }) {
+                double ms = timeBest(repeat, [&]() {
+                    ImageResampler::resize(threads, image.pixels.data(), image.width, image.height, output.data(), w, h, image.channels, false);
+                });
+                double chainMs = timeBest(repeat, [&]() {
+                    ImageResampler::generateMips(threads, chain.data(), levels, image.channels, false);
+                });
+                std::string path = std::string(CpuFeatures::name((CpuFeatures::Simd)simd)) +
+                                   (threads ? ", " + std::to_string(pool.size() + 1) + " threads" : ", 1 thread");
+                report(path.c_str(), ms, chainMs, maxDifference(output, reference), image, referenceMs);
+            }
+        }
+
+        // Other filters with the widest kernels, on the pool
+        ImageResampler::setSimd(widest);
+        double catmullRomMs = timeBest(repeat, [&]() {
+            ImageResampler::resize(&pool, image.pixels.data(), image.width, image.height, output.data(), w, h,
+                                   image.channels, false, ImageResampler::FILTER_CATMULL_ROM);
+        });
+        double srgbMs = timeBest(repeat, [&]() {
+            ImageResampler::resize(&pool, image.pixels.data(), image.width, image.height, output.data(), w, h, image.channels, true);
+        });
+        stbir_resize_uint8_srgb(image.pixels.data(), image.width, image.height, 0, reference.data(), w, h, 0, image.channels);
+        printf("  Catmull-Rom %.2f ms, sRGB box %.2f ms, max diff %d from stbir sRGB (%s, pool)\n\n",
+               catmullRomMs, srgbMs, maxDifference(output, reference), CpuFeatures::name(widest));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int repeat = 5;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--repeat n] [image...]\n", argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty())
+        files = { "media/textures/wood.png", "media/textures/Candy.png", "media/textures/skybox/px.png" };
+
+    ThreadPool pool;
+    printf("Kernels: %s; pool of %u workers plus the calling thread; best of %d\n\n",
+           CpuFeatures::name(CpuFeatures::supported()), pool.size(), repeat);
+    for (const std::string &file : files) {
+        Image image;
+        image.name = file;
+        unsigned char *data = stbi_load(file.c_str(), &image.width, &image.height, &image.channels, 0);
+        if (!data) {
+            fprintf(stderr, "%s: %s\n", file.c_str(), stbi_failure_reason());
+            return EXIT_FAILURE;
+        }
+        image.pixels.assign(data, data + (size_t)image.width * image.height * image.channels);
+        stbi_image_free(data);
+        run(image, pool, repeat);
+        if (&file == &files.front() && image.channels > 1)
+            run(singleChannel(image), pool, repeat);
+    }
+    return EXIT_SUCCESS;
+}
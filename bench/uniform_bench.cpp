@@ -0,0 +1,209 @@
+// Uniform lookup microbenchmark.
+//
+//   uniform_bench [frames]
+//
+// Sets a program with the lit pass's original thirteen per-frame uniforms
+// (before camera, light and material data moved into uniform buffers) the
+// three ways GLSLProgram has supported them: the old std::map<std::string, int>
+// cache, the hashed name lookup behind setUniform(const char *), and handles
+// resolved once after linking.  Each is timed for the lookup alone and for
+// lookup plus the glUniform call.  As in the scene, the matrices and vectors
+// change every frame while the samplers and material constants do not, so
+// the GLSLProgram paths also show what the shadow copy skips.
+
+#include "helper/scenerunner.h"
+#include "helper/glslprogram.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+namespace {
+
+    const char *const VERTEX_SOURCE = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        uniform mat4 model;
+        uniform mat4 projection;
+        uniform mat4 view;
+        uniform mat4 lightSpaceMatrix;
+        out vec4 lightSpacePos;
+        void main() {
+            lightSpacePos = lightSpaceMatrix * model * vec4(aPos, 1.0);
+            gl_Position = projection * view * model * vec4(aPos, 1.0);
+        }
+    )";
+
+    const char *const FRAGMENT_SOURCE = R"(
+        #version 330 core
+        struct Material { vec3 specular; float shininess; };
+        uniform Material material;
+        uniform sampler2D ballTexture;
+        uniform samplerCube skybox;
+        uniform sampler2D shadowMap;
+        uniform vec3 lightPos;
+        uniform vec3 viewPos;
+        uniform vec3 overrideColor;
+        uniform float reflectivity;
+        in vec4 lightSpacePos;
+        out vec4 FragColor;
+        void main() {
+            vec3 c = texture(ballTexture, lightSpacePos.xy).rgb + texture(skybox, lightPos).rgb * reflectivity
+                   + texture(shadowMap, viewPos.xy).r * overrideColor + material.specular * material.shininess;
+            FragColor = vec4(c, 1.0);
+        }
+    )";
+
+    // The names render() used to set on the lit program every frame, in order
+    const char *const LIT_UNIFORMS[] = {
+        "projection", "view", "viewPos", "lightPos", "lightSpaceMatrix",
+        "shadowMap", "skybox", "overrideColor", "material.specular",
+        "material.shininess", "reflectivity", "model", "ballTexture"
+    };
+    const int LIT_UNIFORM_COUNT = sizeof(LIT_UNIFORMS) / sizeof(LIT_UNIFORMS[0]);
+
+    volatile GLint sink;
+
+    template <typename Fn>
+    double timeNs(int frames, Fn fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++)
+            fn();
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / ((double)frames * LIT_UNIFORM_COUNT);
+    }
+
+    void report(const char *name, double ns, double baseline) {
+        printf("  %-22s %8.2f ns/uniform  %6.2fx\n", name, ns, baseline / ns);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 200000;
+    if (frames <= 0) frames = 200000;
+
+    SceneRunner runner("uniform_bench", 64, 64, 0, true);
+
+    GLSLProgram prog;
+    try {
+        prog.compileShader(std::string(VERTEX_SOURCE), GLSLShader::VERTEX);
+        prog.compileShader(std::string(FRAGMENT_SOURCE), GLSLShader::FRAGMENT);
+        prog.link();
+        prog.use();
+    }
+    catch (GLSLProgramException &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    // What GLSLProgram used to keep
+    std::map<std::string, int> locationMap;
+    for (const char *name : LIT_UNIFORMS)
+        locationMap[name] = glGetUniformLocation(prog.getHandle(), name);
+
+    glm::mat4 m(1.0f);
+    glm::vec3 v(0.5f);
+
+    UniformHandle<glm::mat4> projection = prog.uniform<glm::mat4>("projection");
+    UniformHandle<glm::mat4> view = prog.uniform<glm::mat4>("view");
+    UniformHandle<glm::vec3> viewPos = prog.uniform<glm::vec3>("viewPos");
+    UniformHandle<glm::vec3> lightPos = prog.uniform<glm::vec3>("lightPos");
+    UniformHandle<glm::mat4> lightSpaceMatrix = prog.uniform<glm::mat4>("lightSpaceMatrix");
+    UniformHandle<int> shadowMap = prog.uniform<int>("shadowMap");
+    UniformHandle<int> skybox = prog.uniform<int>("skybox");
+    UniformHandle<glm::vec3> overrideColor = prog.uniform<glm::vec3>("overrideColor");
+    UniformHandle<glm::vec3> materialSpecular = prog.uniform<glm::vec3>("material.specular");
+    UniformHandle<float> materialShininess = prog.uniform<float>("material.shininess");
+    UniformHandle<float> reflectivity = prog.uniform<float>("reflectivity");
+    UniformHandle<glm::mat4> model = prog.uniform<glm::mat4>("model");
+    UniformHandle<int> ballTexture = prog.uniform<int>("ballTexture");
+
+    printf("%d frames x %d uniforms\n\nLookup only:\n", frames, LIT_UNIFORM_COUNT);
+
+    double mapLookup = timeNs(frames, [&]() {
+        for (const char *name : LIT_UNIFORMS)
+            sink = locationMap.find(name)->second;
+    });
+    double hashLookup = timeNs(frames, [&]() {
+        for (const char *name : LIT_UNIFORMS)
+            sink = prog.uniform<int>(name).location;
+    });
+    double handleLookup = timeNs(frames, [&]() {
+        sink = projection.location; sink = view.location; sink = viewPos.location;
+        sink = lightPos.location; sink = lightSpaceMatrix.location; sink = shadowMap.location;
+        sink = skybox.location; sink = overrideColor.location; sink = materialSpecular.location;
+        sink = materialShininess.location; sink = reflectivity.location; sink = model.location;
+        sink = ballTexture.location;
+    });
+    report("std::map<std::string>", mapLookup, mapLookup);
+    report("hashed name", hashLookup, mapLookup);
+    report("handle", handleLookup, mapLookup);
+
+    printf("\nLookup + glUniform:\n");
+
+    auto mapLoc = [&](const char *name) { return locationMap.find(name)->second; };
+    double mapSet = timeNs(frames, [&]() {
+        m[3][0] += 1.0f; v.x += 1.0f;
+        glUniformMatrix4fv(mapLoc("projection"), 1, GL_FALSE, &m[0][0]);
+        glUniformMatrix4fv(mapLoc("view"), 1, GL_FALSE, &m[0][0]);
+        glUniform3f(mapLoc("viewPos"), v.x, v.y, v.z);
+        glUniform3f(mapLoc("lightPos"), v.x, v.y, v.z);
+        glUniformMatrix4fv(mapLoc("lightSpaceMatrix"), 1, GL_FALSE, &m[0][0]);
+        glUniform1i(mapLoc("shadowMap"), 1);
+        glUniform1i(mapLoc("skybox"), 2);
+        glUniform3f(mapLoc("overrideColor"), v.x, v.y, v.z);
+        glUniform3f(mapLoc("material.specular"), v.x, v.y, v.z);
+        glUniform1f(mapLoc("material.shininess"), 32.0f);
+        glUniform1f(mapLoc("reflectivity"), 0.5f);
+        glUniformMatrix4fv(mapLoc("model"), 1, GL_FALSE, &m[0][0]);
+        glUniform1i(mapLoc("ballTexture"), 0);
+    });
+    GLSLProgram::uploadStats = UniformUploadStats();
+    double hashSet = timeNs(frames, [&]() {
+        m[3][0] += 1.0f; v.x += 1.0f;
+        prog.setUniform("projection", m);
+        prog.setUniform("view", m);
+        prog.setUniform("viewPos", v);
+        prog.setUniform("lightPos", v);
+        prog.setUniform("lightSpaceMatrix", m);
+        prog.setUniform("shadowMap", 1);
+        prog.setUniform("skybox", 2);
+        prog.setUniform("overrideColor", v);
+        prog.setUniform("material.specular", v);
+        prog.setUniform("material.shininess", 32.0f);
+        prog.setUniform("reflectivity", 0.5f);
+        prog.setUniform("model", m);
+        prog.setUniform("ballTexture", 0);
+    });
+    double handleSet = timeNs(frames, [&]() {
+        m[3][0] += 1.0f; v.x += 1.0f;
+        prog.setUniform(projection, m);
+        prog.setUniform(view, m);
+        prog.setUniform(viewPos, v);
+        prog.setUniform(lightPos, v);
+        prog.setUniform(lightSpaceMatrix, m);
+        prog.setUniform(shadowMap, 1);
+        prog.setUniform(skybox, 2);
+        prog.setUniform(overrideColor, v);
+        prog.setUniform(materialSpecular, v);
+        prog.setUniform(materialShininess, 32.0f);
+        prog.setUniform(reflectivity, 0.5f);
+        prog.setUniform(model, m);
+        prog.setUniform(ballTexture, 0);
+    });
+    report("std::map<std::string>", mapSet, mapSet);
+    report("hashed name", hashSet, mapSet);
+    report("handle", handleSet, mapSet);
+
+    const UniformUploadStats &stats = GLSLProgram::uploadStats;
+    printf("\nGLSLProgram uploads: %llu issued, %llu skipped (%.1f%%)\n",
+           (unsigned long long)stats.issued, (unsigned long long)stats.skipped,
+           100.0 * stats.skipped / (double)(stats.issued + stats.skipped));
+
+    return 0;
+}
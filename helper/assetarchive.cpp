@@ -0,0 +1,205 @@
+#include "assetarchive.h"
+
+#include "stb_image.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+    const uint32_t MAGIC = 0x4B415053;    // "SPAK"
+    const uint32_t VERSION = 1;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entries;
+        uint32_t alignment;
+        uint64_t tocSize;     // bytes of TocEntry records and names after the header
+    };
+
+    struct TocEntry {
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;
+        uint32_t flags;
+        uint32_t nameLength;
+    };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    std::vector<std::shared_ptr<AssetArchive>> & mounts() {
+        static std::vector<std::shared_ptr<AssetArchive>> archives;
+        return archives;
+    }
+}
+
+std::string AssetArchive::entryName(const std::string &path) {
+    std::string name = path;
+    for (char &c : name) {
+        if (c == '\\')
+            c = '/';
+    }
+    while (name.compare(0, 2, "./") == 0)
+        name.erase(0, 2);
+    return name;
+}
+
+bool AssetArchive::write(const std::string &fileName, std::vector<Entry> &entries,
+                         const std::vector<std::vector<unsigned char>> &data, uint32_t alignment) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || entries.size() != data.size()) {
+        std::cerr << "Invalid archive layout for " << fileName << std::endl;
+        return false;
+    }
+
+    // Table of contents first, so opening the archive reads one contiguous range
+    std::vector<unsigned char> toc;
+    for (const Entry &entry : entries) {
+        size_t start = toc.size();
+        toc.resize(alignUp(start + sizeof(TocEntry) + entry.name.size(), 8));
+        memcpy(&toc[start + sizeof(TocEntry)], entry.name.data(), entry.name.size());
+    }
+    Header header = { MAGIC, VERSION, (uint32_t)entries.size(), alignment, toc.size() };
+
+    uint64_t offset = alignUp(sizeof(Header) + toc.size(), alignment);
+    size_t position = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        entries[i].offset = offset;
+        entries[i].storedSize = data[i].size();
+        TocEntry record = { offset, entries[i].storedSize, entries[i].size, entries[i].flags,
+                            (uint32_t)entries[i].name.size() };
+        memcpy(&toc[position], &record, sizeof(record));
+        position = alignUp(position + sizeof(TocEntry) + entries[i].name.size(), 8);
+        offset = alignUp(offset + data[i].size(), alignment);
+    }
+
+    return writeFileAtomically(fileName, [&](FILE *out) {
+        std::vector<unsigned char> padding(alignment, 0);
+        uint64_t written = sizeof(Header) + toc.size();
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(toc.data(), 1, toc.size(), out) == toc.size();
+        for (size_t i = 0; ok && i < entries.size(); i++) {
+            size_t pad = (size_t)(entries[i].offset - written);
+            ok = fwrite(padding.data(), 1, pad, out) == pad &&
+                 fwrite(data[i].data(), 1, data[i].size(), out) == data[i].size();
+            written = entries[i].offset + data[i].size();
+        }
+        return ok;
+    });
+}
+
+AssetArchive::AssetArchive() : file(std::make_shared<MappedFile>()) {}
+
+bool AssetArchive::open(const std::string &fileName) {
+    entryList.clear();
+    lookup.clear();
+    path = fileName;
+    if (!file->open(fileName))
+        return false;
+
+    Header header;
+    const unsigned char *bytes = file->data();
+    size_t size = file->size();
+    if (size < sizeof(Header)) {
+        file->close();
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(Header));
+    if (header.magic != MAGIC || header.version != VERSION || header.tocSize > size - sizeof(Header)) {
+        std::cerr << "Ignoring invalid asset archive " << fileName << std::endl;
+        file->close();
+        return false;
+    }
+
+    size_t position = sizeof(Header), end = sizeof(Header) + (size_t)header.tocSize;
+    for (uint32_t i = 0; i < header.entries; i++) {
+        TocEntry record;
+        bool ok = position + sizeof(TocEntry) <= end;
+        if (ok) {
+            memcpy(&record, bytes + position, sizeof(TocEntry));
+            ok = position + sizeof(TocEntry) + record.nameLength <= end &&
+                 record.offset <= size && record.storedSize <= size - record.offset &&
+                 ((record.flags & FLAG_ZLIB) || record.size == record.storedSize);
+        }
+        if (!ok) {
+            std::cerr << "Ignoring truncated asset archive " << fileName << std::endl;
+            file->close();
+            entryList.clear();
+            lookup.clear();
+            return false;
+        }
+        Entry entry;
+        entry.name.assign((const char *)bytes + position + sizeof(TocEntry), record.nameLength);
+        entry.offset = record.offset;
+        entry.storedSize = record.storedSize;
+        entry.size = record.size;
+        entry.flags = record.flags;
+        lookup[entry.name] = entryList.size();
+        entryList.push_back(entry);
+        position = (size_t)alignUp(position + sizeof(TocEntry) + record.nameLength, 8);
+    }
+    return true;
+}
+
+bool AssetArchive::read(const std::string &name, View &view) const {
+    auto found = lookup.find(entryName(name));
+    if (found == lookup.end())
+        return false;
+    const Entry &entry = entryList[found->second];
+    const unsigned char *stored = file->data() + entry.offset;
+
+    if (!(entry.flags & FLAG_ZLIB)) {
+        // Straight out of the mapping; the view keeps it alive
+        view.data = stored;
+        view.size = (size_t)entry.size;
+        view.owner = file;
+        return true;
+    }
+
+    std::shared_ptr<unsigned char> copy(new unsigned char[entry.size ? (size_t)entry.size : 1],
+                                        std::default_delete<unsigned char[]>());
+    int length = stbi_zlib_decode_buffer((char *)copy.get(), (int)entry.size, (const char *)stored, (int)entry.storedSize);
+    if (length != (int)entry.size) {
+        std::cerr << "Corrupt entry " << entry.name << " in asset archive " << path << std::endl;
+        return false;
+    }
+    view.data = copy.get();
+    view.size = (size_t)entry.size;
+    view.owner = copy;
+    return true;
+}
+
+bool AssetArchive::mount(const std::string &fileName) {
+    std::shared_ptr<AssetArchive> archive = std::make_shared<AssetArchive>();
+    if (!archive->open(fileName))
+        return false;
+    std::cout << "Mounted asset archive " << fileName << ": " << archive->entries().size() << " entries" << std::endl;
+    mounts().push_back(archive);
+    return true;
+}
+
+void AssetArchive::unmountAll() {
+    mounts().clear();
+}
+
+size_t AssetArchive::mounted() {
+    return mounts().size();
+}
+
+bool AssetArchive::load(const std::string &name, View &view) {
+    const std::vector<std::shared_ptr<AssetArchive>> &archives = mounts();
+    for (auto archive = archives.rbegin(); archive != archives.rend(); ++archive) {
+        if ((*archive)->read(name, view))
+            return true;
+    }
+
+    std::shared_ptr<MappedFile> loose = std::make_shared<MappedFile>();
+    if (!loose->open(name))
+        return false;
+    view.data = loose->data();
+    view.size = loose->size();
+    view.owner = loose;
+    return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mappedfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Packed asset archive (.pak), written by the assetpack tool and
+// memory-mapped at run time.
+//
+// Loading a shader or texture from an archive costs no open, stat or read
+// of its own: the archive is opened once and entries are handed out as
+// pointer + size views into the mapping.  Entries may be zlib compressed,
+// in which case the view owns a decompressed copy instead.
+//
+//   AssetArchive::mount("assets.pak");
+//   AssetArchive::View shader;
+//   if (AssetArchive::load("shader/basic_uniform.vert", shader)) ...
+//
+// load() looks the name up in the mounted archives, newest first, and
+// falls back to mapping the loose file, so callers need no second path.
+//
+//   file layout (little-endian):
+//     Header
+//     TocEntry[entries], each followed by its name, padded to 8 bytes
+//     entry data, each entry aligned to Header::alignment
+class AssetArchive {
+public:
+    static const uint32_t FLAG_ZLIB = 1;
+    static const uint32_t DEFAULT_ALIGNMENT = 64;
+
+    // Bytes that stay valid as long as the view (or a copy of it) exists
+    struct View {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        std::shared_ptr<const void> owner;
+
+        bool valid() const { return data != nullptr; }
+    };
+
+    struct Entry {
+        std::string name;
+        uint64_t offset;        // from the start of the archive
+        uint64_t storedSize;    // bytes in the archive
+        uint64_t size;          // bytes once decompressed
+        uint32_t flags;
+    };
+
+    // Normalised entry name: forward slashes, no leading "./"
+    static std::string entryName(const std::string &path);
+
+    // Entries with their data in the same order; offsets are filled in
+    static bool write(const std::string &fileName, std::vector<Entry> &entries,
+                      const std::vector<std::vector<unsigned char>> &data, uint32_t alignment = DEFAULT_ALIGNMENT);
+
+    AssetArchive();
+
+    bool open(const std::string &fileName);
+    bool read(const std::string &name, View &view) const;
+    bool contains(const std::string &name) const { return lookup.count(entryName(name)) != 0; }
+
+    const std::vector<Entry> & entries() const { return entryList; }
+    const std::string & fileName() const { return path; }
+
+    // Process-wide archives searched by load(); mount before loading starts
+    static bool mount(const std::string &fileName);
+    static void unmountAll();
+    static size_t mounted();
+
+    // An asset from the mounted archives, or else the loose file, mapped;
+    // thread safe once mounting is done
+    static bool load(const std::string &name, View &view);
+
+private:
+    std::shared_ptr<MappedFile> file;
+    std::string path;
+    std::vector<Entry> entryList;
+    std::unordered_map<std::string, size_t> lookup;
+};
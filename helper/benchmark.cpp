@@ -0,0 +1,198 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+bool CameraPath::load(const std::string &fileName) {
+    std::ifstream in(fileName);
+    if (!in) {
+        std::cerr << "Unable to open camera path: " << fileName << std::endl;
+        return false;
+    }
+
+    poses.clear();
+    CameraPose pose;
+    while (in >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch)
+        poses.push_back(pose);
+
+    return !poses.empty();
+}
+
+bool CameraPath::save(const std::string &fileName) const {
+    std::ofstream out(fileName);
+    if (!out)
+        return false;
+
+    for (const CameraPose &pose : poses) {
+        out << pose.position.x << " " << pose.position.y << " " << pose.position.z << " "
+            << pose.yaw << " " << pose.pitch << "\n";
+    }
+    return true;
+}
+
+void CameraPath::record(const Camera &camera) {
+    poses.push_back({ camera.Position, camera.Yaw, camera.Pitch });
+}
+
+void CameraPath::apply(Camera &camera, size_t frame) const {
+    if (poses.empty())
+        return;
+    const CameraPose &pose = poses[std::min(frame, poses.size() - 1)];
+    camera.SetPose(pose.position, pose.yaw, pose.pitch);
+}
+
+CameraPath CameraPath::orbit(int frames, const glm::vec3 &center, float radius, float height) {
+    CameraPath path;
+    for (int i = 0; i < frames; i++) {
+        float angle = glm::two_pi<float>() * (float)i / (float)frames;
+        glm::vec3 position = center + glm::vec3(radius * cos(angle), height, radius * sin(angle));
+        glm::vec3 dir = glm::normalize(center - position);
+
+        CameraPose pose;
+        pose.position = position;
+        pose.yaw = glm::degrees(atan2(dir.z, dir.x));
+        pose.pitch = glm::degrees(asin(dir.y));
+        path.poses.push_back(pose);
+    }
+    return path;
+}
+
+FrameBenchmark::FrameBenchmark() {
+    glGenQueries(QUERY_RING, queries);
+    for (int i = 0; i < QUERY_RING; i++)
+        queryFrame[i] = -1;
+}
+
+FrameBenchmark::~FrameBenchmark() {
+    glDeleteQueries(QUERY_RING, queries);
+}
+
+void FrameBenchmark::beginFrame() {
+    int frame = (int)timings.size();
+    int slot = frame % QUERY_RING;
+
+    // The query issued QUERY_RING frames ago is normally complete by now
+    collect(slot);
+
+    timings.push_back({ 0.0, -1.0 });
+    queryFrame[slot] = frame;
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+    frameStart = std::chrono::steady_clock::now();
+}
+
+void FrameBenchmark::endFrame() {
+    auto frameEnd = std::chrono::steady_clock::now();
+    glEndQuery(GL_TIME_ELAPSED);
+    timings.back().cpuMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+}
+
+void FrameBenchmark::finish() {
+    for (int i = 0; i < QUERY_RING; i++)
+        collect(i);
+}
+
+void FrameBenchmark::collect(int slot) {
+    if (queryFrame[slot] < 0)
+        return;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+    timings[queryFrame[slot]].gpuMs = elapsed / 1.0e6;
+    queryFrame[slot] = -1;
+}
+
+TimingStats TimingStats::compute(std::vector<double> values) {
+    TimingStats stats = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    if (values.empty())
+        return stats;
+
+    std::sort(values.begin(), values.end());
+    // Nearest-rank percentile
+    auto percentile = [&values](double p) {
+        size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+        return values[std::min(std::max(rank, (size_t)1), values.size()) - 1];
+    };
+
+    double sum = 0.0;
+    for (double v : values)
+        sum += v;
+
+    stats.min = values.front();
+    stats.max = values.back();
+    stats.mean = sum / values.size();
+    stats.p50 = percentile(50.0);
+    stats.p95 = percentile(95.0);
+    stats.p99 = percentile(99.0);
+    return stats;
+}
+
+static void splitTimings(const std::vector<FrameTiming> &timings, std::vector<double> &cpu, std::vector<double> &gpu) {
+    for (const FrameTiming &t : timings) {
+        cpu.push_back(t.cpuMs);
+        if (t.gpuMs >= 0.0)
+            gpu.push_back(t.gpuMs);
+    }
+}
+
+static void writeStatsJson(std::ostream &out, const char *name, const TimingStats &s) {
+    out << "    \"" << name << "\": { \"min\": " << s.min << ", \"mean\": " << s.mean
+        << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99
+        << ", \"max\": " << s.max << " }";
+}
+
+bool FrameBenchmark::writeResults(const std::string &fileName) const {
+    std::ofstream out(fileName);
+    if (!out) {
+        std::cerr << "Unable to write benchmark results: " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<double> cpu, gpu;
+    splitTimings(timings, cpu, gpu);
+    TimingStats cpuStats = TimingStats::compute(cpu);
+    TimingStats gpuStats = TimingStats::compute(gpu);
+
+    bool csv = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        out << "frame,cpu_ms,gpu_ms\n";
+        for (size_t i = 0; i < timings.size(); i++)
+            out << i << "," << timings[i].cpuMs << "," << timings[i].gpuMs << "\n";
+        // Summary rows use the statistic name in the frame column
+        out << "min," << cpuStats.min << "," << gpuStats.min << "\n";
+        out << "mean," << cpuStats.mean << "," << gpuStats.mean << "\n";
+        out << "p50," << cpuStats.p50 << "," << gpuStats.p50 << "\n";
+        out << "p95," << cpuStats.p95 << "," << gpuStats.p95 << "\n";
+        out << "p99," << cpuStats.p99 << "," << gpuStats.p99 << "\n";
+        out << "max," << cpuStats.max << "," << gpuStats.max << "\n";
+        return true;
+    }
+
+    out << "{\n  \"frames\": " << timings.size() << ",\n  \"summary\": {\n";
+    writeStatsJson(out, "cpu_ms", cpuStats);
+    out << ",\n";
+    writeStatsJson(out, "gpu_ms", gpuStats);
+    out << "\n  },\n  \"per_frame\": [\n";
+    for (size_t i = 0; i < timings.size(); i++) {
+        out << "    { \"cpu_ms\": " << timings[i].cpuMs << ", \"gpu_ms\": " << timings[i].gpuMs << " }"
+            << (i + 1 < timings.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+void FrameBenchmark::printSummary() const {
+    std::vector<double> cpu, gpu;
+    splitTimings(timings, cpu, gpu);
+    TimingStats c = TimingStats::compute(cpu);
+    TimingStats g = TimingStats::compute(gpu);
+
+    printf("-------------------------------------------------------------\n");
+    printf("Benchmark    : %d frames\n", (int)timings.size());
+    printf("CPU ms       : p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", c.p50, c.p95, c.p99, c.max);
+    printf("GPU ms       : p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", g.p50, g.p95, g.p99, g.max);
+    printf("-------------------------------------------------------------\n");
+}
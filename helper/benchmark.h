@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+
+// One camera pose per frame
+struct CameraPose {
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+// A recorded camera trajectory.  Stored as text, one "x y z yaw pitch" line per frame.
+class CameraPath {
+public:
+    bool load(const std::string &fileName);
+    bool save(const std::string &fileName) const;
+
+    void record(const Camera &camera);
+    void apply(Camera &camera, size_t frame) const;
+
+    size_t size() const { return poses.size(); }
+    bool empty() const { return poses.empty(); }
+
+    // Built-in path used when no recording is given: circles the centre looking inwards
+    static CameraPath orbit(int frames, const glm::vec3 &center, float radius, float height);
+
+private:
+    std::vector<CameraPose> poses;
+};
+
+struct FrameTiming {
+    double cpuMs;   // update + render submission on the CPU
+    double gpuMs;   // GL_TIME_ELAPSED for the same frame, -1 if unavailable
+};
+
+// Collects per-frame CPU and GPU times.  GPU queries live in a small ring so a
+// result is only read back a few frames after it was issued.
+class FrameBenchmark {
+public:
+    FrameBenchmark();
+    ~FrameBenchmark();
+
+    FrameBenchmark(const FrameBenchmark &) = delete;
+    FrameBenchmark & operator=(const FrameBenchmark &) = delete;
+
+    void beginFrame();
+    void endFrame();
+
+    // Reads back all outstanding queries; call once after the last frame
+    void finish();
+
+    const std::vector<FrameTiming> & frames() const { return timings; }
+
+    // Writes per-frame times plus a summary; CSV if the name ends in .csv, JSON otherwise
+    bool writeResults(const std::string &fileName) const;
+    void printSummary() const;
+
+private:
+    static const int QUERY_RING = 4;
+
+    GLuint queries[QUERY_RING];
+    int queryFrame[QUERY_RING];
+    std::vector<FrameTiming> timings;
+    std::chrono::steady_clock::time_point frameStart;
+
+    void collect(int slot);
+};
+
+// Summary statistics over a set of frame times
+struct TimingStats {
+    double min, mean, p50, p95, p99, max;
+
+    static TimingStats compute(std::vector<double> values);
+};
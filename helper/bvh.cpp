@@ -0,0 +1,259 @@
+#include "bvh.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+
+namespace {
+
+    const int BINS = 16;            // candidate SAH splits per axis
+
+    struct Box {
+        glm::vec3 lo = glm::vec3(1e30f);
+        glm::vec3 hi = glm::vec3(-1e30f);
+
+        void grow(const glm::vec3 &p) { lo = glm::min(lo, p); hi = glm::max(hi, p); }
+        void grow(const Box &b) { lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); }
+        bool empty() const { return lo.x > hi.x; }
+        float area() const {
+            if (empty())
+                return 0.0f;
+            glm::vec3 d = hi - lo;
+            return d.x * d.y + d.y * d.z + d.z * d.x;
+        }
+    };
+
+    Box sphereBox(const glm::vec4 &sphere) {
+        Box box;
+        box.lo = glm::vec3(sphere) - sphere.w;
+        box.hi = glm::vec3(sphere) + sphere.w;
+        return box;
+    }
+}
+
+void Bvh::build(const std::vector<glm::vec4> &list) {
+    PROFILE_SCOPE("Bvh::build");
+    spheres = list;
+    order.resize(spheres.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (uint32_t)i;
+    nodes.clear();
+    leaves.clear();
+    dirty = false;
+    if (!spheres.empty())
+        buildNode(0, spheres.size());
+}
+
+uint32_t Bvh::buildNode(size_t begin, size_t end) {
+    uint32_t index = (uint32_t)nodes.size();
+    nodes.emplace_back();
+
+    // Split the largest range until there are four or none is worth splitting
+    size_t bounds[4][2] = { { begin, end } };
+    int count = 1;
+    while (count < 4) {
+        int largest = -1;
+        for (int i = 0; i < count; i++) {
+            size_t size = bounds[i][1] - bounds[i][0];
+            if (size > LEAF_SIZE && (largest < 0 || size > bounds[largest][1] - bounds[largest][0]))
+                largest = i;
+        }
+        if (largest < 0)
+            break;
+        size_t mid = split(bounds[largest][0], bounds[largest][1]);
+        bounds[count][0] = mid;
+        bounds[count][1] = bounds[largest][1];
+        bounds[largest][1] = mid;
+        count++;
+    }
+
+    // Children are built before their boxes are known; nodes may reallocate meanwhile
+    uint32_t children[4] = { EMPTY, EMPTY, EMPTY, EMPTY };
+    for (int i = 0; i < count; i++) {
+        size_t size = bounds[i][1] - bounds[i][0];
+        children[i] = size <= LEAF_SIZE ? LEAF | buildLeaf(bounds[i][0], bounds[i][1]) : buildNode(bounds[i][0], bounds[i][1]);
+    }
+    for (int i = 0; i < 4; i++)
+        setChild(nodes[index], i, children[i]);
+    return index;
+}
+
+uint32_t Bvh::buildLeaf(size_t begin, size_t end) {
+    Leaf leaf;
+    leaf.first = (uint32_t)begin;
+    leaf.count = (uint32_t)(end - begin);
+    fillLeaf(leaf);
+    leaves.push_back(leaf);
+    return (uint32_t)(leaves.size() - 1);
+}
+
+size_t Bvh::split(size_t begin, size_t end) {
+    Box centroids;
+    for (size_t i = begin; i < end; i++)
+        centroids.grow(glm::vec3(spheres[order[i]]));
+    glm::vec3 extent = centroids.hi - centroids.lo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    size_t median = begin + (end - begin) / 2;
+    if (extent[axis] <= 0.0f)
+        return median;  // all in one place, any split is as good
+
+    // Bin the centroids along the widest axis and pick the cheapest boundary
+    auto binOf = [&](uint32_t object) {
+        float t = (spheres[object][axis] - centroids.lo[axis]) / extent[axis];
+        return std::min(BINS - 1, (int)(t * BINS));
+    };
+    Box binBoxes[BINS];
+    size_t binCounts[BINS] = {};
+    for (size_t i = begin; i < end; i++) {
+        int bin = binOf(order[i]);
+        binBoxes[bin].grow(sphereBox(spheres[order[i]]));
+        binCounts[bin]++;
+    }
+    float rightCost[BINS];
+    Box right;
+    size_t rightCount = 0;
+    for (int bin = BINS - 1; bin > 0; bin--) {
+        right.grow(binBoxes[bin]);
+        rightCount += binCounts[bin];
+        rightCost[bin] = right.area() * rightCount;
+    }
+    Box left;
+    size_t leftCount = 0;
+    int best = -1;
+    float bestCost = 1e30f;
+    for (int bin = 0; bin < BINS - 1; bin++) {
+        left.grow(binBoxes[bin]);
+        leftCount += binCounts[bin];
+        float cost = left.area() * leftCount + rightCost[bin + 1];
+        if (leftCount > 0 && leftCount < end - begin && cost < bestCost) {
+            bestCost = cost;
+            best = bin;
+        }
+    }
+
+    if (best >= 0) {
+        auto mid = std::partition(order.begin() + begin, order.begin() + end,
+                                  [&](uint32_t object) { return binOf(object) <= best; });
+        return (size_t)(mid - order.begin());
+    }
+    std::nth_element(order.begin() + begin, order.begin() + median, order.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return spheres[a][axis] < spheres[b][axis]; });
+    return median;
+}
+
+void Bvh::fillLeaf(Leaf &leaf) const {
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        if (lane < leaf.count) {
+            uint32_t object = order[leaf.first + lane];
+            const glm::vec4 &sphere = spheres[object];
+            leaf.x[lane] = sphere.x;
+            leaf.y[lane] = sphere.y;
+            leaf.z[lane] = sphere.z;
+            leaf.radius[lane] = sphere.w;
+            leaf.object[lane] = object;
+        } else {
+            // Behind every plane by any measure
+            leaf.x[lane] = leaf.y[lane] = leaf.z[lane] = 0.0f;
+            leaf.radius[lane] = -1e30f;
+            leaf.object[lane] = EMPTY;
+        }
+    }
+}
+
+void Bvh::setChild(Node &node, int slot, uint32_t child) const {
+    Box box;
+    if (child != EMPTY && (child & LEAF)) {
+        const Leaf &leaf = leaves[child & ~LEAF];
+        for (uint32_t lane = 0; lane < leaf.count; lane++)
+            box.grow(sphereBox(spheres[leaf.object[lane]]));
+    } else if (child != EMPTY) {
+        const Node &below = nodes[child];
+        for (int i = 0; i < 4; i++) {
+            if (below.child[i] != EMPTY) {
+                box.grow(glm::vec3(below.minX[i], below.minY[i], below.minZ[i]));
+                box.grow(glm::vec3(below.maxX[i], below.maxY[i], below.maxZ[i]));
+            }
+        }
+    }
+    node.child[slot] = child;
+    node.minX[slot] = box.lo.x;
+    node.minY[slot] = box.lo.y;
+    node.minZ[slot] = box.lo.z;
+    node.maxX[slot] = box.hi.x;
+    node.maxY[slot] = box.hi.y;
+    node.maxZ[slot] = box.hi.z;
+}
+
+void Bvh::update(size_t index, const glm::vec4 &sphere) {
+    spheres[index] = sphere;
+    dirty = true;
+}
+
+void Bvh::refit() {
+    if (!dirty)
+        return;
+    PROFILE_SCOPE("Bvh::refit");
+    for (Leaf &leaf : leaves)
+        fillLeaf(leaf);
+    // Children come after their parents, so walking backwards refits them first
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node &node = nodes[i];
+        for (int slot = 0; slot < 4; slot++)
+            setChild(node, slot, node.child[slot]);
+    }
+    dirty = false;
+}
+
+void Bvh::cull(const Frustum &frustum, std::vector<uint32_t> &visible, Stats *stats) const {
+    Stats counts;
+    size_t before = visible.size();
+    if (nodes.empty()) {
+        if (stats)
+            *stats = counts;
+        return;
+    }
+
+    // A node on the stack is either to be tested or entirely inside
+    struct Entry {
+        uint32_t node;
+        bool inside;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, false });
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[entry.node];
+        unsigned passed = 0xF, inside = 0xF;
+        if (!entry.inside) {
+            passed = frustum.testBoxes4(node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ, &inside);
+            counts.nodes++;
+        }
+        for (int slot = 0; slot < 4; slot++) {
+            uint32_t child = node.child[slot];
+            if (child == EMPTY || !(passed & (1u << slot)))
+                continue;
+            bool whole = (inside & (1u << slot)) != 0;
+            if (!(child & LEAF)) {
+                stack.push_back({ child, whole });
+                continue;
+            }
+            const Leaf &leaf = leaves[child & ~LEAF];
+            unsigned hits = (1u << leaf.count) - 1;
+            if (whole) {
+                counts.accepted += (int)leaf.count;
+            } else {
+                hits &= frustum.testSpheres4(leaf.x, leaf.y, leaf.z, leaf.radius);
+                counts.leaves++;
+            }
+            for (uint32_t lane = 0; lane < leaf.count; lane++) {
+                if (hits & (1u << lane))
+                    visible.push_back(leaf.object[lane]);
+            }
+        }
+    }
+    counts.visible = (int)(visible.size() - before);
+    if (stats)
+        *stats = counts;
+}
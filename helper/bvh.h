@@ -0,0 +1,78 @@
+#pragma once
+
+#include "frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over bounding spheres, for frustum culling on
+// the CPU.
+//
+//   Bvh bvh;
+//   bvh.build(spheres);                  // xyz centre, w radius; when objects come or go
+//   bvh.update(i, sphere);               // object i moved
+//   bvh.refit();                         // before culling, after any update()
+//   bvh.cull(frustum, visible);          // indices into spheres
+//
+// Built top down with the surface area heuristic and four children a node,
+// so all of a node's children are tested in one Frustum::testBoxes4 and a
+// leaf's spheres (up to LEAF_SIZE) in one testSpheres4.  A subtree entirely
+// inside the frustum is taken without testing anything below it.  Moving
+// objects only refits the boxes, which grow looser the further they wander
+// from where build() put them.
+class Bvh {
+public:
+    static const int LEAF_SIZE = 4;
+
+    // What the last cull() did
+    struct Stats {
+        int nodes = 0;      // nodes whose children were tested
+        int leaves = 0;     // leaves whose spheres were tested
+        int accepted = 0;   // objects taken from subtrees entirely inside
+        int visible = 0;
+    };
+
+    // Replaces every object
+    void build(const std::vector<glm::vec4> &spheres);
+
+    void update(size_t index, const glm::vec4 &sphere);
+    void refit();
+
+    // Appends the index of every object that may be visible, in tree order
+    void cull(const Frustum &frustum, std::vector<uint32_t> &visible, Stats *stats = nullptr) const;
+
+    size_t size() const { return spheres.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    static const uint32_t LEAF = 0x80000000u;  // set in a child that is a leaf
+    static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+    struct Node {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        uint32_t child[4];          // node index, LEAF | leaf index, or EMPTY
+    };
+
+    struct Leaf {
+        float x[4], y[4], z[4], radius[4];  // unused lanes can never be visible
+        uint32_t object[4];
+        uint32_t count;
+        uint32_t first;             // into order
+    };
+
+    std::vector<glm::vec4> spheres;
+    std::vector<uint32_t> order;    // object indices, each leaf's a contiguous run
+    std::vector<Node> nodes;        // parents before children; 0 is the root
+    std::vector<Leaf> leaves;
+    bool dirty = false;
+
+    uint32_t buildNode(size_t begin, size_t end);
+    uint32_t buildLeaf(size_t begin, size_t end);
+    size_t split(size_t begin, size_t end);
+    void fillLeaf(Leaf &leaf) const;
+    void setChild(Node &node, int slot, uint32_t child) const;
+};
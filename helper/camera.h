@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "frustum.h"
+
 #ifndef CAMERA_IMPLEMENTATION
 #define CAMERA_IMPLEMENTATION
 #endif
@@ -47,6 +49,9 @@ public:
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
     glm::mat4 GetViewMatrix();
 
+    // returns the planes of what the camera sees through projection, for culling on the CPU
+    Frustum GetFrustum(const glm::mat4 &projection);
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
 
@@ -56,6 +61,9 @@ public:
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset);
 
+    // places the camera directly, e.g. when replaying a recorded camera path
+    void SetPose(glm::vec3 position, float yaw, float pitch);
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors();
@@ -0,0 +1,192 @@
+#include "compressedtexture.h"
+
+#include "glutils.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+    const uint32_t MAGIC = 0x58455443;    // "CTEX"
+    const uint32_t VERSION = 1;
+    const size_t ALIGNMENT = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format;
+        uint32_t channels;
+        uint32_t levels;
+        uint32_t flags;
+        uint64_t sourceSize;
+        uint64_t sourceHash;
+    };
+
+    struct LevelEntry {
+        uint32_t width, height;
+        uint64_t offset, size;
+    };
+
+    size_t alignUp(size_t value) {
+        return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+}
+
+std::string CompressedTextureFile::cachePath(const std::string &sourceFile) {
+    size_t dot = sourceFile.find_last_of('.');
+    size_t slash = sourceFile.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return sourceFile + ".ctex";
+    return sourceFile.substr(0, dot) + ".ctex";
+}
+
+bool CompressedTextureFile::sourceHash(const std::string &sourceFile, uint64_t &size, uint64_t &hash) {
+    AssetArchive::View source;
+    if (!AssetArchive::load(sourceFile, source))
+        return false;
+
+    // FNV-1a over 64-bit words; only has to notice that the image was edited
+    const uint64_t PRIME = 1099511628211ULL;
+    hash = 14695981039346656037ULL;
+    size = source.size;
+    const unsigned char *bytes = source.data;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + i * 8, 8);
+        hash = (hash ^ word) * PRIME;
+    }
+    for (size_t i = words * 8; i < size; i++)
+        hash = (hash ^ bytes[i]) * PRIME;
+    return true;
+}
+
+size_t CompressedTextureFile::blockBytes(GLenum format) {
+    switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+GLenum CompressedTextureFile::srgbFormat(GLenum format) {
+    switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    default: return format;
+    }
+}
+
+std::vector<GLenum> CompressedTextureFile::supportedFormats() {
+    // RGTC is core since 3.0 and BPTC since 4.2; S3TC is only ever an extension
+    std::vector<GLenum> formats = { GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2 };
+    if (GLAD_GL_VERSION_4_2 || GLUtils::hasExtension("GL_ARB_texture_compression_bptc")) {
+        formats.push_back(GL_COMPRESSED_RGBA_BPTC_UNORM);
+        formats.push_back(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+    }
+    if (GLUtils::hasExtension("GL_EXT_texture_compression_s3tc") || GLUtils::hasExtension("GL_EXT_texture_compression_dxt1")) {
+        formats.push_back(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+        if (GLUtils::hasExtension("GL_EXT_texture_sRGB") || GLUtils::hasExtension("GL_EXT_texture_compression_s3tc_srgb"))
+            formats.push_back(GL_COMPRESSED_SRGB_S3TC_DXT1_EXT);
+    }
+    return formats;
+}
+
+bool CompressedTextureFile::write(const std::string &fileName, GLenum format, int width, int height, int channels,
+                                  uint32_t flags, uint64_t sourceSize, uint64_t sourceHash,
+                                  const std::vector<std::vector<unsigned char>> &levels) {
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.format = format;
+    header.channels = (uint32_t)channels;
+    header.levels = (uint32_t)levels.size();
+    header.flags = flags;
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+
+    std::vector<LevelEntry> entries(levels.size());
+    size_t offset = alignUp(sizeof(Header) + entries.size() * sizeof(LevelEntry));
+    for (size_t i = 0; i < levels.size(); i++) {
+        entries[i].width = (uint32_t)std::max(1, width >> i);
+        entries[i].height = (uint32_t)std::max(1, height >> i);
+        entries[i].offset = offset;
+        entries[i].size = levels[i].size();
+        offset = alignUp(offset + levels[i].size());
+    }
+
+    return writeFileAtomically(fileName, [&](FILE *out) {
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                  (entries.empty() || fwrite(entries.data(), sizeof(LevelEntry), entries.size(), out) == entries.size());
+        for (size_t i = 0; ok && i < levels.size(); i++) {
+            ok = fseek(out, (long)entries[i].offset, SEEK_SET) == 0 &&
+                 fwrite(levels[i].data(), 1, levels[i].size(), out) == levels[i].size();
+        }
+        return ok;
+    });
+}
+
+CompressedTextureFile::CompressedTextureFile() :
+    glFormat(0), sourceChannels(0), flags(0), sourceSize(0), sourceHashValue(0) {}
+
+bool CompressedTextureFile::open(const std::string &fileName) {
+    levelList.clear();
+    if (!AssetArchive::load(fileName, file))
+        return false;
+
+    Header header;
+    if (file.size < sizeof(Header)) {
+        file = AssetArchive::View();
+        return false;
+    }
+    memcpy(&header, file.data, sizeof(Header));
+    size_t block = blockBytes(header.format);
+    if (header.magic != MAGIC || header.version != VERSION || block == 0 || header.levels == 0 ||
+        file.size < sizeof(Header) + header.levels * sizeof(LevelEntry)) {
+        std::cerr << "Ignoring invalid texture cache file " << fileName << std::endl;
+        file = AssetArchive::View();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.levels; i++) {
+        LevelEntry entry;
+        memcpy(&entry, file.data + sizeof(Header) + i * sizeof(LevelEntry), sizeof(LevelEntry));
+        size_t expected = (size_t)((entry.width + 3) / 4) * ((entry.height + 3) / 4) * block;
+        if (entry.size != expected || entry.offset + entry.size > file.size) {
+            std::cerr << "Ignoring truncated texture cache file " << fileName << std::endl;
+            file = AssetArchive::View();
+            levelList.clear();
+            return false;
+        }
+        levelList.push_back({ (int)entry.width, (int)entry.height, (size_t)entry.offset, (size_t)entry.size });
+    }
+
+    glFormat = header.format;
+    sourceChannels = (int)header.channels;
+    flags = header.flags;
+    sourceSize = header.sourceSize;
+    sourceHashValue = header.sourceHash;
+    return true;
+}
+
+bool CompressedTextureFile::matches(const std::string &sourceFile, bool flipped) const {
+    if (!file.valid() || ((flags & FLAG_FLIPPED) != 0) != flipped)
+        return false;
+    uint64_t size = 0, hash = 0;
+    return sourceHash(sourceFile, size, hash) && size == sourceSize && hash == sourceHashValue;
+}
+
+void CompressedTextureFile::upload(GLenum target, GLenum internalFormat) const {
+    for (int i = 0; i < levels(); i++) {
+        const Level &l = levelList[i];
+        glCompressedTexSubImage2D(target, i, 0, 0, l.width, l.height, internalFormat, (GLsizei)l.size, data() + l.offset);
+    }
+}
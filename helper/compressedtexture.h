@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "assetarchive.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+// Block-compressed texture cache file (.ctex), written offline by the
+// texconvert tool and memory-mapped at load time, from an asset archive
+// when one holds it.
+//
+// A file holds one image (one cube map face) with its whole mip chain,
+// already in a GL compressed format (BC1, BC4, BC5 or BC7), so loading it is
+// a glCompressedTexImage2D per level: no PNG decode and no glGenerateMipmap.
+// The header records the size and a hash of the source image, and whether
+// its rows were flipped, so a stale cache is ignored rather than shown.
+//
+//   file layout (little-endian):
+//     Header
+//     LevelEntry[levels]      largest level first
+//     level data, each level 16-byte aligned
+class CompressedTextureFile {
+public:
+    static const uint32_t FLAG_FLIPPED = 1;
+
+    struct Level {
+        int width, height;
+        size_t offset;      // from data()
+        size_t size;
+    };
+
+    // media/textures/wood.png -> media/textures/wood.ctex
+    static std::string cachePath(const std::string &sourceFile);
+
+    // Size and 64-bit hash of a source file, as stored in the header
+    static bool sourceHash(const std::string &sourceFile, uint64_t &size, uint64_t &hash);
+
+    // Bytes per 4x4 block, or 0 for a format the cache does not use
+    static size_t blockBytes(GLenum format);
+
+    // The sRGB variant of a colour format; BC4 and BC5 have none and are returned as is
+    static GLenum srgbFormat(GLenum format);
+
+    // Compressed formats this context can sample, sRGB variants included;
+    // needs a current context
+    static std::vector<GLenum> supportedFormats();
+
+    static bool write(const std::string &fileName, GLenum format, int width, int height, int channels,
+                      uint32_t flags, uint64_t sourceSize, uint64_t sourceHash,
+                      const std::vector<std::vector<unsigned char>> &levels);
+
+    CompressedTextureFile();
+
+    bool open(const std::string &fileName);
+
+    // True if written from the current contents of sourceFile with the same orientation
+    bool matches(const std::string &sourceFile, bool flipped) const;
+
+    // Fills every level of target (a 2D texture or one cube map face) whose
+    // texture has storage for levels() levels of format() or its sRGB
+    // variant; needs a current context
+    void upload(GLenum target, GLenum internalFormat) const;
+
+    GLenum format() const { return glFormat; }
+    int width() const { return levelList.empty() ? 0 : levelList[0].width; }
+    int height() const { return levelList.empty() ? 0 : levelList[0].height; }
+    int channels() const { return sourceChannels; }
+    int levels() const { return (int)levelList.size(); }
+    const Level & level(int i) const { return levelList[i]; }
+
+    const unsigned char * data() const { return file.data; }
+    size_t size() const { return file.size; }
+
+private:
+    AssetArchive::View file;     // mapped, from an archive or the loose file
+    GLenum glFormat;
+    int sourceChannels;
+    uint32_t flags;
+    uint64_t sourceSize, sourceHashValue;
+    std::vector<Level> levelList;
+};
@@ -0,0 +1,45 @@
+#include "cpufeatures.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+    CpuFeatures::Simd detect() {
+#ifdef CPU_X86
+#ifdef _MSC_VER
+        // AVX2 needs the OS to save the YMM registers as well
+        int info[4];
+        __cpuid(info, 1);
+        bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        if (osAvx && (info[1] & (1 << 5)))
+            return CpuFeatures::SIMD_AVX2;
+#else
+        if (__builtin_cpu_supports("avx2"))
+            return CpuFeatures::SIMD_AVX2;
+#endif
+        return CpuFeatures::SIMD_SSE2;
+#else
+        return CpuFeatures::SIMD_SCALAR;
+#endif
+    }
+}
+
+namespace CpuFeatures {
+
+Simd supported() {
+    static const Simd detected = detect();
+    return detected;
+}
+
+const char * name(Simd simd) {
+    switch (simd) {
+    case SIMD_AVX2: return "AVX2";
+    case SIMD_SSE2: return "SSE2";
+    default: return "scalar";
+    }
+}
+
+} // namespace CpuFeatures
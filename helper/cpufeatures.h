@@ -0,0 +1,35 @@
+#pragma once
+
+// Instruction sets for hand-vectorized kernels, and which of them the CPU runs.
+//
+//   CPU_TARGET_AVX2
+//   void scaleAvx2(float *values, size_t count);   // may use AVX2 intrinsics
+//   ...
+//   if (CpuFeatures::supported() == CpuFeatures::SIMD_AVX2)
+//       scaleAvx2(values, count);
+//
+// CPU_X86 is defined, and <immintrin.h> included, where SSE2 is always
+// there.  CPU_TARGET_AVX2 compiles one function for AVX2 whatever the build
+// flags, so the rest of the program still runs on older CPUs; such a
+// function may only be called once supported() says so.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define CPU_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_TARGET_AVX2     // MSVC takes AVX2 intrinsics in any function
+#endif
+
+namespace CpuFeatures {
+
+    // In order, each a superset of the one before
+    enum Simd { SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2 };
+
+    // The widest the CPU and the OS support; checked once
+    Simd supported();
+
+    const char * name(Simd simd);
+}
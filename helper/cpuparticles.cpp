@@ -0,0 +1,269 @@
+#include "cpuparticles.h"
+
+#include "threadpool.h"
+#include "cpuprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    const size_t LANES = 8;                 // arrays are padded to this
+    const size_t BLOCK_SIZE = 16 * 1024;    // particles per ThreadPool job
+
+    // Everything about this frame's step that is the same for every particle
+    struct Step {
+        float cx, cy, cz;       // emitter
+        float radius;
+        float cosAngle, sinAngle;
+        float deltaTime;
+        float fall;             // gravity * deltaTime
+        float decay;            // lifeDecay * deltaTime
+        float speed;
+    };
+
+    struct Arrays {
+        float *x, *y, *z, *vx, *vy, *vz, *life;
+        const float *size, *spawnCos, *spawnSin;
+    };
+
+    typedef void (*Kernel)(const Step &step, const Arrays &a, size_t begin, size_t end, size_t count,
+                           CpuParticles::Vertex *out);
+
+    void updateScalar(const Step &s, const Arrays &a, size_t begin, size_t end, size_t count, CpuParticles::Vertex *out) {
+        for (size_t i = begin; i < end; i++) {
+            float life = a.life[i] - s.decay;
+            if (life <= 0.0f) {
+                // Respawn at this particle's own place on the ring
+                a.x[i] = s.cx + s.radius * a.spawnCos[i];
+                a.y[i] = s.cy;
+                a.z[i] = s.cz + s.radius * a.spawnSin[i];
+                a.vx[i] = -a.spawnSin[i] * s.speed;
+                a.vy[i] = 0.0f;
+                a.vz[i] = a.spawnCos[i] * s.speed;
+                a.life[i] = 1.0f;
+            } else {
+                // Orbit the emitter in XZ, fall, and move along the ring
+                float dx = a.x[i] - s.cx, dz = a.z[i] - s.cz;
+                float rx = s.cosAngle * dx - s.sinAngle * dz;
+                float rz = s.sinAngle * dx + s.cosAngle * dz;
+                float vy = a.vy[i] - s.fall;
+                float y = a.y[i] + vy * s.deltaTime;
+                float dy = y - s.cy;
+                float scale = s.speed / std::sqrt(rx * rx + dy * dy + rz * rz);
+                a.x[i] = s.cx + rx;
+                a.y[i] = y;
+                a.z[i] = s.cz + rz;
+                a.vx[i] = -rz * scale;
+                a.vy[i] = vy;
+                a.vz[i] = rx * scale;
+                a.life[i] = life;
+            }
+            if (out && i < count)
+                out[i] = { glm::vec3(a.x[i], a.y[i], a.z[i]), a.size[i] };
+        }
+    }
+
+#ifdef CPU_X86
+    // Four particles' x, y, z and size as four Vertex
+    inline void storeVertices(CpuParticles::Vertex *out, __m128 x, __m128 y, __m128 z, __m128 size) {
+        _MM_TRANSPOSE4_PS(x, y, z, size);
+        float *dst = &out->position.x;
+        _mm_storeu_ps(dst, x);
+        _mm_storeu_ps(dst + 4, y);
+        _mm_storeu_ps(dst + 8, z);
+        _mm_storeu_ps(dst + 12, size);
+    }
+
+    // Writes into out, or through a scratch copy for the lanes past count
+    template <size_t WIDTH>
+    struct VertexTarget {
+        CpuParticles::Vertex scratch[WIDTH];
+        CpuParticles::Vertex *out;
+        size_t i, count;
+
+        VertexTarget(CpuParticles::Vertex *out, size_t i, size_t count) : out(out), i(i), count(count) {}
+        CpuParticles::Vertex *get() { return i + WIDTH <= count ? out + i : scratch; }
+        void finish() {
+            if (i + WIDTH > count && i < count)
+                memcpy(out + i, scratch, (count - i) * sizeof(CpuParticles::Vertex));
+        }
+    };
+
+    void updateSse2(const Step &s, const Arrays &a, size_t begin, size_t end, size_t count, CpuParticles::Vertex *out) {
+        const __m128 cx = _mm_set1_ps(s.cx), cy = _mm_set1_ps(s.cy), cz = _mm_set1_ps(s.cz);
+        const __m128 radius = _mm_set1_ps(s.radius), cosA = _mm_set1_ps(s.cosAngle), sinA = _mm_set1_ps(s.sinAngle);
+        const __m128 dt = _mm_set1_ps(s.deltaTime), fall = _mm_set1_ps(s.fall), decay = _mm_set1_ps(s.decay);
+        const __m128 speed = _mm_set1_ps(s.speed), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        for (size_t i = begin; i < end; i += 4) {
+            __m128 life = _mm_sub_ps(_mm_loadu_ps(a.life + i), decay);
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(a.x + i), cx), dz = _mm_sub_ps(_mm_loadu_ps(a.z + i), cz);
+            __m128 rx = _mm_sub_ps(_mm_mul_ps(cosA, dx), _mm_mul_ps(sinA, dz));
+            __m128 rz = _mm_add_ps(_mm_mul_ps(sinA, dx), _mm_mul_ps(cosA, dz));
+            __m128 vy = _mm_sub_ps(_mm_loadu_ps(a.vy + i), fall);
+            __m128 y = _mm_add_ps(_mm_loadu_ps(a.y + i), _mm_mul_ps(vy, dt));
+            __m128 dy = _mm_sub_ps(y, cy);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(dy, dy)), _mm_mul_ps(rz, rz)));
+            __m128 scale = _mm_div_ps(speed, length);
+            __m128 x = _mm_add_ps(cx, rx), z = _mm_add_ps(cz, rz);
+            __m128 vx = _mm_mul_ps(_mm_sub_ps(zero, rz), scale), vz = _mm_mul_ps(rx, scale);
+
+            // Expired lanes respawn on the ring
+            __m128 dead = _mm_cmple_ps(life, zero);
+            if (_mm_movemask_ps(dead)) {
+                __m128 c = _mm_loadu_ps(a.spawnCos + i), s4 = _mm_loadu_ps(a.spawnSin + i);
+                auto pick = [dead](__m128 spawned, __m128 moved) {
+                    return _mm_or_ps(_mm_and_ps(dead, spawned), _mm_andnot_ps(dead, moved));
+                };
+                x = pick(_mm_add_ps(cx, _mm_mul_ps(radius, c)), x);
+                y = pick(cy, y);
+                z = pick(_mm_add_ps(cz, _mm_mul_ps(radius, s4)), z);
+                vx = pick(_mm_mul_ps(_mm_sub_ps(zero, s4), speed), vx);
+                vy = pick(zero, vy);
+                vz = pick(_mm_mul_ps(c, speed), vz);
+                life = pick(one, life);
+            }
+            _mm_storeu_ps(a.x + i, x);
+            _mm_storeu_ps(a.y + i, y);
+            _mm_storeu_ps(a.z + i, z);
+            _mm_storeu_ps(a.vx + i, vx);
+            _mm_storeu_ps(a.vy + i, vy);
+            _mm_storeu_ps(a.vz + i, vz);
+            _mm_storeu_ps(a.life + i, life);
+            if (out && i < count) {
+                VertexTarget<4> target(out, i, count);
+                storeVertices(target.get(), x, y, z, _mm_loadu_ps(a.size + i));
+                target.finish();
+            }
+        }
+    }
+
+    CPU_TARGET_AVX2
+    void updateAvx2(const Step &s, const Arrays &a, size_t begin, size_t end, size_t count, CpuParticles::Vertex *out) {
+        const __m256 cx = _mm256_set1_ps(s.cx), cy = _mm256_set1_ps(s.cy), cz = _mm256_set1_ps(s.cz);
+        const __m256 radius = _mm256_set1_ps(s.radius), cosA = _mm256_set1_ps(s.cosAngle), sinA = _mm256_set1_ps(s.sinAngle);
+        const __m256 dt = _mm256_set1_ps(s.deltaTime), fall = _mm256_set1_ps(s.fall), decay = _mm256_set1_ps(s.decay);
+        const __m256 speed = _mm256_set1_ps(s.speed), zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        for (size_t i = begin; i < end; i += 8) {
+            __m256 life = _mm256_sub_ps(_mm256_loadu_ps(a.life + i), decay);
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(a.x + i), cx), dz = _mm256_sub_ps(_mm256_loadu_ps(a.z + i), cz);
+            __m256 rx = _mm256_sub_ps(_mm256_mul_ps(cosA, dx), _mm256_mul_ps(sinA, dz));
+            __m256 rz = _mm256_add_ps(_mm256_mul_ps(sinA, dx), _mm256_mul_ps(cosA, dz));
+            __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(a.vy + i), fall);
+            __m256 y = _mm256_add_ps(_mm256_loadu_ps(a.y + i), _mm256_mul_ps(vy, dt));
+            __m256 dy = _mm256_sub_ps(y, cy);
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(dy, dy)),
+                                                         _mm256_mul_ps(rz, rz)));
+            __m256 scale = _mm256_div_ps(speed, length);
+            __m256 x = _mm256_add_ps(cx, rx), z = _mm256_add_ps(cz, rz);
+            __m256 vx = _mm256_mul_ps(_mm256_sub_ps(zero, rz), scale), vz = _mm256_mul_ps(rx, scale);
+
+            // Expired lanes respawn on the ring
+            __m256 dead = _mm256_cmp_ps(life, zero, _CMP_LE_OQ);
+            if (_mm256_movemask_ps(dead)) {
+                __m256 c = _mm256_loadu_ps(a.spawnCos + i), s8 = _mm256_loadu_ps(a.spawnSin + i);
+                x = _mm256_blendv_ps(x, _mm256_add_ps(cx, _mm256_mul_ps(radius, c)), dead);
+                y = _mm256_blendv_ps(y, cy, dead);
+                z = _mm256_blendv_ps(z, _mm256_add_ps(cz, _mm256_mul_ps(radius, s8)), dead);
+                vx = _mm256_blendv_ps(vx, _mm256_mul_ps(_mm256_sub_ps(zero, s8), speed), dead);
+                vy = _mm256_blendv_ps(vy, zero, dead);
+                vz = _mm256_blendv_ps(vz, _mm256_mul_ps(c, speed), dead);
+                life = _mm256_blendv_ps(life, one, dead);
+            }
+            _mm256_storeu_ps(a.x + i, x);
+            _mm256_storeu_ps(a.y + i, y);
+            _mm256_storeu_ps(a.z + i, z);
+            _mm256_storeu_ps(a.vx + i, vx);
+            _mm256_storeu_ps(a.vy + i, vy);
+            _mm256_storeu_ps(a.vz + i, vz);
+            _mm256_storeu_ps(a.life + i, life);
+            if (out && i < count) {
+                // Each half is four vertices
+                __m256 size = _mm256_loadu_ps(a.size + i);
+                VertexTarget<8> target(out, i, count);
+                CpuParticles::Vertex *dst = target.get();
+                storeVertices(dst, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y),
+                              _mm256_castps256_ps128(z), _mm256_castps256_ps128(size));
+                storeVertices(dst + 4, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+                              _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(size, 1));
+                target.finish();
+            }
+        }
+    }
+#endif
+}
+
+void CpuParticles::create(const std::vector<ParticleSystem::Particle> &particles) {
+    count = particles.size();
+    size_t padded = (count + LANES - 1) / LANES * LANES;
+    for (std::vector<float> *array : { &x, &y, &z, &vx, &vy, &vz, &sizes, &spawnCos, &spawnSin })
+        array->assign(padded, 0.0f);
+    // Padding lanes never expire, so they stay put
+    life.assign(padded, 1.0e30f);
+    for (size_t i = 0; i < count; i++) {
+        const ParticleSystem::Particle &p = particles[i];
+        x[i] = p.position.x;
+        y[i] = p.position.y;
+        z[i] = p.position.z;
+        vx[i] = p.velocity.x;
+        vy[i] = p.velocity.y;
+        vz[i] = p.velocity.z;
+        life[i] = p.life;
+        sizes[i] = p.size;
+        double theta = 2.0 * 3.14159265358979323846 * ((double)i / (double)count);
+        spawnCos[i] = (float)std::cos(theta);
+        spawnSin[i] = (float)std::sin(theta);
+    }
+}
+
+void CpuParticles::update(ThreadPool *pool, float deltaTime, const ParticleSystem::Settings &settings, Vertex *out) {
+    if (count == 0)
+        return;
+    PROFILE_SCOPE("CpuParticles::update");
+
+    float angle = settings.rotationSpeed * deltaTime;
+    Step step = {
+        settings.emitterPosition.x, settings.emitterPosition.y, settings.emitterPosition.z, settings.emitterRadius,
+        std::cos(angle), std::sin(angle), deltaTime, settings.gravity * deltaTime, settings.lifeDecay * deltaTime,
+        settings.speed
+    };
+    Arrays arrays = { x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), life.data(),
+                      sizes.data(), spawnCos.data(), spawnSin.data() };
+
+    Kernel kernel = updateScalar;
+#ifdef CPU_X86
+    if (simd == CpuFeatures::SIMD_AVX2)
+        kernel = updateAvx2;
+    else if (simd == CpuFeatures::SIMD_SSE2)
+        kernel = updateSse2;
+#endif
+
+    size_t padded = x.size();
+    int blocks = (int)((padded + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    auto block = [&](int b) {
+        size_t begin = (size_t)b * BLOCK_SIZE;
+        kernel(step, arrays, begin, std::min(padded, begin + BLOCK_SIZE), count, out);
+    };
+    if (pool && blocks > 1) {
+        pool->parallelFor(blocks, block);
+    } else {
+        for (int b = 0; b < blocks; b++)
+            block(b);
+    }
+}
+
+std::vector<ParticleSystem::Particle> CpuParticles::particles() const {
+    std::vector<ParticleSystem::Particle> result(count);
+    for (size_t i = 0; i < count; i++) {
+        result[i].position = glm::vec3(x[i], y[i], z[i]);
+        result[i].velocity = glm::vec3(vx[i], vy[i], vz[i]);
+        result[i].life = life[i];
+        result[i].size = sizes[i];
+    }
+    return result;
+}
+
+void CpuParticles::setSimd(CpuFeatures::Simd requested) {
+    simd = std::min(requested, CpuFeatures::supported());
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "cpufeatures.h"
+#include "particlesystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// The particle ring simulated on the CPU, for drivers where the GPU paths
+// are slower than a few cores (software rasterizers) or unavailable.
+//
+//   CpuParticles cpu;
+//   cpu.create(ParticleSystem::ring(count, settings, size));
+//   ...
+//   cpu.update(&pool, deltaTime, settings, stream.map());   // once a frame
+//
+// Behaves as ParticleSystem's particle_update.vert: every particle orbits
+// the emitter, falls under gravity and respawns at its own place on the
+// ring.  The particles are kept as separate arrays per component and
+// advanced four (SSE2) or eight (AVX2) at a time with the rotation's sine
+// and cosine computed once a frame, in blocks spread over a ThreadPool.
+// Each block writes its particles straight out as Vertex, so they can go
+// to a mapped vertex buffer without another pass.
+class CpuParticles {
+public:
+    // What update() writes per particle: attribute 0 and 3 of particle.vert
+    struct Vertex {
+        glm::vec3 position;
+        float size;
+    };
+
+    // Replaces every particle; particle i respawns where a ring of size()
+    // would put it, as particles[i] of ParticleSystem::ring does
+    void create(const std::vector<ParticleSystem::Particle> &particles);
+
+    // Advances every particle by deltaTime and writes all size() vertices
+    // to out, which may be null.  pool may be null to run on the caller.
+    void update(ThreadPool *pool, float deltaTime, const ParticleSystem::Settings &settings, Vertex *out);
+
+    // Back as array of structures, for checking against other paths
+    std::vector<ParticleSystem::Particle> particles() const;
+
+    size_t size() const { return count; }
+
+    // Kernels in use, the widest CpuFeatures::supported() by default;
+    // setSimd is clamped to that and exists to compare the paths
+    CpuFeatures::Simd activeSimd() const { return simd; }
+    void setSimd(CpuFeatures::Simd requested);
+
+private:
+    // Padded to a multiple of eight so the kernels need no remainder loop
+    std::vector<float> x, y, z, vx, vy, vz, life, sizes;
+    std::vector<float> spawnCos, spawnSin;     // where each particle respawns
+    size_t count = 0;
+    CpuFeatures::Simd simd = CpuFeatures::supported();
+};
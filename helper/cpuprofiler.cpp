@@ -0,0 +1,91 @@
+#include "cpuprofiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CpuProfiler {
+
+namespace {
+
+    const size_t RING_SIZE = 1 << 16;   // events kept per thread
+
+    struct ThreadBuffer {
+        Event events[RING_SIZE];
+        std::atomic<uint64_t> written{0};
+        int threadId = 0;
+    };
+
+    // Buffers are shared with the registry so they survive their thread
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    ThreadBuffer & localBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffer->threadId = (int)registry.size();
+            registry.push_back(buffer);
+        }
+        return *buffer;
+    }
+}
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+void record(const char *name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer &buffer = localBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    Event &e = buffer.events[index % RING_SIZE];
+    e.name = name;
+    e.startNs = startNs;
+    e.durationNs = endNs - startNs;
+    // Publish the event to a concurrent dump
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string &fileName) {
+    std::ofstream out(fileName);
+    if (!out) {
+        std::cerr << "Unable to write CPU trace: " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::shared_ptr<ThreadBuffer> &buffer : buffers) {
+        // Only the most recent RING_SIZE events of each thread are still in the ring
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+        for (uint64_t i = begin; i < end; i++) {
+            const Event &e = buffer->events[i % RING_SIZE];
+            char line[256];
+            snprintf(line, sizeof(line),
+                     "%s{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",\n", e.name, buffer->threadId, e.startNs / 1000.0, e.durationNs / 1000.0);
+            out << line;
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return true;
+}
+
+} // namespace CpuProfiler
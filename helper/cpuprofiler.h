@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Lightweight CPU scope timing.
+//
+//   void Foo::bar() {
+//       PROFILE_SCOPE("Foo::bar");
+//       ...
+//   }
+//
+// Each thread records into its own fixed-size ring buffer, so the hot path
+// is two clock reads and a store with no locking.  Only the first zone on a
+// thread takes a lock, to register its buffer for dumping.  Define
+// CPU_PROFILER_DISABLED to compile the macros away.
+namespace CpuProfiler {
+
+    struct Event {
+        const char *name;    // must be a string literal or otherwise outlive the profiler
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    uint64_t nowNs();
+    void record(const char *name, uint64_t startNs, uint64_t endNs);
+
+    // Writes every buffered zone from every thread in Chrome trace / Perfetto JSON format
+    bool writeChromeTrace(const std::string &fileName);
+
+    class ScopedZone {
+    public:
+        explicit ScopedZone(const char *name) : name(name), start(nowNs()) {}
+        ~ScopedZone() { record(name, start, nowNs()); }
+
+        ScopedZone(const ScopedZone &) = delete;
+        ScopedZone & operator=(const ScopedZone &) = delete;
+
+    private:
+        const char *name;
+        uint64_t start;
+    };
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef CPU_PROFILER_DISABLED
+#define PROFILE_SCOPE(name) CpuProfiler::ScopedZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
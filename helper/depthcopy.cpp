@@ -0,0 +1,37 @@
+#include "depthcopy.h"
+
+#include <algorithm>
+
+DepthCopy::DepthCopy() : depth(0), size{ 0, 0 } {}
+
+DepthCopy::~DepthCopy() {
+    release();
+}
+
+void DepthCopy::release() {
+    if (depth != 0)
+        glDeleteTextures(1, &depth);
+    depth = 0;
+}
+
+void DepthCopy::create(int width, int height) {
+    release();
+    size[0] = std::max(1, width);
+    size[1] = std::max(1, height);
+    glGenTextures(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, size[0], size[1]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void DepthCopy::copy(GLuint framebuffer) {
+    if (depth == 0)
+        return;
+    // CopyTexSubImage converts whatever depth format the framebuffer has
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, size[0], size[1]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// A copy of a framebuffer's depth that shaders can sample while the
+// framebuffer's own depth buffer stays bound for testing.
+//
+//   DepthCopy sceneDepth;
+//   sceneDepth.create(width, height);
+//   ...
+//   sceneDepth.copy(framebuffer);      // once, after the opaque pass
+//   hiZ.build(sceneDepth.texture());
+//
+// One copy serves every pass that reads the opaque depth in a frame.
+class DepthCopy {
+public:
+    DepthCopy();
+    ~DepthCopy();
+
+    DepthCopy(const DepthCopy &) = delete;
+    DepthCopy & operator=(const DepthCopy &) = delete;
+
+    // (Re)allocates for a framebuffer of this size
+    void create(int width, int height);
+
+    // Copies the depth attachment of framebuffer, which must be width x
+    // height and single sampled; leaves it bound for reading
+    void copy(GLuint framebuffer);
+
+    // DEPTH_COMPONENT32F, nearest filtered; 0 before create()
+    GLuint texture() const { return depth; }
+    int width() const { return size[0]; }
+    int height() const { return size[1]; }
+
+private:
+    GLuint depth;
+    int size[2];
+
+    void release();
+};
@@ -0,0 +1,105 @@
+#include "frustum.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define FRUSTUM_SSE 1
+#include <immintrin.h>
+#endif
+
+Frustum Frustum::fromMatrix(const glm::mat4 &m) {
+    // Gribb and Hartmann: each clip plane is the last row plus or minus another
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    Frustum frustum;
+    for (int i = 0; i < 3; i++) {
+        frustum.planes[i * 2] = rows[3] + rows[i];
+        frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+    }
+    for (glm::vec4 &plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+bool Frustum::testSphere(const glm::vec3 &center, float radius) const {
+    for (const glm::vec4 &plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+#ifdef FRUSTUM_SSE
+
+unsigned Frustum::testSpheres4(const float x[4], const float y[4], const float z[4], const float radius[4]) const {
+    __m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius));
+    __m128 outside = _mm_setzero_ps();
+    for (const glm::vec4 &plane : planes) {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane.x)), _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+                                     _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+    }
+    return ~(unsigned)_mm_movemask_ps(outside) & 0xF;
+}
+
+unsigned Frustum::testBoxes4(const float minX[4], const float minY[4], const float minZ[4],
+                             const float maxX[4], const float maxY[4], const float maxZ[4], unsigned *inside) const {
+    __m128 lo[3] = { _mm_loadu_ps(minX), _mm_loadu_ps(minY), _mm_loadu_ps(minZ) };
+    __m128 hi[3] = { _mm_loadu_ps(maxX), _mm_loadu_ps(maxY), _mm_loadu_ps(maxZ) };
+    __m128 outside = _mm_setzero_ps(), crossing = _mm_setzero_ps();
+    for (const glm::vec4 &plane : planes) {
+        // The corner furthest along the normal decides outside, the nearest inside
+        __m128 farthest = _mm_set1_ps(plane.w), nearest = farthest;
+        for (int axis = 0; axis < 3; axis++) {
+            __m128 n = _mm_set1_ps(plane[axis]);
+            bool positive = plane[axis] >= 0.0f;
+            farthest = _mm_add_ps(farthest, _mm_mul_ps(n, positive ? hi[axis] : lo[axis]));
+            nearest = _mm_add_ps(nearest, _mm_mul_ps(n, positive ? lo[axis] : hi[axis]));
+        }
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(farthest, _mm_setzero_ps()));
+        crossing = _mm_or_ps(crossing, _mm_cmplt_ps(nearest, _mm_setzero_ps()));
+    }
+    unsigned visible = ~(unsigned)_mm_movemask_ps(outside) & 0xF;
+    if (inside)
+        *inside = visible & ~(unsigned)_mm_movemask_ps(crossing);
+    return visible;
+}
+
+#else
+
+unsigned Frustum::testSpheres4(const float x[4], const float y[4], const float z[4], const float radius[4]) const {
+    unsigned visible = 0;
+    for (int i = 0; i < 4; i++) {
+        if (testSphere(glm::vec3(x[i], y[i], z[i]), radius[i]))
+            visible |= 1u << i;
+    }
+    return visible;
+}
+
+unsigned Frustum::testBoxes4(const float minX[4], const float minY[4], const float minZ[4],
+                             const float maxX[4], const float maxY[4], const float maxZ[4], unsigned *inside) const {
+    unsigned visible = 0, entirely = 0;
+    for (int i = 0; i < 4; i++) {
+        glm::vec3 lo(minX[i], minY[i], minZ[i]), hi(maxX[i], maxY[i], maxZ[i]);
+        bool out = false, crossing = false;
+        for (const glm::vec4 &plane : planes) {
+            glm::vec3 farthest, nearest;
+            for (int axis = 0; axis < 3; axis++) {
+                farthest[axis] = plane[axis] >= 0.0f ? hi[axis] : lo[axis];
+                nearest[axis] = plane[axis] >= 0.0f ? lo[axis] : hi[axis];
+            }
+            out = out || glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f;
+            crossing = crossing || glm::dot(glm::vec3(plane), nearest) + plane.w < 0.0f;
+        }
+        if (!out) {
+            visible |= 1u << i;
+            if (!crossing)
+                entirely |= 1u << i;
+        }
+    }
+    if (inside)
+        *inside = entirely;
+    return visible;
+}
+
+#endif
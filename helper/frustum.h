@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// View frustum for culling on the CPU.
+//
+//   Frustum frustum = Frustum::fromMatrix(projection * view);
+//   if (frustum.testSphere(center, radius)) ...
+//
+// Six unit planes pointing inwards, extracted from a view-projection matrix
+// (perspective or orthographic, so the light's lightSpaceMatrix works too).
+// The four-wide tests take their boxes or spheres as separate x, y, z ...
+// arrays and check all four against every plane at once with SSE, or one at
+// a time where SSE is unavailable.  All of them are conservative: a shape
+// near a frustum corner may pass although it is outside.
+struct Frustum {
+    enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+    // xyz normal, w distance; a point p is inside when dot(xyz, p) + w >= 0
+    glm::vec4 planes[PLANE_COUNT];
+
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+    bool testSphere(const glm::vec3 &center, float radius) const;
+
+    // Bit i set when sphere i is at least partly inside
+    unsigned testSpheres4(const float x[4], const float y[4], const float z[4], const float radius[4]) const;
+
+    // Bit i set when box i is at least partly inside; bits of inside are set
+    // for the boxes that are entirely inside
+    unsigned testBoxes4(const float minX[4], const float minY[4], const float minZ[4],
+                        const float maxX[4], const float maxY[4], const float maxZ[4], unsigned *inside = nullptr) const;
+};
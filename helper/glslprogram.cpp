@@ -1,6 +1,9 @@
 #include "glslprogram.h"
 
 #include "glutils.h"
+#include "cpuprofiler.h"
+#include "programcache.h"
+#include "assetarchive.h"
 
 #include <fstream>
 
@@ -34,7 +37,8 @@ namespace GLSLShaderInfo {
 	};
 }
 
-GLSLProgram::GLSLProgram() : handle(0), linked(false) {}
+GLSLProgram::GLSLProgram() : handle(0), linked(false), deferStatus(false), cacheable(false), cacheKey(0),
+    uniformCount(0) {}
 
 GLSLProgram::~GLSLProgram() {
     if (handle == 0) return;
@@ -96,7 +100,10 @@ string GLSLProgram::getExtension(const char *name) {
 
 void GLSLProgram::compileShader(const char *fileName,
                                 GLSLShader::GLSLShaderType type) {
-    if (!fileExists(fileName)) {
+    PROFILE_SCOPE("GLSLProgram::compileShader(file)");
+    // One lookup in the mounted archives, or one mapping of the loose file
+    AssetArchive::View file;
+    if (!AssetArchive::load(fileName, file)) {
         string message = string("Shader: ") + fileName + " not found.";
         throw GLSLProgramException(message);
     }
@@ -108,23 +115,13 @@ void GLSLProgram::compileShader(const char *fileName,
         }
     }
 
-    ifstream inFile(fileName, ios::in);
-    if (!inFile) {
-        string message = string("Unable to open: ") + fileName;
-        throw GLSLProgramException(message);
-    }
-
-    // Get file contents
-    std::stringstream code;
-    code << inFile.rdbuf();
-    inFile.close();
-
-    compileShader(code.str(), type, fileName);
+    compileShader(string((const char *)file.data, file.size), type, fileName);
 }
 
 void GLSLProgram::compileShader(const string &source,
                                 GLSLShader::GLSLShaderType type,
                                 const char *fileName) {
+    PROFILE_SCOPE("GLSLProgram::compileShader");
     if (handle <= 0) {
         handle = glCreateProgram();
         if (handle == 0) {
@@ -132,6 +129,18 @@ void GLSLProgram::compileShader(const string &source,
         }
     }
 
+    // With the binary cache on, stages are only compiled if link() misses the cache
+    if (ProgramBinaryCache::enabled()) {
+        pendingShaders.push_back({ type, source, fileName ? fileName : "" });
+        return;
+    }
+
+    compileAndAttach(source, type, fileName);
+}
+
+void GLSLProgram::compileAndAttach(const string &source,
+                                   GLSLShader::GLSLShaderType type,
+                                   const char *fileName) {
     GLuint shaderHandle = glCreateShader(type);
 
     const char *c_code = source.c_str();
@@ -140,41 +149,125 @@ void GLSLProgram::compileShader(const string &source,
     // Compile the shader
     glCompileShader(shaderHandle);
 
+    // In a batch the result is only read in finishBuild(), so the driver can
+    // keep compiling in the background
+    if (deferStatus) {
+        glAttachShader(handle, shaderHandle);
+        submittedShaders.push_back({ shaderHandle, fileName ? fileName : "" });
+        return;
+    }
+
+    std::string msg = shaderLog(shaderHandle, fileName);
+    if (!msg.empty()) {
+        glDeleteShader(shaderHandle);
+        throw GLSLProgramException(msg);
+    }
+
+    // Compile succeeded, attach shader
+    glAttachShader(handle, shaderHandle);
+}
+
+string GLSLProgram::shaderLog(GLuint shaderHandle, const char *fileName) {
     // Check for errors
     int result;
     glGetShaderiv(shaderHandle, GL_COMPILE_STATUS, &result);
-    if (GL_FALSE == result) {
-        // Compile failed, get log
-		std::string msg;
-		if (fileName) {
-			msg = string(fileName) + ": shader compliation failed\n";
-		}
-		else {
-			msg = "Shader compilation failed.\n";
-		}
+    if (GL_FALSE != result)
+        return "";
 
-        int length = 0;
-        glGetShaderiv(shaderHandle, GL_INFO_LOG_LENGTH, &length);
-        if (length > 0) {
-            std::string log(length, ' ');
-            int written = 0;
-            glGetShaderInfoLog(shaderHandle, length, &written, &log[0]);
-			msg += log;
-        }
-        throw GLSLProgramException(msg);
-    } else {
-        // Compile succeeded, attach shader
-        glAttachShader(handle, shaderHandle);
+    // Compile failed, get log
+    std::string msg;
+    if (fileName) {
+        msg = string(fileName) + ": shader compliation failed\n";
+    }
+    else {
+        msg = "Shader compilation failed.\n";
+    }
+
+    int length = 0;
+    glGetShaderiv(shaderHandle, GL_INFO_LOG_LENGTH, &length);
+    if (length > 0) {
+        std::string log(length, ' ');
+        int written = 0;
+        glGetShaderInfoLog(shaderHandle, length, &written, &log[0]);
+        msg += log;
     }
+    return msg;
 }
 
 void GLSLProgram::link() {
+    PROFILE_SCOPE("GLSLProgram::link");
+    if (linked) return;
+    submitLink();
+    finishBuild();
+}
+
+void GLSLProgram::submitShader(const char *fileName) {
+    deferStatus = true;
+    compileShader(fileName);
+}
+
+void GLSLProgram::submitLink() {
     if (linked) return;
     if (handle <= 0) throw GLSLProgramException("Program has not been compiled.");
 
+    cacheable = !pendingShaders.empty();
+    if (cacheable) {
+        std::vector<PendingShader> shaders;
+        shaders.swap(pendingShaders);
+
+        std::vector<ProgramBinaryCache::ShaderSource> sources;
+        for (const PendingShader &shader : shaders)
+            sources.push_back({ (GLenum)shader.type, shader.source });
+        // The captured outputs are part of the linked program too
+        for (const std::string &name : feedbackVaryings)
+            sources.push_back({ (GLenum)GL_TRANSFORM_FEEDBACK_VARYINGS, name });
+        cacheKey = ProgramBinaryCache::key(sources);
+
+        if (ProgramBinaryCache::load(handle, cacheKey)) {
+            findUniformLocations();
+            linked = true;
+            deferStatus = false;
+            return;
+        }
+
+        for (const PendingShader &shader : shaders)
+            compileAndAttach(shader.source, shader.type, shader.fileName.empty() ? NULL : shader.fileName.c_str());
+        glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    if (!feedbackVaryings.empty()) {
+        std::vector<const char *> names;
+        for (const std::string &name : feedbackVaryings)
+            names.push_back(name.c_str());
+        glTransformFeedbackVaryings(handle, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+    }
     glLinkProgram(handle);
+}
+
+bool GLSLProgram::buildComplete() {
+    if (linked || !GLUtils::hasParallelShaderCompile())
+        return true;
+
+    GLint complete = GL_TRUE;
+    glGetProgramiv(handle, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void GLSLProgram::finishBuild() {
+    deferStatus = false;
+    if (linked) return;
+
+    // Compile errors explain a failed link better than the link log does
+    std::string errString;
+    for (const SubmittedShader &shader : submittedShaders)
+        errString += shaderLog(shader.handle, shader.fileName.empty() ? NULL : shader.fileName.c_str());
+    submittedShaders.clear();
+    if (!errString.empty()) {
+        detachAndDeleteShaderObjects();
+        throw GLSLProgramException(errString);
+    }
+
 	int status = 0;
-	std::string errString;
 	glGetProgramiv(handle, GL_LINK_STATUS, &status);
 	if (GL_FALSE == status) {
 		// Store log and return false
@@ -191,6 +284,8 @@ void GLSLProgram::link() {
 	else {
 		findUniformLocations();
 		linked = true;
+		if (cacheable)
+			ProgramBinaryCache::store(handle, cacheKey);
 	}
 	 
 	detachAndDeleteShaderObjects();
@@ -198,8 +293,67 @@ void GLSLProgram::link() {
 	if( GL_FALSE == status ) throw GLSLProgramException(errString);
 }
 
+UniformUploadStats GLSLProgram::uploadStats;
+
+GLSLProgram::UniformEntry GLSLProgram::insertUniform(uint64_t hash, GLint location) {
+    // Each active location gets its own shadow copy, invalid until first set
+    UniformEntry entry = { hash, location, -1 };
+    if (location >= 0) {
+        entry.slot = (int)uniformShadows.size();
+        uniformShadows.push_back(UniformShadow());
+        uniformShadows.back().valid = false;
+    }
+    placeUniform(entry);
+    return entry;
+}
+
+void GLSLProgram::placeUniform(const UniformEntry &entry) {
+    // Keep the table at most half full; 0 marks an empty slot
+    if ((uniformCount + 1) * 2 > uniformTable.size()) {
+        std::vector<UniformEntry> old;
+        old.swap(uniformTable);
+        uniformTable.assign(old.empty() ? 32 : old.size() * 2, UniformEntry{ 0, -1, -1 });
+        uniformCount = 0;
+        for (const UniformEntry &e : old) {
+            if (e.hash != 0)
+                placeUniform(e);
+        }
+    }
+
+    size_t mask = uniformTable.size() - 1;
+    size_t i = entry.hash & mask;
+    while (uniformTable[i].hash != 0 && uniformTable[i].hash != entry.hash)
+        i = (i + 1) & mask;
+    if (uniformTable[i].hash == 0)
+        uniformCount++;
+    uniformTable[i] = entry;
+}
+
 void GLSLProgram::findUniformLocations() {
-    uniformLocations.clear();
+    uniformTable.clear();
+    uniformCount = 0;
+    uniformShadows.clear();
+    std::map<uint64_t, std::string> seen;   // collision check, link time only
+    auto addUniform = [this, &seen](const char *name, GLint location) {
+        uint64_t hash = hashName(name);
+        auto it = seen.find(hash);
+        if (it != seen.end() && it->second != name)
+            throw GLSLProgramException("Uniform name hash collision: " + it->second + " / " + name);
+        seen[hash] = name;
+        insertUniform(hash, location);
+    };
+    // Arrays are listed once as "name[0]"; the other elements get their own entries
+    auto addArray = [this, &addUniform](const char *name, GLint location, GLint size) {
+        addUniform(name, location);
+        std::string base(name);
+        if (size < 2 || base.size() < 3 || base.compare(base.size() - 3, 3, "[0]") != 0)
+            return;
+        base.resize(base.size() - 3);
+        for (GLint i = 1; i < size; i++) {
+            std::string element = base + "[" + std::to_string(i) + "]";
+            addUniform(element.c_str(), glGetUniformLocation(handle, element.c_str()));
+        }
+    };
 
     GLint numUniforms = 0;
 #ifdef __APPLE__
@@ -216,25 +370,24 @@ void GLSLProgram::findUniformLocations() {
         GLenum type;
         GLsizei written;
         glGetActiveUniform(handle, i, maxLen, &written, &size, &type, name);
-        GLint location = glGetUniformLocation(handle, name);
-        uniformLocations[name] = glGetUniformLocation(handle, name);
+        addArray(name, glGetUniformLocation(handle, name), size);
     }
     delete[] name;
 #else
     // For OpenGL 4.3 and above, use glGetProgramResource
     glGetProgramInterfaceiv( handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
 
-    GLenum properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX};
+    GLenum properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_BLOCK_INDEX, GL_ARRAY_SIZE};
 
     for( GLint i = 0; i < numUniforms; ++i ) {
-      GLint results[4];
-      glGetProgramResourceiv(handle, GL_UNIFORM, i, 4, properties, 4, NULL, results);
+      GLint results[5];
+      glGetProgramResourceiv(handle, GL_UNIFORM, i, 5, properties, 5, NULL, results);
 
       if( results[3] != -1 ) continue;  // Skip uniforms in blocks
       GLint nameBufSize = results[0] + 1;
       char * name = new char[nameBufSize];
       glGetProgramResourceName(handle, GL_UNIFORM, i, nameBufSize, NULL, name);
-      uniformLocations[name] = results[2];
+      addArray(name, results[2], results[4]);
       delete [] name;
     }
 #endif
@@ -262,53 +415,116 @@ void GLSLProgram::bindFragDataLocation(GLuint location, const char *name) {
     glBindFragDataLocation(handle, location, name);
 }
 
+void GLSLProgram::setTransformFeedbackVaryings(const std::vector<std::string> &names) {
+    feedbackVaryings = names;
+}
+
 void GLSLProgram::setUniform(const char *name, float x, float y, float z) {
-    GLint loc = getUniformLocation(name);
-    glUniform3f(loc, x, y, z);
+    this->setUniform(name, glm::vec3(x, y, z));
 }
 
 void GLSLProgram::setUniform(const char *name, const glm::vec3 &v) {
-    this->setUniform(name, v.x, v.y, v.z);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform3f(u.location, v.x, v.y, v.z);
 }
 
 void GLSLProgram::setUniform(const char *name, const glm::vec4 &v) {
-    GLint loc = getUniformLocation(name);
-    glUniform4f(loc, v.x, v.y, v.z, v.w);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform4f(u.location, v.x, v.y, v.z, v.w);
 }
 
 void GLSLProgram::setUniform(const char *name, const glm::vec2 &v) {
-    GLint loc = getUniformLocation(name);
-    glUniform2f(loc, v.x, v.y);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform2f(u.location, v.x, v.y);
 }
 
 void GLSLProgram::setUniform(const char *name, const glm::mat4 &m) {
-    GLint loc = getUniformLocation(name);
-    glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0][0]);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &m, sizeof(m)))
+        glUniformMatrix4fv(u.location, 1, GL_FALSE, &m[0][0]);
 }
 
 void GLSLProgram::setUniform(const char *name, const glm::mat3 &m) {
-    GLint loc = getUniformLocation(name);
-    glUniformMatrix3fv(loc, 1, GL_FALSE, &m[0][0]);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &m, sizeof(m)))
+        glUniformMatrix3fv(u.location, 1, GL_FALSE, &m[0][0]);
 }
 
 void GLSLProgram::setUniform(const char *name, float val) {
-    GLint loc = getUniformLocation(name);
-    glUniform1f(loc, val);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1f(u.location, val);
 }
 
 void GLSLProgram::setUniform(const char *name, int val) {
-    GLint loc = getUniformLocation(name);
-    glUniform1i(loc, val);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1i(u.location, val);
 }
 
 void GLSLProgram::setUniform(const char *name, GLuint val) {
-    GLint loc = getUniformLocation(name);
-    glUniform1ui(loc, val);
+    UniformEntry u = lookupUniform(name);
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1ui(u.location, val);
 }
 
 void GLSLProgram::setUniform(const char *name, bool val) {
-    int loc = getUniformLocation(name);
-    glUniform1i(loc, val);
+    this->setUniform(name, (int)val);
+}
+
+void GLSLProgram::setUniform(UniformHandle<float> u, float val) {
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1f(u.location, val);
+}
+
+void GLSLProgram::setUniform(UniformHandle<int> u, int val) {
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1i(u.location, val);
+}
+
+void GLSLProgram::setUniform(UniformHandle<bool> u, bool val) {
+    int i = val;
+    if (uniformChanged(u.slot, &i, sizeof(i)))
+        glUniform1i(u.location, i);
+}
+
+void GLSLProgram::setUniform(UniformHandle<GLuint> u, GLuint val) {
+    if (uniformChanged(u.slot, &val, sizeof(val)))
+        glUniform1ui(u.location, val);
+}
+
+void GLSLProgram::setUniform(UniformHandle<glm::vec2> u, const glm::vec2 &v) {
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform2f(u.location, v.x, v.y);
+}
+
+void GLSLProgram::setUniform(UniformHandle<glm::vec3> u, const glm::vec3 &v) {
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform3f(u.location, v.x, v.y, v.z);
+}
+
+void GLSLProgram::setUniform(UniformHandle<glm::vec4> u, const glm::vec4 &v) {
+    if (uniformChanged(u.slot, &v, sizeof(v)))
+        glUniform4f(u.location, v.x, v.y, v.z, v.w);
+}
+
+void GLSLProgram::setUniform(UniformHandle<glm::mat3> u, const glm::mat3 &m) {
+    if (uniformChanged(u.slot, &m, sizeof(m)))
+        glUniformMatrix3fv(u.location, 1, GL_FALSE, &m[0][0]);
+}
+
+void GLSLProgram::setUniform(UniformHandle<glm::mat4> u, const glm::mat4 &m) {
+    if (uniformChanged(u.slot, &m, sizeof(m)))
+        glUniformMatrix4fv(u.location, 1, GL_FALSE, &m[0][0]);
+}
+
+void GLSLProgram::bindUniformBlock(const char *blockName, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(handle, blockName);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(handle, index, binding);
 }
 
 void GLSLProgram::printActiveUniforms() {
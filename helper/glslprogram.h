@@ -8,6 +8,9 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <cstdint>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <stdexcept>
 
@@ -28,14 +31,73 @@ namespace GLSLShader {
     };
 };
 
+// A uniform location resolved once after linking.  The type parameter only
+// selects the matching setUniform overload, so a handle cannot be set with
+// a value of the wrong type.
+template <typename T>
+struct UniformHandle {
+    GLint location = -1;
+    int slot = -1;      // index of the program's shadow copy of the value
+    bool valid() const { return location >= 0; }
+};
+
+// glUniform* calls made through GLSLProgram, across all programs
+struct UniformUploadStats {
+    uint64_t issued = 0;
+    uint64_t skipped = 0;   // value matched the shadow copy, no GL call made
+};
+
 class GLSLProgram {
 private:
+    // Open-addressed table of uniform name hashes to locations.  Names are
+    // checked for hash collisions once when the table is built, so lookups
+    // never compare strings or allocate.
+    struct UniformEntry {
+        uint64_t hash;
+        GLint location;
+        int slot;
+    };
+
+    // Last value uploaded to each active uniform.  Uniform values are program
+    // state, so a set that matches the copy can be skipped; anything that
+    // calls glUniform* on this program directly must go through here instead.
+    struct UniformShadow {
+        GLfloat value[16];      // large enough for a mat4; ints are stored bitwise
+        bool valid;
+    };
+
+    // Stage sources held back until link() when the program binary cache is on
+    struct PendingShader {
+        GLSLShader::GLSLShaderType type;
+        std::string source;
+        std::string fileName;
+    };
+
+    // Compiled in a batch, compile status not yet read
+    struct SubmittedShader {
+        GLuint handle;
+        std::string fileName;
+    };
+
     GLuint handle;
     bool linked;
-    std::map<std::string, int> uniformLocations;
-
-    inline GLint getUniformLocation(const char *name);
+    bool deferStatus;
+    bool cacheable;
+    uint64_t cacheKey;
+    std::vector<PendingShader> pendingShaders;
+    std::vector<std::string> feedbackVaryings;
+    std::vector<SubmittedShader> submittedShaders;
+    std::vector<UniformEntry> uniformTable;
+    size_t uniformCount;
+    std::vector<UniformShadow> uniformShadows;
+
+    inline UniformEntry lookupUniform(const char *name);
+    UniformEntry insertUniform(uint64_t hash, GLint location);
+    void placeUniform(const UniformEntry &entry);
+    inline bool uniformChanged(int slot, const void *value, size_t size);
 	void detachAndDeleteShaderObjects();
+    void compileAndAttach(const std::string &source, GLSLShader::GLSLShaderType type, const char *fileName);
+    std::string shaderLog(GLuint shaderHandle, const char *fileName);
     bool fileExists(const std::string &fileName);
     std::string getExtension(const char *fileName);
 
@@ -54,6 +116,15 @@ public:
 
     void link();
     void validate();
+
+    // Two-phase build used by ShaderBatch: submitShader() and submitLink()
+    // queue work without reading any status back, buildComplete() polls
+    // without blocking where KHR_parallel_shader_compile is available, and
+    // finishBuild() reports errors the way compileShader() and link() do.
+    void submitShader(const char *fileName);
+    void submitLink();
+    bool buildComplete();
+    void finishBuild();
     void use();
 
     int getHandle();
@@ -62,6 +133,10 @@ public:
     void bindAttribLocation(GLuint location, const char *name);
     void bindFragDataLocation(GLuint location, const char *name);
 
+    // Outputs captured by transform feedback, interleaved in this order into
+    // one buffer.  Call before link() or ShaderBatch::build().
+    void setTransformFeedbackVaryings(const std::vector<std::string> &names);
+
     void setUniform(const char *name, float x, float y, float z);
     void setUniform(const char *name, const glm::vec2 &v);
     void setUniform(const char *name, const glm::vec3 &v);
@@ -73,6 +148,37 @@ public:
     void setUniform(const char *name, bool val);
     void setUniform(const char *name, GLuint val);
 
+    // FNV-1a; constexpr so names can also be hashed at compile time
+    static constexpr uint64_t hashName(const char *name, uint64_t h = 14695981039346656037ull) {
+        return *name ? hashName(name + 1, (h ^ (uint8_t)*name) * 1099511628211ull) : h;
+    }
+
+    // Resolve a uniform once, then set it every frame without any lookup
+    template <typename T>
+    UniformHandle<T> uniform(const char *name) {
+        UniformEntry entry = lookupUniform(name);
+        UniformHandle<T> h;
+        h.location = entry.location;
+        h.slot = entry.slot;
+        return h;
+    }
+
+    static UniformUploadStats uploadStats;
+
+    void setUniform(UniformHandle<float> u, float val);
+    void setUniform(UniformHandle<int> u, int val);
+    void setUniform(UniformHandle<bool> u, bool val);
+    void setUniform(UniformHandle<GLuint> u, GLuint val);
+    void setUniform(UniformHandle<glm::vec2> u, const glm::vec2 &v);
+    void setUniform(UniformHandle<glm::vec3> u, const glm::vec3 &v);
+    void setUniform(UniformHandle<glm::vec4> u, const glm::vec4 &v);
+    void setUniform(UniformHandle<glm::mat3> u, const glm::mat3 &m);
+    void setUniform(UniformHandle<glm::mat4> u, const glm::mat4 &m);
+
+    // Points a uniform block at a buffer binding point; ignored if the
+    // program does not use the block
+    void bindUniformBlock(const char *blockName, GLuint binding);
+
     void findUniformLocations();
     void printActiveUniforms();
     void printActiveUniformBlocks();
@@ -81,15 +187,33 @@ public:
     const char *getTypeString(GLenum type);
 };
 
-int GLSLProgram::getUniformLocation(const char *name) {
-	auto pos = uniformLocations.find(name);
+GLSLProgram::UniformEntry GLSLProgram::lookupUniform(const char *name) {
+	uint64_t hash = hashName(name);
 
-	if (pos == uniformLocations.end()) {
-		GLint loc = glGetUniformLocation(handle, name);
-		uniformLocations[name] = loc;
-		return loc;
+	if (!uniformTable.empty()) {
+		size_t mask = uniformTable.size() - 1;
+		for (size_t i = hash & mask; uniformTable[i].hash != 0; i = (i + 1) & mask) {
+			if (uniformTable[i].hash == hash)
+				return uniformTable[i];
+		}
 	}
 
-	return pos->second;
+	// Not an active uniform found at link time (e.g. an array element); ask once and remember
+	return insertUniform(hash, glGetUniformLocation(handle, name));
+}
+
+bool GLSLProgram::uniformChanged(int slot, const void *value, size_t size) {
+	if (slot < 0)
+		return false;   // inactive uniform, nothing to upload
+
+	UniformShadow &shadow = uniformShadows[slot];
+	if (shadow.valid && memcmp(shadow.value, value, size) == 0) {
+		uploadStats.skipped++;
+		return false;
+	}
+	memcpy(shadow.value, value, size);
+	shadow.valid = true;
+	uploadStats.issued++;
+	return true;
 }
 
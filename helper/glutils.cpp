@@ -2,6 +2,7 @@
 #include <glad/glad.h>
 
 #include <cstdio>
+#include <cstring>
 #include <string>
 using std::string;
 #include <iostream>
@@ -160,4 +161,22 @@ void dumpGLInfo(bool dumpExtensions) {
     }
 }
 
+bool hasExtension(const char *name) {
+    GLint nExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+    for (int i = 0; i < nExtensions; i++) {
+        const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool hasParallelShaderCompile() {
+    static int supported = -1;
+    if (supported < 0)
+        supported = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+    return supported > 0;
+}
+
 } // namespace GLUtils
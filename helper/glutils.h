@@ -2,11 +2,25 @@
 
 #include <glad/glad.h>
 
+// Not in the generated loader; same value for the KHR and ARB extensions
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
 namespace GLUtils
 {
     int checkForOpenGLError(const char *, int);
     
     void dumpGLInfo(bool dumpExtensions = false);
+
+    bool hasExtension(const char *name);
+
+    // KHR_parallel_shader_compile (or the ARB version): compiles and links
+    // run on driver threads and can be polled with GL_COMPLETION_STATUS_KHR
+    bool hasParallelShaderCompile();
     
     void APIENTRY debugCallback( GLenum source, GLenum type, GLuint id,
 		GLenum severity, GLsizei length, const GLchar * msg, const void * param );
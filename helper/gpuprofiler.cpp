@@ -0,0 +1,179 @@
+#include "gpuprofiler.h"
+
+#include "imgui.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+GpuProfiler::GpuProfiler() : frameIndex(-1), initialized(false), historyPos(0), dropped(0), resolved(0), untracedEvents(0) {
+    for (FrameSlot &slot : slots) {
+        slot.count = 0;
+        slot.open = false;
+        slot.pending = false;
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    if (!initialized)
+        return;
+    for (FrameSlot &slot : slots)
+        glDeleteQueries(MAX_ZONES * 2, slot.queries);
+}
+
+void GpuProfiler::init() {
+    if (initialized)
+        return;
+    for (FrameSlot &slot : slots)
+        glGenQueries(MAX_ZONES * 2, slot.queries);
+    initialized = true;
+}
+
+void GpuProfiler::beginFrame() {
+    if (!initialized)
+        return;
+
+    frameIndex = (frameIndex + 1) % FRAME_LATENCY;
+    FrameSlot &slot = slots[frameIndex];
+
+    // This slot was issued FRAME_LATENCY frames ago; read it if the GPU is done
+    if (slot.pending) {
+        GLint available = GL_FALSE;
+        if (slot.count > 0)
+            glGetQueryObjectiv(slot.queries[slot.count * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+            resolve(slot);
+        else
+            dropped++;
+    }
+
+    slot.count = 0;
+    slot.open = false;
+    slot.pending = true;
+}
+
+void GpuProfiler::begin(const char *name) {
+    if (!initialized || frameIndex < 0)
+        return;
+    FrameSlot &slot = slots[frameIndex];
+    if (slot.open || slot.count >= MAX_ZONES)
+        return;
+
+    slot.zoneIndex[slot.count] = findZone(name);
+    glQueryCounter(slot.queries[slot.count * 2], GL_TIMESTAMP);
+    slot.open = true;
+}
+
+void GpuProfiler::end() {
+    if (!initialized || frameIndex < 0)
+        return;
+    FrameSlot &slot = slots[frameIndex];
+    if (!slot.open)
+        return;
+
+    glQueryCounter(slot.queries[slot.count * 2 + 1], GL_TIMESTAMP);
+    slot.count++;
+    slot.open = false;
+}
+
+void GpuProfiler::finish() {
+    if (!initialized || frameIndex < 0)
+        return;
+    // Oldest first, so the history and trace stay in frame order
+    for (int i = 1; i <= FRAME_LATENCY; i++) {
+        FrameSlot &slot = slots[(frameIndex + i) % FRAME_LATENCY];
+        if (!slot.pending)
+            continue;
+        if (slot.open) {
+            glQueryCounter(slot.queries[slot.count * 2 + 1], GL_TIMESTAMP);
+            slot.count++;
+            slot.open = false;
+        }
+        // GL_QUERY_RESULT waits for the GPU
+        if (slot.count > 0)
+            resolve(slot);
+        slot.pending = false;
+    }
+}
+
+int GpuProfiler::findZone(const char *name) {
+    for (size_t i = 0; i < zoneList.size(); i++) {
+        if (zoneList[i].name == name)
+            return (int)i;
+    }
+
+    Zone zone;
+    zone.name = name;
+    zone.lastMs = 0.0f;
+    for (float &v : zone.history)
+        v = 0.0f;
+    zoneList.push_back(zone);
+    return (int)zoneList.size() - 1;
+}
+
+void GpuProfiler::resolve(FrameSlot &slot) {
+    // Passes that did not run this frame read as zero
+    std::vector<float> frameMs(zoneList.size(), 0.0f);
+
+    for (int i = 0; i < slot.count; i++) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(slot.queries[i * 2], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(slot.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        GLuint64 duration = end > start ? end - start : 0;
+        frameMs[slot.zoneIndex[i]] += duration / 1.0e6f;
+
+        if (trace.size() < MAX_TRACE_EVENTS)
+            trace.push_back({ slot.zoneIndex[i], start, duration });
+        else
+            untracedEvents++;
+    }
+
+    for (size_t z = 0; z < zoneList.size(); z++) {
+        zoneList[z].history[historyPos] = frameMs[z];
+        zoneList[z].lastMs = frameMs[z];
+    }
+    historyPos = (historyPos + 1) % HISTORY;
+    resolved++;
+    slot.pending = false;
+}
+
+void GpuProfiler::drawUI() const {
+    float total = 0.0f;
+    for (const Zone &zone : zoneList)
+        total += zone.lastMs;
+    ImGui::Text("GPU passes: %.3f ms", total);
+
+    for (const Zone &zone : zoneList) {
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.3f ms", zone.lastMs);
+        ImGui::PlotLines(zone.name.c_str(), zone.history, HISTORY, historyPos, overlay,
+                         0.0f, FLT_MAX, ImVec2(0.0f, 30.0f));
+    }
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string &fileName) const {
+    std::ofstream out(fileName);
+    if (!out) {
+        std::cerr << "Unable to write GPU trace: " << fileName << std::endl;
+        return false;
+    }
+
+    // Timestamps are in nanoseconds on the GPU clock; the trace wants microseconds
+    GLuint64 origin = trace.empty() ? 0 : trace.front().start;
+    out << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < trace.size(); i++) {
+        const TraceEvent &e = trace[i];
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":\"GPU\",\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                 zoneList[e.zone].name.c_str(), (e.start - origin) / 1000.0, e.duration / 1000.0,
+                 i + 1 < trace.size() ? "," : "");
+        out << line;
+    }
+    out << "]}\n";
+    if (untracedEvents > 0)
+        std::cerr << "GPU trace truncated at " << MAX_TRACE_EVENTS << " passes; the last " << untracedEvents
+                  << " were not recorded" << std::endl;
+    return true;
+}
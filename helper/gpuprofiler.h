@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// Times render passes on the GPU with GL_TIMESTAMP query pairs.
+//
+// Queries for the last FRAME_LATENCY frames are kept in a ring; a frame's
+// results are only read once its slot comes round again, and only if the
+// GPU has finished with them, so reading never stalls the pipeline.
+class GpuProfiler {
+public:
+    static const int FRAME_LATENCY = 4;     // frames in flight before results are read
+    static const int MAX_ZONES = 16;        // timed passes per frame
+    static const int HISTORY = 120;         // frames kept for the rolling graph
+
+    struct Zone {
+        std::string name;
+        float history[HISTORY];   // milliseconds, oldest first from historyOffset
+        float lastMs;
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler & operator=(const GpuProfiler &) = delete;
+
+    // Creates the query objects; needs a current GL context
+    void init();
+
+    void beginFrame();
+    void begin(const char *name);
+    void end();
+
+    // Waits for and reads every frame still in flight, e.g. before the last
+    // trace is written; needs the context that issued the queries
+    void finish();
+
+    const std::vector<Zone> & zones() const { return zoneList; }
+    int historyOffset() const { return historyPos; }
+    int droppedFrames() const { return dropped; }
+
+    // Frames read back so far; when it changes, zones() holds a new frame's times
+    size_t resolvedFrames() const { return resolved; }
+
+    // Draws one rolling graph per pass into the current ImGui window
+    void drawUI() const;
+
+    // Writes every resolved pass as a complete ("X") event in Chrome trace
+    // format; warns if more than MAX_TRACE_EVENTS passes were resolved
+    bool writeChromeTrace(const std::string &fileName) const;
+
+private:
+    struct FrameSlot {
+        GLuint queries[MAX_ZONES * 2];
+        int zoneIndex[MAX_ZONES];
+        int count;
+        bool open;       // a begin() without matching end()
+        bool pending;    // issued but not yet read back
+    };
+
+    struct TraceEvent {
+        int zone;
+        GLuint64 start;
+        GLuint64 duration;
+    };
+
+    FrameSlot slots[FRAME_LATENCY];
+    int frameIndex;
+    bool initialized;
+    std::vector<Zone> zoneList;
+    int historyPos;
+    int dropped;
+    size_t resolved;
+
+    std::vector<TraceEvent> trace;
+    static const size_t MAX_TRACE_EVENTS = 200000;
+    size_t untracedEvents;      // resolved after the trace was full
+
+    int findZone(const char *name);
+    void resolve(FrameSlot &slot);
+};
@@ -0,0 +1,263 @@
+#include "gpuscene.h"
+
+#include "cpuprofiler.h"
+#include "frustum.h"
+#include "hizpyramid.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+namespace {
+    const GLuint GROUP_SIZE = 64;   // local_size_x in cull.cs
+
+    // Shader storage bindings of cull.cs besides OBJECT_BINDING
+    const GLuint COMMAND_BINDING = 1;
+    const GLuint VISIBLE_BINDING = 2;
+}
+
+GpuScene::GpuScene() :
+    vao(0), vertexBuffer(0), indexBuffer(0), objectBuffer(0), drawIndexBuffer(0), commandBuffer(0),
+    objects(0), objectCapacity(0), commands(0), commandCapacity(0), templateBuffer(0), cullProgram(nullptr) {}
+
+GpuScene::~GpuScene() {
+    if (vao != 0)
+        glDeleteVertexArrays(1, &vao);
+    std::vector<GLuint> buffers = { vertexBuffer, indexBuffer, objectBuffer, drawIndexBuffer, commandBuffer, templateBuffer };
+    for (CulledView &view : views) {
+        buffers.insert(buffers.end(), { view.commandBuffer, view.drawIndexBuffer, view.countBuffer });
+        if (view.countFence)
+            glDeleteSync(view.countFence);
+    }
+    for (GLuint buffer : buffers) {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+    }
+}
+
+bool GpuScene::supported() {
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+GpuScene::Mesh GpuScene::addMesh(const std::vector<float> &meshVertices, const std::vector<GLuint> &meshIndices) {
+    Mesh mesh;
+    mesh.firstIndex = (GLuint)indices.size();
+    mesh.indexCount = (GLuint)meshIndices.size();
+    mesh.baseVertex = (GLint)(vertices.size() / 8);
+    vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+    indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+    return mesh;
+}
+
+bool GpuScene::create() {
+    if (!supported())
+        return false;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &drawIndexBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &templateBuffer);
+    for (CulledView &view : views) {
+        glGenBuffers(1, &view.commandBuffer);
+        glGenBuffers(1, &view.drawIndexBuffer);
+        glGenBuffers(1, &view.countBuffer);
+    }
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+    // A separate binding, so draw() can switch between the full and the
+    // culled index buffers; filled by setObjects() and cull()
+    glEnableVertexAttribArray(ATTRIBUTE_DRAW_INDEX);
+    glVertexAttribIFormat(ATTRIBUTE_DRAW_INDEX, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(ATTRIBUTE_DRAW_INDEX, ATTRIBUTE_DRAW_INDEX);
+    glVertexBindingDivisor(ATTRIBUTE_DRAW_INDEX, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    vertices = std::vector<float>();
+    indices = std::vector<GLuint>();
+    return true;
+}
+
+GpuScene::Command GpuScene::command(const Mesh &mesh, GLuint first, GLuint instances) {
+    Command command = { mesh.indexCount, instances, mesh.firstIndex, mesh.baseVertex, first };
+    return command;
+}
+
+void GpuScene::setObjects(const std::vector<Object> &list, size_t first, size_t count) {
+    PROFILE_SCOPE("GpuScene::setObjects");
+    objects = list.size();
+    if (objects == 0)
+        return;
+
+    if (objects > objectCapacity) {
+        objectCapacity = std::max(objects, objectCapacity * 2);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objectCapacity * sizeof(Object), nullptr, GL_DYNAMIC_DRAW);
+
+        // Object indices never change, only how many there are
+        std::vector<GLuint> drawIndices(objectCapacity);
+        std::iota(drawIndices.begin(), drawIndices.end(), 0u);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), GL_STATIC_DRAW);
+        for (CulledView &view : views) {
+            glBindBuffer(GL_ARRAY_BUFFER, view.drawIndexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, objectCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+            view.culled = false;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        first = 0;
+        count = objects;
+    }
+    if (first < objects) {
+        count = std::min(count, objects - first);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * sizeof(Object), count * sizeof(Object), &list[first]);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuScene::setCommands(const std::vector<Command> &list) {
+    commands = list.size();
+
+    // Culling starts from no instances and counts the visible ones
+    std::vector<Command> empty(list);
+    for (Command &command : empty)
+        command.instanceCount = 0;
+
+    bool grow = commands > commandCapacity;
+    if (grow)
+        commandCapacity = commands;
+    auto upload = [&](GLuint buffer, const void *data) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+        if (grow)
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCapacity * sizeof(Command), data, GL_DYNAMIC_DRAW);
+        else if (data && commands > 0)
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands * sizeof(Command), data);
+    };
+    upload(commandBuffer, list.data());
+    upload(templateBuffer, empty.data());
+    for (CulledView &view : views) {
+        upload(view.commandBuffer, nullptr);    // written by cull()
+        upload(view.countBuffer, nullptr);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // Culled commands and counts in flight describe the old list
+    for (CulledView &view : views) {
+        view.culled = false;
+        if (view.countFence) {
+            glDeleteSync(view.countFence);
+            view.countFence = nullptr;
+        }
+    }
+}
+
+void GpuScene::setCullProgram(GLSLProgram &program) {
+    cullProgram = &program;
+    for (int i = 0; i < 6; i++)
+        planeUniforms[i] = program.uniform<glm::vec4>(("planes[" + std::to_string(i) + "]").c_str());
+    objectCountUniform = program.uniform<GLuint>("objectCount");
+    occlusionUniform = program.uniform<bool>("occlusion");
+    hiZUniform = program.uniform<int>("hiZ");
+    hiZViewProjectionUniform = program.uniform<glm::mat4>("hiZViewProjection");
+    hiZFramebufferSizeUniform = program.uniform<glm::vec2>("hiZFramebufferSize");
+    hiZLevelsUniform = program.uniform<int>("hiZLevels");
+}
+
+void GpuScene::cull(View view, const glm::mat4 &viewProjection,
+                    const HiZPyramid *occluders, const glm::mat4 &occluderViewProjection) {
+    CulledView &culled = views[view];
+    if (!cullProgram || objects == 0 || commands == 0)
+        return;
+    PROFILE_SCOPE("GpuScene::cull");
+    readVisibleCount(culled);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, templateBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, culled.commandBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commands * sizeof(Command));
+
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    cullProgram->use();
+    for (int i = 0; i < Frustum::PLANE_COUNT; i++)
+        cullProgram->setUniform(planeUniforms[i], frustum.planes[i]);
+    cullProgram->setUniform(objectCountUniform, (GLuint)objects);
+    bool occlusion = occluders && occluders->valid();
+    cullProgram->setUniform(occlusionUniform, occlusion);
+    if (occlusion) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, occluders->texture());
+        cullProgram->setUniform(hiZUniform, 0);
+        cullProgram->setUniform(hiZViewProjectionUniform, occluderViewProjection);
+        cullProgram->setUniform(hiZFramebufferSizeUniform, glm::vec2((float)occluders->framebufferWidth(), (float)occluders->framebufferHeight()));
+        cullProgram->setUniform(hiZLevelsUniform, occluders->levels());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, culled.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, culled.drawIndexBuffer);
+    glDispatchCompute((GLuint)((objects + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, 0);
+    if (occlusion)
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+    // A copy of the counts to read once the GPU has got this far
+    if (!culled.countFence) {
+        glBindBuffer(GL_COPY_READ_BUFFER, culled.commandBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, culled.countBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commands * sizeof(Command));
+        culled.countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    culled.culled = true;
+}
+
+void GpuScene::readVisibleCount(CulledView &view) {
+    if (!view.countFence)
+        return;
+    GLenum status = glClientWaitSync(view.countFence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(view.countFence);
+    view.countFence = nullptr;
+
+    std::vector<Command> counts(commands);
+    glBindBuffer(GL_COPY_READ_BUFFER, view.countBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, commands * sizeof(Command), counts.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    view.visible = 0;
+    for (const Command &command : counts)
+        view.visible += (int)command.instanceCount;
+}
+
+void GpuScene::draw(size_t first, size_t count, View view) const {
+    if (objects == 0 || first >= commands)
+        return;
+    count = std::min(count, commands - first);
+    bool culled = view != VIEW_ALL && views[view].culled;
+    glBindVertexArray(vao);
+    glBindVertexBuffer(ATTRIBUTE_DRAW_INDEX, culled ? views[view].drawIndexBuffer : drawIndexBuffer, 0, sizeof(GLuint));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culled ? views[view].commandBuffer : commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(first * sizeof(Command)),
+                                (GLsizei)count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glslprogram.h"
+
+#include <cstddef>
+#include <vector>
+
+class HiZPyramid;
+
+// Scene submission through glMultiDrawElementsIndirect.
+//
+//   GpuScene scene;
+//   GpuScene::Mesh sphere = scene.addMesh(vertices, indices);   // before create()
+//   scene.create();
+//   scene.setObjects(objects);                  // when objects change
+//   scene.setCommands({ scene.command(sphere, 0, count) });
+//   scene.draw(0, 1);                           // whole pass, one call
+//
+// Every mesh lives in one shared vertex and index buffer behind one VAO
+// (attributes 0 to 2, as for the other meshes in the scene), so a pass binds
+// nothing per object.  Draw commands sit in a GL_DRAW_INDIRECT_BUFFER and
+// per-object data (Object) in a shader storage buffer at OBJECT_BINDING.
+//
+// Shaders find their object through the drawIndex attribute (ATTRIBUTE_DRAW_INDEX),
+// an instanced attribute holding 0, 1, 2 ... which is read at baseInstance +
+// gl_InstanceID.  Each command's baseInstance is the index of its first
+// object, so an instanced command covers a run of objects.  This needs only
+// GL 4.3, where gl_DrawID and gl_BaseInstance would need GL 4.6 or
+// ARB_shader_draw_parameters.
+//
+// Culling (shader/cull.cs) fills a per-view copy of the commands:
+//
+//   scene.setCullProgram(cullProgram);
+//   scene.cull(GpuScene::VIEW_SHADOW, lightSpaceMatrix);
+//   scene.cull(GpuScene::VIEW_CAMERA, viewProjection, &hiZ, lastViewProjection);
+//   scene.draw(0, 1, GpuScene::VIEW_CAMERA);
+//
+// Each object's bounding sphere is tested against the view's frustum and,
+// optionally, a Hi-Z pyramid of an earlier frame's depth.  Survivors are
+// written to the view's drawIndex buffer from their command's baseInstance
+// on, and counted in its instanceCount, so the draw reads only visible
+// objects and no count comes back to the CPU.
+class GpuScene {
+public:
+    static const GLuint OBJECT_BINDING = 0;         // shader storage binding of ObjectData
+    static const GLuint ATTRIBUTE_DRAW_INDEX = 8;   // uint, per instance
+
+    // Views with their own culled commands; VIEW_ALL draws every object
+    enum View { VIEW_ALL = -1, VIEW_CAMERA, VIEW_SHADOW, VIEW_COUNT };
+
+    // std430 layout; must match ObjectData in the indirect shaders
+    struct Object {
+        glm::mat4 model;
+        glm::vec4 color;        // rgb multiplies the texture colour, w is the texture array layer
+        GLuint material;        // index into the MaterialData block
+        float radius;           // bounding sphere about the model origin, before the model matrix
+        GLuint command;         // the command that draws this object, for culling
+        GLuint padding;
+    };
+    static_assert(sizeof(Object) == 96, "Object must match the std430 ObjectData block");
+
+    struct Mesh {
+        GLuint firstIndex = 0;
+        GLuint indexCount = 0;
+        GLint baseVertex = 0;
+    };
+
+    // Layout read by glMultiDrawElementsIndirect
+    struct Command {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    GpuScene();
+    ~GpuScene();
+
+    GpuScene(const GpuScene &) = delete;
+    GpuScene & operator=(const GpuScene &) = delete;
+
+    // Multi-draw indirect and shader storage buffers (GL 4.3)
+    static bool supported();
+
+    // Interleaved position, normal and texture coordinate (8 floats a vertex)
+    // and indices relative to the mesh; only before create()
+    Mesh addMesh(const std::vector<float> &vertices, const std::vector<GLuint> &indices);
+
+    // Uploads the merged meshes; false if unsupported
+    bool create();
+
+    // Draws objects first .. first + instances - 1 with a mesh
+    static Command command(const Mesh &mesh, GLuint first, GLuint instances = 1);
+
+    // As ItemRenderer::upload: objects first .. first + count of the list,
+    // or the whole list if the buffer has to grow
+    void setObjects(const std::vector<Object> &objects, size_t first = 0, size_t count = (size_t)-1);
+    void setCommands(const std::vector<Command> &commands);
+
+    // shader/cull.cs; without it cull() leaves every object visible
+    void setCullProgram(GLSLProgram &program);
+
+    // Rebuilds the view's commands from the objects that may be visible
+    // through viewProjection.  With occluders, objects behind its depth as
+    // seen through occluderViewProjection are dropped as well.
+    void cull(View view, const glm::mat4 &viewProjection,
+              const HiZPyramid *occluders = nullptr, const glm::mat4 &occluderViewProjection = glm::mat4(1.0f));
+
+    // Commands first .. first + count - 1 in one glMultiDrawElementsIndirect,
+    // as culled for the view, or unculled for VIEW_ALL or a view not culled
+    // since the last setObjects() that grew the buffers
+    void draw(size_t first, size_t count, View view = VIEW_ALL) const;
+
+    size_t objectCount() const { return objects; }
+    size_t commandCount() const { return commands; }
+
+    // Objects that passed the view's last culling read back without
+    // stalling, so a frame or two late; -1 before the first one arrives
+    int visibleCount(View view) const { return views[view].visible; }
+
+private:
+    GLuint vao;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLuint objectBuffer;
+    GLuint drawIndexBuffer;
+    GLuint commandBuffer;
+    size_t objects;
+    size_t objectCapacity;
+    size_t commands;
+    size_t commandCapacity;
+
+    // Commands with instanceCount 0, copied into a view before culling
+    GLuint templateBuffer;
+
+    struct CulledView {
+        GLuint commandBuffer = 0;
+        GLuint drawIndexBuffer = 0;     // visible object indices, per command from baseInstance
+        GLuint countBuffer = 0;         // copy of the commands read back for visibleCount()
+        GLsync countFence = nullptr;
+        bool culled = false;
+        int visible = -1;
+    };
+    CulledView views[VIEW_COUNT];
+
+    GLSLProgram *cullProgram;
+    UniformHandle<glm::vec4> planeUniforms[6];
+    UniformHandle<GLuint> objectCountUniform;
+    UniformHandle<bool> occlusionUniform;
+    UniformHandle<int> hiZUniform;
+    UniformHandle<glm::mat4> hiZViewProjectionUniform;
+    UniformHandle<glm::vec2> hiZFramebufferSizeUniform;
+    UniformHandle<int> hiZLevelsUniform;
+
+    void readVisibleCount(CulledView &view);
+
+    std::vector<float> vertices;        // merged meshes, freed by create()
+    std::vector<GLuint> indices;
+};
@@ -0,0 +1,72 @@
+#include "hizpyramid.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+
+namespace {
+    const GLuint GROUP_SIZE = 8;    // local_size_x and _y in hiz_reduce.cs
+}
+
+HiZPyramid::HiZPyramid() : pyramid(0), size{ 0, 0 }, pyramidSize{ 0, 0 }, levelCount(0), built(false), reduce(nullptr) {}
+
+HiZPyramid::~HiZPyramid() {
+    if (pyramid != 0)
+        glDeleteTextures(1, &pyramid);
+}
+
+void HiZPyramid::setProgram(GLSLProgram &program) {
+    reduce = &program;
+    depthUniform = program.uniform<int>("depth");
+    levelUniform = program.uniform<int>("level");
+}
+
+void HiZPyramid::create(int width, int height) {
+    if (pyramid != 0)
+        glDeleteTextures(1, &pyramid);
+    pyramid = 0;
+    built = false;
+    size[0] = std::max(1, width);
+    size[1] = std::max(1, height);
+    // The full resolution level would only repeat the depth buffer
+    pyramidSize[0] = std::max(1, size[0] / 2);
+    pyramidSize[1] = std::max(1, size[1] / 2);
+    levelCount = 1;
+    for (int extent = std::max(pyramidSize[0], pyramidSize[1]); extent > 1; extent >>= 1)
+        levelCount++;
+
+    glGenTextures(1, &pyramid);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_R32F, pyramidSize[0], pyramidSize[1]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void HiZPyramid::build(GLuint depthTexture) {
+    if (!reduce || pyramid == 0 || depthTexture == 0)
+        return;
+    PROFILE_SCOPE("HiZPyramid::build");
+
+    // Level 0 from the depth copy, then each level from the one above it
+    reduce->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    reduce->setUniform(depthUniform, 0);
+    for (int level = 0; level < levelCount; level++) {
+        int width = std::max(1, pyramidSize[0] >> level), height = std::max(1, pyramidSize[1] >> level);
+        reduce->setUniform(levelUniform, level);
+        glBindImageTexture(0, pyramid, std::max(0, level - 1), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE, (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    // Read with texelFetch by the culling pass
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    built = true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "glslprogram.h"
+
+// Hierarchical depth buffer for occlusion culling.
+//
+//   HiZPyramid hiZ;
+//   hiZ.setProgram(reduceProgram);   // shader/hiz_reduce.cs
+//   hiZ.create(width, height);
+//   ...
+//   sceneDepth.copy(framebuffer);    // DepthCopy, after the opaque pass
+//   hiZ.build(sceneDepth.texture());
+//
+// build() reduces a copy of the depth buffer on the GPU into an R32F mip
+// chain where each texel holds the farthest depth of the texels it covers,
+// starting at half the framebuffer's size.  An object whose nearest depth
+// is behind that of the (at most 2x2) texels covering its screen rectangle
+// is hidden.  Odd sizes
+// fold the leftover row or column into the last texel, so below level 0 a
+// texel does not cover an even fraction of the screen: the texels under a
+// rectangle have to be found from its framebuffer pixels, shifted right by
+// level + 1, or the test is no longer conservative.
+class HiZPyramid {
+public:
+    HiZPyramid();
+    ~HiZPyramid();
+
+    HiZPyramid(const HiZPyramid &) = delete;
+    HiZPyramid & operator=(const HiZPyramid &) = delete;
+
+    void setProgram(GLSLProgram &program);
+
+    // (Re)allocates for a framebuffer of this size; any earlier contents are gone
+    void create(int width, int height);
+
+    // Reads depthTexture, the framebuffer's depth at width x height
+    void build(GLuint depthTexture);
+
+    // True once build() has run since the last create()
+    bool valid() const { return built; }
+
+    // Level 0 is half the framebuffer's size, rounded down
+    GLuint texture() const { return pyramid; }
+    int width() const { return pyramidSize[0]; }
+    int height() const { return pyramidSize[1]; }
+    int levels() const { return levelCount; }
+    int framebufferWidth() const { return size[0]; }
+    int framebufferHeight() const { return size[1]; }
+
+private:
+    GLuint pyramid;         // R32F, farthest depth per texel
+    int size[2];            // of the framebuffer
+    int pyramidSize[2];
+    int levelCount;
+    bool built;
+
+    GLSLProgram *reduce;
+    UniformHandle<int> depthUniform;
+    UniformHandle<int> levelUniform;
+};
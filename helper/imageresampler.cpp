@@ -0,0 +1,421 @@
+#include "imageresampler.h"
+
+#include "threadpool.h"
+#include "cpuprofiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+    // Enough rows per band to outweigh decoding the rows a band shares with its neighbours
+    const int MIN_BAND_PIXELS = 64 * 1024;
+
+    // Linear to sRGB by table; fine enough to be exact to the nearest 8-bit value
+    const int SRGB_ENCODE_SIZE = 16384;
+
+    // Pixels are filtered as four floats whatever the channel count, so one
+    // SSE register holds a pixel; unused lanes stay zero
+    const int LANES = 4;
+
+    struct Tables {
+        float linear[256];          // byte / 255
+        float srgbToLinear[256];
+        unsigned char linearToSrgb[SRGB_ENCODE_SIZE];
+
+        Tables() {
+            for (int i = 0; i < 256; i++) {
+                float f = i / 255.0f;
+                linear[i] = f;
+                srgbToLinear[i] = f <= 0.04045f ? f / 12.92f : std::pow((f + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < SRGB_ENCODE_SIZE; i++) {
+                float f = (float)i / (SRGB_ENCODE_SIZE - 1);
+                float s = f <= 0.0031308f ? f * 12.92f : 1.055f * std::pow(f, 1.0f / 2.4f) - 0.055f;
+                linearToSrgb[i] = (unsigned char)(s * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const Tables & tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+    // Weights of every output pixel along one axis.  Each pixel has the same
+    // number of taps, padded with zero weights, and taps past the edge are
+    // folded onto the edge pixel, so the kernels never clamp.
+    struct Axis {
+        int taps = 0;
+        std::vector<int> first;
+        std::vector<int> count;         // taps with a nonzero weight
+        std::vector<float> weights;     // taps per output pixel
+    };
+
+    float kernel(ImageResampler::Filter filter, float x) {
+        x = std::fabs(x);
+        if (filter == ImageResampler::FILTER_TRIANGLE)
+            return std::max(0.0f, 1.0f - x);
+        // Catmull-Rom
+        if (x < 1.0f)
+            return 1.5f * x * x * x - 2.5f * x * x + 1.0f;
+        if (x < 2.0f)
+            return -0.5f * x * x * x + 2.5f * x * x - 4.0f * x + 2.0f;
+        return 0.0f;
+    }
+
+    // r0 .. r1 is the input region in 0..1 coordinates, as in stbir_resize_region
+    Axis buildAxis(int input, int output, float r0, float r1, ImageResampler::Filter filter) {
+        float scale = (float)output / ((r1 - r0) * input);     // output pixels per input pixel
+        float filterScale = std::min(scale, 1.0f);               // the kernel widens when shrinking
+        float support = filter == ImageResampler::FILTER_BOX ? 0.5f : (filter == ImageResampler::FILTER_TRIANGLE ? 1.0f : 2.0f);
+        float radius = support / filterScale;
+
+        Axis axis;
+        axis.first.resize(output);
+        axis.count.resize(output);
+        std::vector<std::vector<float>> all(output);
+        for (int o = 0; o < output; o++) {
+            float center = (o + 0.5f) / scale + r0 * input;
+            int lo = (int)std::floor(center - radius), hi = (int)std::ceil(center + radius);
+            int first = std::min(input - 1, std::max(0, lo)), last = std::min(input - 1, std::max(0, hi - 1));
+            std::vector<float> &w = all[o];
+            w.assign(last - first + 1, 0.0f);
+            float total = 0.0f;
+            for (int i = lo; i < hi; i++) {
+                float weight;
+                if (filter == ImageResampler::FILTER_BOX)
+                    weight = std::max(0.0f, std::min(center + radius, i + 1.0f) - std::max(center - radius, (float)i));
+                else
+                    weight = kernel(filter, (i + 0.5f - center) * filterScale);
+                w[std::min(input - 1, std::max(0, i)) - first] += weight;
+                total += weight;
+            }
+            if (total == 0.0f) {
+                // Nothing in reach: take the nearest pixel
+                std::fill(w.begin(), w.end(), 0.0f);
+                w[std::min(last, std::max(first, (int)center)) - first] = total = 1.0f;
+            }
+            while (w.size() > 1 && w.front() == 0.0f) {
+                w.erase(w.begin());
+                first++;
+            }
+            while (w.size() > 1 && w.back() == 0.0f)
+                w.pop_back();
+            for (float &weight : w)
+                weight /= total;
+            axis.first[o] = first;
+            axis.count[o] = (int)w.size();
+            axis.taps = std::max(axis.taps, axis.count[o]);
+        }
+        axis.weights.assign((size_t)output * axis.taps, 0.0f);
+        for (int o = 0; o < output; o++)
+            std::copy(all[o].begin(), all[o].end(), axis.weights.begin() + (size_t)o * axis.taps);
+        return axis;
+    }
+
+    struct Job {
+        const unsigned char *input;
+        int inputWidth, inputHeight;
+        unsigned char *output;
+        int outputWidth, outputHeight;
+        int channels;
+        bool srgb;
+        Axis horizontal, vertical;
+        CpuFeatures::Simd simd;
+    };
+
+    void decodeRow(const Job &job, int y, float *row) {
+        const Tables &t = tables();
+        const float *color = job.srgb ? t.srgbToLinear : t.linear;
+        const unsigned char *src = job.input + (size_t)y * job.inputWidth * job.channels;
+        for (int x = 0; x < job.inputWidth; x++) {
+            for (int c = 0; c < job.channels; c++)
+                row[x * LANES + c] = (c == 3 ? t.linear : color)[src[x * job.channels + c]];
+        }
+    }
+
+    void encodeRow(const Job &job, const float *pixels, unsigned char *dst) {
+        const Tables &t = tables();
+        for (int x = 0; x < job.outputWidth; x++) {
+            for (int c = 0; c < job.channels; c++) {
+                float v = std::min(1.0f, std::max(0.0f, pixels[x * LANES + c]));
+                dst[x * job.channels + c] = job.srgb && c != 3 ? t.linearToSrgb[(int)(v * (SRGB_ENCODE_SIZE - 1) + 0.5f)]
+                                                               : (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    // sum += row * weight over n floats
+    void accumulateScalar(float *sum, const float *row, float weight, size_t n) {
+        for (size_t i = 0; i < n; i++)
+            sum[i] += row[i] * weight;
+    }
+
+    void horizontalScalar(const Job &job, const float *sum, float *out) {
+        const Axis &h = job.horizontal;
+        for (int x = 0; x < job.outputWidth; x++) {
+            const float *w = &h.weights[(size_t)x * h.taps];
+            const float *p = sum + (size_t)h.first[x] * LANES;
+            float acc[LANES] = {};
+            for (int t = 0; t < h.taps; t++)
+                for (int c = 0; c < LANES; c++)
+                    acc[c] += p[t * LANES + c] * w[t];
+            memcpy(out + x * LANES, acc, sizeof(acc));
+        }
+    }
+
+#ifdef CPU_X86
+    void accumulateSse2(float *sum, const float *row, float weight, size_t n) {
+        __m128 w = _mm_set1_ps(weight);
+        for (size_t i = 0; i < n; i += 4)
+            _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_loadu_ps(row + i), w)));
+    }
+
+    void horizontalSse2(const Job &job, const float *sum, float *out, int start) {
+        const Axis &h = job.horizontal;
+        for (int x = start; x < job.outputWidth; x++) {
+            const float *w = &h.weights[(size_t)x * h.taps];
+            const float *p = sum + (size_t)h.first[x] * LANES;
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < h.taps; t++)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p + t * LANES), _mm_set1_ps(w[t])));
+            _mm_storeu_ps(out + x * LANES, acc);
+        }
+    }
+
+    CPU_TARGET_AVX2
+    void accumulateAvx2(float *sum, const float *row, float weight, size_t n) {
+        __m256 w = _mm256_set1_ps(weight);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(_mm256_loadu_ps(row + i), w)));
+        for (; i < n; i += 4)
+            _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_loadu_ps(row + i), _mm256_castps256_ps128(w))));
+    }
+
+    // Two output pixels per register, one in each half
+    CPU_TARGET_AVX2
+    void horizontalAvx2(const Job &job, const float *sum, float *out) {
+        const Axis &h = job.horizontal;
+        int x = 0;
+        for (; x + 2 <= job.outputWidth; x += 2) {
+            const float *w0 = &h.weights[(size_t)x * h.taps], *w1 = w0 + h.taps;
+            const float *p0 = sum + (size_t)h.first[x] * LANES, *p1 = sum + (size_t)h.first[x + 1] * LANES;
+            __m256 acc = _mm256_setzero_ps();
+            for (int t = 0; t < h.taps; t++) {
+                __m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p0 + t * LANES)), _mm_loadu_ps(p1 + t * LANES), 1);
+                __m256 weights = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[t])), _mm_set1_ps(w1[t]), 1);
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(pixels, weights));
+            }
+            _mm256_storeu_ps(out + x * LANES, acc);
+        }
+        horizontalSse2(job, sum, out, x);
+    }
+
+    // Pixels at the start of a row whose four bytes all lie within it
+    int packedPixels(const Job &job) {
+        int rowBytes = job.inputWidth * job.channels;
+        return rowBytes < 4 ? 0 : (rowBytes - 4) / job.channels + 1;
+    }
+
+    // Bytes are divided by 255 rather than multiplied by its reciprocal, which
+    // rounds differently, so the result matches decodeRow and stbir exactly.
+    // Each pixel is read as four bytes, so the lanes past the channel count
+    // pick up the next pixels; they are filtered like the rest and never
+    // written out.  The pixels too close to the end of the row for that are
+    // decoded one channel at a time, so the row is not overrun.
+    void decodeRowSse2(const Job &job, int y, float *row) {
+        const unsigned char *src = job.input + (size_t)y * job.inputWidth * job.channels;
+        const __m128 maximum = _mm_set1_ps(255.0f);
+        const __m128i zero = _mm_setzero_si128();
+        int packed = packedPixels(job);
+        for (int x = 0; x < packed; x++) {
+            int bytes;
+            memcpy(&bytes, src + x * job.channels, 4);
+            __m128i i = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+            _mm_storeu_ps(row + x * LANES, _mm_div_ps(_mm_cvtepi32_ps(i), maximum));
+        }
+        for (int x = packed; x < job.inputWidth; x++) {
+            for (int c = 0; c < job.channels; c++)
+                row[x * LANES + c] = tables().linear[src[x * job.channels + c]];
+        }
+    }
+
+    // As decodeRowSse2, with sRGB colour looked up by gather
+    CPU_TARGET_AVX2
+    void decodeRowAvx2(const Job &job, int y, float *row) {
+        const Tables &t = tables();
+        const unsigned char *src = job.input + (size_t)y * job.inputWidth * job.channels;
+        const __m128 maximum = _mm_set1_ps(255.0f);
+        int packed = packedPixels(job);
+        for (int x = 0; x < packed; x++) {
+            int bytes;
+            memcpy(&bytes, src + x * job.channels, 4);
+            __m128i i = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+            __m128 linear = _mm_div_ps(_mm_cvtepi32_ps(i), maximum);
+            if (job.srgb)
+                linear = _mm_blend_ps(_mm_i32gather_ps(t.srgbToLinear, i, 4), linear, 8);    // alpha stays linear
+            _mm_storeu_ps(row + x * LANES, linear);
+        }
+        const float *color = job.srgb ? t.srgbToLinear : t.linear;
+        for (int x = packed; x < job.inputWidth; x++) {
+            for (int c = 0; c < job.channels; c++)
+                row[x * LANES + c] = (c == 3 ? t.linear : color)[src[x * job.channels + c]];
+        }
+    }
+
+    // Four floats to four bytes, clamped and rounded
+    void encodeRowSse2(const Job &job, const float *pixels, unsigned char *dst) {
+        const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        for (int x = 0; x < job.outputWidth; x++) {
+            __m128 v = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(pixels + x * LANES)));
+            __m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+            i = _mm_packs_epi32(i, i);
+            int packed = _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+            memcpy(dst + x * job.channels, &packed, job.channels);
+        }
+    }
+#endif
+
+    std::atomic<int> & simdSetting() {
+        static std::atomic<int> setting((int)CpuFeatures::supported());
+        return setting;
+    }
+
+    void runBand(const Job &job, int y0, int y1) {
+        const Axis &v = job.vertical;
+        size_t rowFloats = (size_t)job.inputWidth * LANES;
+        // Room past the last pixel for the zero-weight padding taps
+        size_t paddedFloats = rowFloats + (size_t)job.horizontal.taps * LANES;
+
+        // A window of decoded input rows; each is decoded once per band
+        int cacheRows = v.taps + 1;
+        std::vector<float> cache((size_t)cacheRows * rowFloats, 0.0f);
+        std::vector<int> cached(cacheRows, -1);
+        std::vector<float> sum(paddedFloats, 0.0f), pixels((size_t)job.outputWidth * LANES);
+        size_t outputStride = (size_t)job.outputWidth * job.channels;
+
+        for (int y = y0; y < y1; y++) {
+            std::fill(sum.begin(), sum.begin() + rowFloats, 0.0f);
+            for (int t = 0; t < v.count[y]; t++) {
+                int source = v.first[y] + t;
+                float *row = &cache[(size_t)(source % cacheRows) * rowFloats];
+                if (cached[source % cacheRows] != source) {
+                    switch (job.simd) {
+#ifdef CPU_X86
+                    case CpuFeatures::SIMD_AVX2: decodeRowAvx2(job, source, row); break;
+                    case CpuFeatures::SIMD_SSE2:
+                        // SSE2 has no gather for the sRGB table
+                        if (job.srgb)
+                            decodeRow(job, source, row);
+                        else
+                            decodeRowSse2(job, source, row);
+                        break;
+#endif
+                    default: decodeRow(job, source, row); break;
+                    }
+                    cached[source % cacheRows] = source;
+                }
+                float weight = v.weights[(size_t)y * v.taps + t];
+                switch (job.simd) {
+#ifdef CPU_X86
+                case CpuFeatures::SIMD_AVX2: accumulateAvx2(sum.data(), row, weight, rowFloats); break;
+                case CpuFeatures::SIMD_SSE2: accumulateSse2(sum.data(), row, weight, rowFloats); break;
+#endif
+                default: accumulateScalar(sum.data(), row, weight, rowFloats); break;
+                }
+            }
+
+            unsigned char *out = job.output + (size_t)y * outputStride;
+            switch (job.simd) {
+#ifdef CPU_X86
+            case CpuFeatures::SIMD_AVX2: horizontalAvx2(job, sum.data(), pixels.data()); break;
+            case CpuFeatures::SIMD_SSE2: horizontalSse2(job, sum.data(), pixels.data(), 0); break;
+#endif
+            default: horizontalScalar(job, sum.data(), pixels.data()); break;
+            }
+#ifdef CPU_X86
+            if (!job.srgb && job.simd != CpuFeatures::SIMD_SCALAR) {
+                encodeRowSse2(job, pixels.data(), out);
+                continue;
+            }
+#endif
+            encodeRow(job, pixels.data(), out);
+        }
+    }
+}
+
+namespace ImageResampler {
+
+std::vector<Level> mipLevels(int width, int height, int channels) {
+    std::vector<Level> levels;
+    size_t offset = 0;
+    for (;;) {
+        size_t size = (size_t)width * height * channels;
+        levels.push_back({ width, height, offset, size });
+        offset += size;
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return levels;
+}
+
+bool resize(ThreadPool *pool, const unsigned char *input, int inputWidth, int inputHeight,
+            unsigned char *output, int outputWidth, int outputHeight, int channels, bool srgb, Filter filter) {
+    PROFILE_SCOPE("ImageResampler::resize");
+    if (!input || !output || inputWidth <= 0 || inputHeight <= 0 || outputWidth <= 0 || outputHeight <= 0 ||
+        channels < 1 || channels > LANES)
+        return false;
+
+    Job job;
+    job.input = input;
+    job.inputWidth = inputWidth;
+    job.inputHeight = inputHeight;
+    job.output = output;
+    job.outputWidth = outputWidth;
+    job.outputHeight = outputHeight;
+    job.channels = channels;
+    job.srgb = srgb;
+    job.horizontal = buildAxis(inputWidth, outputWidth, 0.0f, 1.0f, filter);
+    job.vertical = buildAxis(inputHeight, outputHeight, 0.0f, 1.0f, filter);
+    job.simd = activeSimd();
+
+    int rowsPerBand = std::max(1, MIN_BAND_PIXELS / outputWidth);
+    int bands = (outputHeight + rowsPerBand - 1) / rowsPerBand;
+    auto band = [&job, rowsPerBand, outputHeight](int i) {
+        runBand(job, i * rowsPerBand, std::min(outputHeight, (i + 1) * rowsPerBand));
+    };
+    if (pool && bands > 1) {
+        pool->parallelFor(bands, band);
+    } else {
+        for (int i = 0; i < bands; i++)
+            band(i);
+    }
+    return true;
+}
+
+bool generateMips(ThreadPool *pool, unsigned char *chain, const std::vector<Level> &levels, int channels, bool srgb) {
+    PROFILE_SCOPE("ImageResampler::generateMips");
+    for (size_t i = 1; i < levels.size(); i++) {
+        const Level &above = levels[i - 1], &level = levels[i];
+        if (!resize(pool, chain + above.offset, above.width, above.height,
+                    chain + level.offset, level.width, level.height, channels, srgb, FILTER_BOX))
+            return false;
+    }
+    return true;
+}
+
+CpuFeatures::Simd activeSimd() {
+    return (CpuFeatures::Simd)simdSetting().load();
+}
+
+void setSimd(CpuFeatures::Simd simd) {
+    simdSetting() = std::min((int)simd, (int)CpuFeatures::supported());
+}
+
+} // namespace ImageResampler
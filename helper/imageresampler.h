@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cpufeatures.h"
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// 8-bit image resizing and mip chains on the CPU.
+//
+// A separable resampler with the filter footprints of the bundled
+// stb_image_resize, but with the weights computed once per resize, every
+// input row decoded once per band, and SSE2 / AVX2 kernels for the vertical
+// and horizontal passes (picked at run time; scalar elsewhere).  Each resize
+// is split into bands of output rows that run on a ThreadPool, or on the
+// calling thread when pool is null.  sRGB images are filtered in linear
+// light, with alpha left linear.
+//
+// Mips are box filtered from the level above, the same average
+// glGenerateMipmap takes.
+namespace ImageResampler {
+
+    enum Filter {
+        FILTER_BOX,             // area average when shrinking
+        FILTER_TRIANGLE,        // bilinear when enlarging, tent when shrinking
+        FILTER_CATMULL_ROM      // sharper; overshoot is clamped
+    };
+
+    struct Level {
+        int width, height;
+        size_t offset;      // from the start of the chain
+        size_t size;
+    };
+
+    // Layout of a full, tightly packed mip chain, level 0 first
+    std::vector<Level> mipLevels(int width, int height, int channels);
+
+    // Resizes tightly packed input (1 to 4 channels) into tightly packed output
+    bool resize(ThreadPool *pool, const unsigned char *input, int inputWidth, int inputHeight,
+                unsigned char *output, int outputWidth, int outputHeight, int channels, bool srgb,
+                Filter filter = FILTER_BOX);
+
+    // Fills levels 1 .. n of chain from its level 0, laid out as mipLevels describes
+    bool generateMips(ThreadPool *pool, unsigned char *chain, const std::vector<Level> &levels, int channels, bool srgb);
+
+    // Kernels in use, the widest CpuFeatures::supported() by default;
+    // setSimd is clamped to that and exists to compare the paths
+    CpuFeatures::Simd activeSimd();
+    void setSimd(CpuFeatures::Simd simd);
+}
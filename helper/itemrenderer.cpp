@@ -0,0 +1,124 @@
+#include "itemrenderer.h"
+
+#include "cpuprofiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+ItemRenderer::ItemRenderer() :
+    vao(0), vertexBuffer(0), indexBuffer(0), instanceBuffer(0), indexCount(0), instances(0), capacity(0), attributeFirst(0) {}
+
+ItemRenderer::~ItemRenderer() {
+    if (vao != 0)
+        glDeleteVertexArrays(1, &vao);
+    GLuint buffers[] = { vertexBuffer, indexBuffer, instanceBuffer };
+    for (GLuint buffer : buffers) {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+    }
+}
+
+void ItemRenderer::sphere(int segments, std::vector<float> &vertices, std::vector<GLuint> &indices) {
+    for (int y = 0; y <= segments; y++) {
+        for (int x = 0; x <= segments; x++) {
+            float u = (float)x / segments;
+            float v = (float)y / segments;
+            float px = std::cos(u * 2.0f * glm::pi<float>()) * std::sin(v * glm::pi<float>());
+            float py = std::cos(v * glm::pi<float>());
+            float pz = std::sin(u * 2.0f * glm::pi<float>()) * std::sin(v * glm::pi<float>());
+            float vertex[] = { px, py, pz, px, py, pz, u, v };
+            vertices.insert(vertices.end(), vertex, vertex + 8);
+        }
+    }
+    for (int y = 0; y < segments; y++) {
+        for (int x = 0; x < segments; x++) {
+            GLuint row = (GLuint)(y * (segments + 1) + x), next = row + (GLuint)(segments + 1);
+            GLuint quad[] = { next, row, row + 1, next, row + 1, next + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+void ItemRenderer::create(int segments) {
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+    sphere(segments, vertices, indices);
+    indexCount = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &instanceBuffer);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+
+    // One Instance per sphere: the matrix columns, then colour and layer
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(ATTRIBUTE_MODEL + column);
+        glVertexAttribDivisor(ATTRIBUTE_MODEL + column, 1);
+    }
+    glEnableVertexAttribArray(ATTRIBUTE_COLOR);
+    glVertexAttribDivisor(ATTRIBUTE_COLOR, 1);
+    pointAttributes(0);
+
+    glBindVertexArray(0);
+}
+
+void ItemRenderer::pointAttributes(size_t first) const {
+    // Offsetting the pointers stands in for a base instance, which GL 4.1 lacks
+    size_t base = first * sizeof(Instance);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribPointer(ATTRIBUTE_MODEL + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(base + offsetof(Instance, model) + column * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(ATTRIBUTE_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, color)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    attributeFirst = first;
+}
+
+void ItemRenderer::upload(const std::vector<Instance> &list, size_t first, size_t count) {
+    PROFILE_SCOPE("ItemRenderer::upload");
+    instances = list.size();
+    if (instances == 0)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (instances > capacity) {
+        // Room to grow, so spawning a few more items does not reallocate every time
+        capacity = std::max(instances, capacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+        first = 0;
+        count = instances;
+    }
+    if (first < instances) {
+        count = std::min(count, instances - first);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Instance), count * sizeof(Instance), &list[first]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ItemRenderer::draw(size_t first, size_t count) const {
+    if (first >= instances)
+        return;
+    count = std::min(count, instances - first);
+    if (count == 0)
+        return;
+    glBindVertexArray(vao);
+    if (first != attributeFirst)
+        pointAttributes(first);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)count);
+    glBindVertexArray(0);
+}
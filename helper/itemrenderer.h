@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Draws every collectible sphere with one glDrawElementsInstanced.
+//
+//   ItemRenderer renderer;
+//   renderer.create();
+//   renderer.upload(instances);          // when items move, appear or go
+//   renderer.draw();                     // lit pass and shadow pass alike
+//
+// Each instance's model matrix, colour and texture array layer live in a
+// per-instance vertex buffer (attributes 3 to 7, see ATTRIBUTE_MODEL), so the
+// CPU cost of a frame's items is one draw call and whatever part of the
+// buffer changed, however many there are.  The sphere mesh itself uses
+// attributes 0 to 2 like every other mesh in the scene.
+class ItemRenderer {
+public:
+    static const GLuint ATTRIBUTE_MODEL = 3;    // mat4, four consecutive locations
+    static const GLuint ATTRIBUTE_COLOR = 7;    // vec4: rgb tint, w texture layer
+
+    struct Instance {
+        glm::mat4 model;
+        glm::vec3 color;    // multiplies the texture colour
+        float layer;        // layer of the item texture array
+    };
+    static_assert(sizeof(Instance) == 80, "Instance must match the attribute layout");
+
+    ItemRenderer();
+    ~ItemRenderer();
+
+    ItemRenderer(const ItemRenderer &) = delete;
+    ItemRenderer & operator=(const ItemRenderer &) = delete;
+
+    // UV sphere of radius 1
+    void create(int segments = 32);
+
+    // Its interleaved position, normal and texture coordinate, and indices
+    static void sphere(int segments, std::vector<float> &vertices, std::vector<GLuint> &indices);
+
+    // Instances first .. first + count of the list; the rest of the buffer is
+    // kept.  Growing past the buffer reallocates it and uploads the whole list.
+    void upload(const std::vector<Instance> &instances, size_t first = 0, size_t count = (size_t)-1);
+
+    // Instances first .. first + count - 1 of the buffer; lets one buffer
+    // hold a list per pass, e.g. after culling
+    void draw(size_t first = 0, size_t count = (size_t)-1) const;
+
+    size_t instanceCount() const { return instances; }
+
+private:
+    GLuint vao;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLuint instanceBuffer;
+    GLsizei indexCount;
+    size_t instances;
+    size_t capacity;        // instances the buffer can hold
+    mutable size_t attributeFirst;  // instance the attributes point at
+
+    void pointAttributes(size_t first) const;
+};
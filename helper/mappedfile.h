@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// Read-only memory mapping of a whole file.  Pages are read in by the OS on
+// first touch, so opening a large file costs almost nothing and only the
+// bytes actually used are ever read from disk.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &fileName);
+    void close();
+
+    bool isOpen() const { return bytes != nullptr; }
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes;
+    size_t length;
+#ifdef _WIN32
+    void *file;
+    void *mapping;
+#endif
+};
+
+// Creates or replaces fileName with what fill writes to the open stream.
+// The data goes to a temporary file that is renamed over fileName only if
+// fill returns true and the file closes cleanly, so a reader never maps a
+// half-written file.
+bool writeFileAtomically(const std::string &fileName, const std::function<bool(FILE *)> &fill);
@@ -0,0 +1,292 @@
+#include "particleengine.h"
+
+#include "cpuprofiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+    const GLuint GROUP_SIZE = 64;           // local_size_x in particle_emit.cs and particle_simulate.cs
+    const GLuint MAX_GROUPS = 65535;        // the least GL_MAX_COMPUTE_WORK_GROUP_COUNT allowed
+}
+
+ParticleEngine::ParticleEngine() :
+    particleBuffer(0), deadBuffer(0), aliveBuffers{ 0, 0 }, counterBuffer(0), emitterBuffer(0), countBuffer(0),
+    vertexArray(0), countFence(nullptr), particleCapacity(0), emitterCapacity(0), current(0), alive(0), frame(0),
+    emissionScale(1.0f), emittersChanged(false), emitProgram(nullptr), prepareProgram(nullptr), updateProgram(nullptr) {}
+
+ParticleEngine::~ParticleEngine() {
+    release();
+}
+
+bool ParticleEngine::supported() {
+    if (!GLAD_GL_VERSION_4_3)
+        return false;
+    GLint vertexBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+    return vertexBlocks >= 3;
+}
+
+void ParticleEngine::release() {
+    GLuint buffers[] = { particleBuffer, deadBuffer, aliveBuffers[0], aliveBuffers[1], counterBuffer, emitterBuffer, countBuffer };
+    for (GLuint buffer : buffers) {
+        if (buffer != 0)
+            glDeleteBuffers(1, &buffer);
+    }
+    if (vertexArray != 0)
+        glDeleteVertexArrays(1, &vertexArray);
+    if (countFence)
+        glDeleteSync(countFence);
+    particleBuffer = deadBuffer = aliveBuffers[0] = aliveBuffers[1] = counterBuffer = emitterBuffer = countBuffer = 0;
+    vertexArray = 0;
+    countFence = nullptr;
+    particleCapacity = emitterCapacity = 0;
+    alive = 0;
+}
+
+void ParticleEngine::setPrograms(GLSLProgram &emit, GLSLProgram &prepare, GLSLProgram &update) {
+    emitProgram = &emit;
+    emitUniforms.emitter = emit.uniform<GLuint>("emitter");
+    emitUniforms.first = emit.uniform<GLuint>("first");
+    emitUniforms.count = emit.uniform<GLuint>("count");
+    emitUniforms.seed = emit.uniform<GLuint>("seed");
+    emitUniforms.current = emit.uniform<GLuint>("current");
+    emitUniforms.position = emit.uniform<glm::vec3>("position");
+    emitUniforms.angle = emit.uniform<float>("angle");
+
+    prepareProgram = &prepare;
+    prepareCurrent = prepare.uniform<GLuint>("current");
+
+    updateProgram = &update;
+    updateUniforms.current = update.uniform<GLuint>("current");
+    updateUniforms.deltaTime = update.uniform<float>("deltaTime");
+}
+
+bool ParticleEngine::create(size_t capacity) {
+    release();
+    emitters.clear();
+    pending.clear();
+    bursts.clear();
+    if (!supported())
+        return false;
+    particleCapacity = capacity;
+    current = 0;
+
+    GLuint *buffers[] = { &particleBuffer, &deadBuffer, &aliveBuffers[0], &aliveBuffers[1], &counterBuffer, &emitterBuffer, &countBuffer };
+    for (GLuint *buffer : buffers)
+        glGenBuffers(1, buffer);
+    glGenVertexArrays(1, &vertexArray);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(capacity, 1) * sizeof(Particle), nullptr, GL_DYNAMIC_COPY);
+
+    // Every slot starts dead, the lowest on top
+    std::vector<GLuint> dead(capacity);
+    for (size_t i = 0; i < capacity; i++)
+        dead[i] = (GLuint)(capacity - 1 - i);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, deadBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(capacity, 1) * sizeof(GLuint), dead.data(), GL_DYNAMIC_COPY);
+    for (GLuint buffer : aliveBuffers) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(capacity, 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    Counters counters = {};
+    for (DrawCommand &draw : counters.draws)
+        draw.instanceCount = 1;
+    counters.groups[1] = counters.groups[2] = 1;
+    counters.dead = (GLint)capacity;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Counters), &counters, GL_DYNAMIC_COPY);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, countBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return true;
+}
+
+int ParticleEngine::addEmitter(const Emitter &emitter) {
+    emitters.push_back(emitter);
+    pending.push_back(0.0f);
+    emittersChanged = true;
+    return (int)emitters.size() - 1;
+}
+
+void ParticleEngine::setEmitter(int index, const Emitter &emitter) {
+    emitters[index] = emitter;
+    emittersChanged = true;
+}
+
+void ParticleEngine::burst(int emitter, int count) {
+    burst(emitter, count, emitters[emitter].position);
+}
+
+void ParticleEngine::burst(int emitter, int count, const glm::vec3 &position) {
+    if (count > 0)
+        bursts.push_back({ emitter, count, position });
+}
+
+void ParticleEngine::uploadEmitters() {
+    std::vector<EmitterData> data(emitters.size());
+    for (size_t i = 0; i < emitters.size(); i++) {
+        const Emitter &emitter = emitters[i];
+        data[i].positionRadius = glm::vec4(emitter.position, emitter.radius);
+        data[i].colorSize = glm::vec4(emitter.color, emitter.size);
+        data[i].speed = emitter.speed;
+        data[i].gravity = emitter.gravity;
+        data[i].lifeDecay = emitter.lifeDecay;
+        data[i].rotationSpeed = emitter.rotationSpeed;
+        data[i].shape = (GLuint)emitter.shape;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, emitterBuffer);
+    if (data.size() > emitterCapacity) {
+        emitterCapacity = data.size();
+        glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(EmitterData), data.data(), GL_DYNAMIC_DRAW);
+    } else if (!data.empty()) {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(EmitterData), data.data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    emittersChanged = false;
+}
+
+void ParticleEngine::emit(int emitter, GLuint count, const glm::vec3 &position, float angle) {
+    // Split so no dispatch has more groups than every implementation allows
+    const GLuint chunk = MAX_GROUPS * GROUP_SIZE;
+    emitProgram->setUniform(emitUniforms.emitter, (GLuint)emitter);
+    emitProgram->setUniform(emitUniforms.count, count);
+    emitProgram->setUniform(emitUniforms.position, position);
+    emitProgram->setUniform(emitUniforms.angle, angle);
+    for (GLuint first = 0; first < count; first += chunk) {
+        GLuint size = std::min(chunk, count - first);
+        emitProgram->setUniform(emitUniforms.first, first);
+        emitProgram->setUniform(emitUniforms.seed, frame * 7919u + first + (GLuint)emitter * 104729u);
+        glDispatchCompute((size + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    }
+}
+
+void ParticleEngine::update(float deltaTime) {
+    if (particleBuffer == 0 || !emitProgram || !prepareProgram || !updateProgram)
+        return;
+    PROFILE_SCOPE("ParticleEngine::update");
+    readAliveCount();
+    if (emittersChanged)
+        uploadEmitters();
+    frame++;
+
+    int next = 1 - current;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEAD_BINDING, deadBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, aliveBuffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NEXT_ALIVE_BINDING, aliveBuffers[next]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTER_BINDING, emitterBuffer);
+
+    // New particles join the current list, so they are updated this frame too
+    bool emitted = false;
+    emitProgram->use();
+    emitProgram->setUniform(emitUniforms.current, (GLuint)current);
+    for (const Burst &burst : bursts) {
+        GLuint count = (GLuint)(burst.count * emissionScale + 0.5f);
+        if (count == 0)
+            continue;
+        emit(burst.emitter, count, burst.position, 0.0f);
+        emitted = true;
+    }
+    bursts.clear();
+    for (size_t i = 0; i < emitters.size(); i++) {
+        pending[i] += emitters[i].rate * emissionScale * deltaTime;
+        GLuint count = (GLuint)pending[i];
+        if (count == 0)
+            continue;
+        pending[i] -= (float)count;
+        // A steady trickle would otherwise always start at the same place on a ring
+        float angle = glm::two_pi<float>() * (float)((frame * 2654435761u) >> 8) / (float)(1u << 24);
+        emit((int)i, count, emitters[i].position, angle);
+        emitted = true;
+    }
+    if (emitted)
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Size the update from the current count and empty the other list
+    prepareProgram->use();
+    prepareProgram->setUniform(prepareCurrent, (GLuint)current);
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    updateProgram->use();
+    updateProgram->setUniform(updateUniforms.current, (GLuint)current);
+    updateProgram->setUniform(updateUniforms.deltaTime, deltaTime);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+    glDispatchComputeIndirect(offsetof(Counters, groups));
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    // The counters are read next as storage, as draw commands and by the count copy
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    current = next;
+
+    for (GLuint binding = PARTICLE_BINDING; binding <= EMITTER_BINDING; binding++)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+
+    // A copy of the count to read once the GPU has got this far
+    if (!countFence) {
+        glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, countBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, current * sizeof(DrawCommand), 0, sizeof(GLuint));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+void ParticleEngine::readAliveCount() {
+    if (!countFence)
+        return;
+    GLenum status = glClientWaitSync(countFence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(countFence);
+    countFence = nullptr;
+
+    GLuint count = 0;
+    glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &count);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    alive = (int)count;
+}
+
+void ParticleEngine::draw() const {
+    if (particleBuffer == 0)
+        return;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, aliveBuffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTER_BINDING, emitterBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counterBuffer);
+    glDrawArraysIndirect(GL_POINTS, (const void *)(current * sizeof(DrawCommand)));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTER_BINDING, 0);
+}
+
+void ParticleEngine::drawSorted(GLuint indices, GLsizei count) const {
+    if (particleBuffer == 0)
+        return;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, particleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, aliveBuffers[current]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTER_BINDING, emitterBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glDrawElements(GL_POINTS, count, GL_UNSIGNED_INT, nullptr);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLE_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTER_BINDING, 0);
+}
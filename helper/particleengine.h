@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glslprogram.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Particles spawned, simulated and counted entirely on the GPU with compute
+// shaders.
+//
+//   ParticleEngine engine;
+//   engine.setPrograms(emitProgram, prepareProgram, updateProgram);  // shader/particle_emit.cs, _prepare.cs, _simulate.cs
+//   engine.create(capacity);
+//   int ring = engine.addEmitter(ringEmitter);
+//   engine.burst(ring, 1000);
+//   ...
+//   engine.update(deltaTime);          // once a frame
+//   engine.draw();                     // with shader/particle_draw.vert in use
+//
+// Particles live in a shader storage buffer of fixed capacity.  Free slots
+// are kept on a dead list and live ones on one of two alive lists, all
+// indices updated with atomics.  Emitting pops slots off the dead list onto
+// the current alive list; the update pass moves each survivor onto the other
+// alive list and each expired particle back onto the dead list, and the
+// lists swap.  The alive counts double as the vertex counts of
+// glDrawArraysIndirect commands, and a one-thread pass turns the current
+// count into the update's glDispatchComputeIndirect size, so no count
+// travels through the CPU.  Emitting more than the dead list holds is
+// silently dropped.
+class ParticleEngine {
+public:
+    enum Shape { SHAPE_RING, SHAPE_SPHERE };
+
+    struct Emitter {
+        Shape shape = SHAPE_SPHERE;
+        glm::vec3 position = glm::vec3(0.0f);
+        float radius = 0.0f;            // of the ring in XZ, or of the sphere particles start on
+        float speed = 1.0f;             // along the ring, or outwards from the sphere
+        float gravity = 0.0f;
+        float lifeDecay = 1.0f;         // life lost per second, from 1 at birth
+        float rotationSpeed = 0.0f;     // radians per second about position, in XZ
+        glm::vec3 color = glm::vec3(1.0f);
+        float size = 1.0f;              // point size at distance 1, scaled by 100
+        float rate = 0.0f;              // particles per second, besides any burst()
+    };
+
+    // Shader storage bindings, matching shader/particle_emit.cs, _prepare.cs, _simulate.cs and particle_draw.vert
+    static const GLuint PARTICLE_BINDING = 0;
+    static const GLuint DEAD_BINDING = 1;
+    static const GLuint ALIVE_BINDING = 2;          // the list drawn or updated
+    static const GLuint NEXT_ALIVE_BINDING = 3;     // survivors of the update
+    static const GLuint COUNTER_BINDING = 4;
+    static const GLuint EMITTER_BINDING = 5;
+
+    ParticleEngine();
+    ~ParticleEngine();
+
+    ParticleEngine(const ParticleEngine &) = delete;
+    ParticleEngine & operator=(const ParticleEngine &) = delete;
+
+    // Compute shaders, shader storage and indirect dispatch (GL 4.3), and
+    // the three storage blocks particle_draw.vert reads, which GL 4.3 does
+    // not guarantee in vertex shaders
+    static bool supported();
+
+    void setPrograms(GLSLProgram &emit, GLSLProgram &prepare, GLSLProgram &update);
+
+    // Room for capacity live particles; drops every particle and emitter.
+    // False if unsupported.
+    bool create(size_t capacity);
+
+    // Returns the emitter's index
+    int addEmitter(const Emitter &emitter);
+    void setEmitter(int index, const Emitter &emitter);
+    const Emitter &emitter(int index) const { return emitters[index]; }
+
+    // count particles at the next update(); a ring burst spaces them evenly
+    void burst(int emitter, int count);
+    void burst(int emitter, int count, const glm::vec3 &position);
+
+    // Multiplies every emitter's rate and every burst from the next update()
+    // on, to shed load (ParticleLod); 1 by default
+    void setEmissionScale(float scale) { emissionScale = std::max(scale, 0.0f); }
+
+    void update(float deltaTime);
+
+    // Points with one vertex per live particle; the vertex shader finds its
+    // particle through the alive list at ALIVE_BINDING
+    void draw() const;
+
+    // The same points in the order of an element buffer of alive list
+    // entries, as ParticleSorter writes it; 0xFFFFFFFF entries are skipped
+    void drawSorted(GLuint indices, GLsizei count) const;
+
+    size_t capacity() const { return particleCapacity; }
+
+    // Live particles as of a frame or two ago, read back without stalling
+    int aliveCount() const { return alive; }
+
+private:
+    // std430 layouts; must match the shaders
+    struct Particle {
+        glm::vec4 positionLife;     // xyz, w life
+        glm::vec3 velocity;
+        GLuint emitter;
+    };
+    static_assert(sizeof(Particle) == 32, "Particle must match the std430 ParticleData block");
+
+    struct EmitterData {
+        glm::vec4 positionRadius;
+        glm::vec4 colorSize;
+        float speed, gravity, lifeDecay, rotationSpeed;
+        GLuint shape;
+        GLuint padding[3];
+    };
+    static_assert(sizeof(EmitterData) == 64, "EmitterData must match the std430 EmitterData block");
+
+    // Read by glDrawArraysIndirect and glDispatchComputeIndirect as well
+    struct DrawCommand {
+        GLuint count;               // live particles on that alive list
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+    struct Counters {
+        DrawCommand draws[2];       // one per alive list
+        GLuint groups[3];           // for the update, written by the prepare pass
+        GLint dead;                 // entries on the dead list
+    };
+    static_assert(sizeof(Counters) == 48, "Counters must match the std430 CounterData block");
+
+    struct Burst {
+        int emitter;
+        int count;
+        glm::vec3 position;
+    };
+
+    GLuint particleBuffer;
+    GLuint deadBuffer;
+    GLuint aliveBuffers[2];
+    GLuint counterBuffer;
+    GLuint emitterBuffer;
+    GLuint countBuffer;             // copy of the alive count to read back
+    GLuint vertexArray;             // empty; the vertex shader reads the buffers
+    GLsync countFence;
+    size_t particleCapacity;
+    size_t emitterCapacity;
+    int current;                    // alive list holding the latest particles
+    int alive;
+    unsigned frame;                 // seeds the random numbers
+
+    std::vector<Emitter> emitters;
+    std::vector<float> pending;     // fractional particles owed by each emitter's rate
+    std::vector<Burst> bursts;
+    float emissionScale;
+    bool emittersChanged;
+
+    GLSLProgram *emitProgram;
+    GLSLProgram *prepareProgram;
+    GLSLProgram *updateProgram;
+    struct {
+        UniformHandle<GLuint> emitter, first, count, seed, current;
+        UniformHandle<glm::vec3> position;
+        UniformHandle<float> angle;
+    } emitUniforms;
+    UniformHandle<GLuint> prepareCurrent;
+    struct {
+        UniformHandle<GLuint> current;
+        UniformHandle<float> deltaTime;
+    } updateUniforms;
+
+    void release();
+    void uploadEmitters();
+    void emit(int emitter, GLuint count, const glm::vec3 &position, float angle);
+    void readAliveCount();
+};
@@ -0,0 +1,38 @@
+#include "particlelod.h"
+
+#include <algorithm>
+
+namespace {
+    const float SMOOTHING = 0.1f;       // weight of each new measurement in the average
+    const float INCREASE = 0.005f;      // detail regained per frame well under budget
+    const int SETTLE_READINGS = 4;      // GpuProfiler::FRAME_LATENCY: readings still taken before a cut
+}
+
+void ParticleLod::setBudget(float milliseconds) {
+    budgetMs = std::max(milliseconds, 0.0f);
+    if (budgetMs == 0.0f)
+        level = 1.0f;
+    settling = 0;
+}
+
+void ParticleLod::update(float milliseconds) {
+    milliseconds = std::max(milliseconds, 0.0f);
+    smoothedMs += (milliseconds - smoothedMs) * SMOOTHING;
+    if (budgetMs == 0.0f)
+        return;
+    if (settling > 0) {
+        settling--;
+        return;
+    }
+
+    // Over budget, cut at once in proportion to the overshoot, taking the
+    // cost to scale with detail; the readings of frames drawn before the cut
+    // are then skipped, or they would cut again for the same overshoot
+    if (milliseconds > budgetMs && level > MIN_DETAIL) {
+        level = std::max(level * budgetMs / milliseconds, MIN_DETAIL);
+        smoothedMs = budgetMs;
+        settling = SETTLE_READINGS;
+    } else if (smoothedMs < budgetMs * RECOVER_BELOW) {
+        level = std::min(level + INCREASE, 1.0f);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Keeps the particles' GPU time within a budget by trading detail.
+//
+//   ParticleLod lod;
+//   lod.setBudget(2.0f);               // ms for the particle pass; 0 keeps full detail
+//   ...
+//   lod.update(particleMs);            // once a frame, from GpuProfiler's particle pass
+//   program.setUniform(maxPointSize, lod.maxPointSize());
+//   program.setUniform(thinPointSize, lod.thinPointSize());
+//   engine.setEmissionScale(lod.emissionScale());
+//
+// Detail runs from 1 down to MIN_DETAIL.  Lower detail caps points at fewer
+// pixels, thins out more of the small ones, and emits fewer new particles.
+// Even at full detail, points are capped at MAX_POINT_SIZE pixels, so
+// particles right next to the camera cannot cover the screen.  Particles
+// smaller than thinPointSize() once capped are kept with probability
+// (size / thinPointSize())^2, and the ones kept are drawn at thinPointSize(),
+// so the covered area stays the same on average.  Below 1/8 the two sizes
+// cross: the ones kept are drawn no larger than the cap, so the covered
+// area falls too, with the fourth power of detail.
+//
+// A time over budget scales detail down at once by budget / time, and the
+// next few times, measured before the cut took effect, are skipped.  Only
+// recovery is smoothed: once the average time is under RECOVER_BELOW of
+// the budget, detail creeps back up, so it settles instead of oscillating.
+class ParticleLod {
+public:
+    static constexpr float MAX_POINT_SIZE = 64.0f;  // pixels, at full detail
+    static constexpr float THIN_POINT_SIZE = 1.0f;  // pixels, at full detail
+    static constexpr float MIN_DETAIL = 1.0f / 32; // points capped at 2 pixels
+    static constexpr float RECOVER_BELOW = 0.8f;    // of the budget
+
+    // Milliseconds of GPU time for the particle pass; 0 or less turns the
+    // budget off and restores full detail
+    void setBudget(float milliseconds);
+    float budget() const { return budgetMs; }
+
+    // Feeds one frame's measured particle pass time
+    void update(float milliseconds);
+
+    float detail() const { return level; }
+    float averageMs() const { return smoothedMs; }
+
+    float maxPointSize() const { return MAX_POINT_SIZE * level; }
+    float thinPointSize() const { return THIN_POINT_SIZE / level; }
+    float emissionScale() const { return level; }
+
+private:
+    float budgetMs = 0.0f;
+    float smoothedMs = 0.0f;
+    float level = 1.0f;
+    int settling = 0;           // readings left to skip after a cut
+};
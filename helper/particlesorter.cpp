@@ -0,0 +1,111 @@
+#include "particlesorter.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+
+namespace {
+    const size_t BLOCK = 1024;          // keys sorted in shared memory by one group
+    const GLuint GROUP_SIZE = 512;      // local_size_x in particle_sort.cs, a thread per pair
+    const GLuint RESTART_INDEX = 0xFFFFFFFFu;
+
+    // Passes of particle_sort.cs
+    const GLuint PASS_SORT_BLOCKS = 0;  // every block on its own
+    const GLuint PASS_GLOBAL = 1;       // one step wider than a block
+    const GLuint PASS_MERGE_BLOCKS = 2; // the remaining steps within each block
+}
+
+bool ParticleSorter::supported(int readBlocks) {
+    if (!GLAD_GL_VERSION_4_3)
+        return false;
+    GLint vertexBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+    return vertexBlocks >= 2 + readBlocks;
+}
+
+ParticleSorter::ParticleSorter() : keys(0), indices(0), count(0), program(nullptr) {}
+
+ParticleSorter::~ParticleSorter() {
+    release();
+}
+
+void ParticleSorter::release() {
+    if (keys != 0)
+        glDeleteBuffers(1, &keys);
+    if (indices != 0)
+        glDeleteBuffers(1, &indices);
+    keys = indices = 0;
+    count = 0;
+}
+
+void ParticleSorter::setProgram(GLSLProgram &sortProgram) {
+    program = &sortProgram;
+    uniforms.pass = sortProgram.uniform<GLuint>("pass");
+    uniforms.blockSize = sortProgram.uniform<GLuint>("blockSize");
+    uniforms.stride = sortProgram.uniform<GLuint>("stride");
+}
+
+void ParticleSorter::create(size_t capacity) {
+    release();
+    count = BLOCK;
+    while (count < capacity)
+        count <<= 1;
+
+    glGenBuffers(1, &keys);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, keys);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &indices);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indices);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ParticleSorter::beginKeys() {
+    if (keys == 0)
+        return;
+    // Key 0 is the nearest depth, so unwritten slots sort after every particle
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, keys);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, indices);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &RESTART_INDEX);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEY_BINDING, keys);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indices);
+}
+
+void ParticleSorter::sort() {
+    if (!program || keys == 0)
+        return;
+    PROFILE_SCOPE("ParticleSorter::sort");
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEY_BINDING, keys);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indices);
+    program->use();
+
+    // One thread per compared pair, so one group per block either way
+    GLuint groups = (GLuint)(count / (2 * GROUP_SIZE));
+    program->setUniform(uniforms.pass, PASS_SORT_BLOCKS);
+    glDispatchCompute(groups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Merging sequences longer than a block: the steps that compare across
+    // blocks go through the buffers, the rest stay in shared memory
+    for (size_t blockSize = 2 * BLOCK; blockSize <= count; blockSize <<= 1) {
+        program->setUniform(uniforms.blockSize, (GLuint)blockSize);
+        program->setUniform(uniforms.pass, PASS_GLOBAL);
+        for (size_t stride = blockSize / 2; stride >= BLOCK; stride >>= 1) {
+            program->setUniform(uniforms.stride, (GLuint)stride);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        program->setUniform(uniforms.pass, PASS_MERGE_BLOCKS);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Drawn as the element array next
+    glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEY_BINDING, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, 0);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "glslprogram.h"
+
+#include <cstddef>
+
+// Orders particles back to front on the GPU, for blending that is not
+// commutative.
+//
+//   ParticleSorter sorter;
+//   sorter.setProgram(sortProgram);        // shader/particle_sort.cs
+//   sorter.create(capacity);
+//   ...
+//   sorter.beginKeys();
+//   // draw the particles with shader/particle_key.vert and GL_RASTERIZER_DISCARD on
+//   sorter.sort();
+//   particles.drawSorted(sorter.indexBuffer(), sorter.size());
+//
+// A key pass, particle_key.vert or particle_draw_key.vert, writes each
+// vertex's view depth and number to the key and index buffers at
+// KEY_BINDING and INDEX_BINDING, slot gl_VertexID.  The draw shaders stay
+// free of storage blocks they would only need for sorting.  A bitonic sort then orders both by depth, farthest first:
+// whole blocks in shared memory, and only the steps wider than a block over
+// the buffers.  Slots no vertex wrote keep the primitive restart index and
+// sort last, so the index buffer can be drawn whole with
+// GL_PRIMITIVE_RESTART_FIXED_INDEX and no count read back.
+class ParticleSorter {
+public:
+    // Shader storage bindings, after ParticleEngine's; matching
+    // shader/particle_sort.cs, particle_key.vert and particle_draw_key.vert
+    static const GLuint KEY_BINDING = 6;
+    static const GLuint INDEX_BINDING = 7;
+
+    // Compute shaders (GL 4.3), and storage blocks enough in vertex shaders
+    // for a key pass that reads readBlocks of its own besides the two it
+    // writes; GL 4.3 may have none there
+    static bool supported(int readBlocks = 0);
+
+    ParticleSorter();
+    ~ParticleSorter();
+
+    ParticleSorter(const ParticleSorter &) = delete;
+    ParticleSorter & operator=(const ParticleSorter &) = delete;
+
+    void setProgram(GLSLProgram &program);
+
+    // Room for vertex numbers below capacity, rounded up to a power of two
+    // of at least one block
+    void create(size_t capacity);
+
+    // Resets every slot and binds the buffers for the key pass
+    void beginKeys();
+
+    // Sorts what the key pass wrote; the index buffer is then ready to draw
+    void sort();
+
+    // GL_UNSIGNED_INT vertex numbers, farthest first, then restart indices
+    GLuint indexBuffer() const { return indices; }
+    GLsizei size() const { return (GLsizei)count; }
+
+private:
+    GLuint keys;
+    GLuint indices;
+    size_t count;
+
+    GLSLProgram *program;
+    struct {
+        UniformHandle<GLuint> pass, blockSize, stride;
+    } uniforms;
+
+    void release();
+};
@@ -0,0 +1,131 @@
+#include "particlestream.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+#include <cstddef>
+
+ParticleStream::ParticleStream() :
+    buffer(0), vertexArrays{}, persistentPointer(nullptr), fences{}, count(0), region(REGIONS - 1), mapped(false) {}
+
+ParticleStream::~ParticleStream() {
+    release();
+}
+
+void ParticleStream::release() {
+    for (GLsync &fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer != 0) {
+        if (persistentPointer) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+    if (vertexArrays[0] != 0)
+        glDeleteVertexArrays(REGIONS, vertexArrays);
+    std::fill(vertexArrays, vertexArrays + REGIONS, 0);
+    buffer = 0;
+    persistentPointer = nullptr;
+    count = 0;
+}
+
+bool ParticleStream::create(size_t vertices) {
+    release();
+    count = vertices;
+    region = REGIONS - 1;
+    GLsizeiptr size = (GLsizeiptr)(REGIONS * std::max<size_t>(count, 1) * sizeof(CpuParticles::Vertex));
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (glBufferStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        persistentPointer = (CpuParticles::Vertex *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    // The attributes of each region's vertex array start at the region, so
+    // vertex numbers start from 0 in each, as ParticleSorter expects
+    glGenVertexArrays(REGIONS, vertexArrays);
+    const GLsizei stride = sizeof(CpuParticles::Vertex);
+    for (int r = 0; r < REGIONS; r++) {
+        size_t start = (size_t)r * count * sizeof(CpuParticles::Vertex);
+        glBindVertexArray(vertexArrays[r]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void *)(start + offsetof(CpuParticles::Vertex, position)));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (const void *)(start + offsetof(CpuParticles::Vertex, size)));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return !glBufferStorage || persistentPointer != nullptr;
+}
+
+CpuParticles::Vertex *ParticleStream::map() {
+    if (buffer == 0 || count == 0)
+        return nullptr;
+    PROFILE_SCOPE("ParticleStream::map");
+    region = (region + 1) % REGIONS;
+
+    // Normally long signalled, REGIONS - 1 frames ago
+    if (fences[region]) {
+        while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fences[region]);
+        fences[region] = nullptr;
+    }
+
+    size_t first = (size_t)region * count;
+    if (persistentPointer)
+        return persistentPointer + first;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    void *pointer = glMapBufferRange(GL_ARRAY_BUFFER, first * sizeof(CpuParticles::Vertex), count * sizeof(CpuParticles::Vertex),
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mapped = pointer != nullptr;
+    return (CpuParticles::Vertex *)pointer;
+}
+
+void ParticleStream::unmap() {
+    // A coherent mapping needs nothing; the writes are seen by later commands
+    if (!mapped)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mapped = false;
+}
+
+void ParticleStream::draw() {
+    if (buffer == 0 || count == 0)
+        return;
+    glBindVertexArray(vertexArrays[region]);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glBindVertexArray(0);
+    fenceRegion();
+}
+
+void ParticleStream::drawSorted(GLuint indices, GLsizei indexCount) {
+    if (buffer == 0 || count == 0)
+        return;
+    glBindVertexArray(vertexArrays[region]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glDrawElements(GL_POINTS, indexCount, GL_UNSIGNED_INT, nullptr);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    fenceRegion();
+}
+
+void ParticleStream::fenceRegion() {
+    // The region can be rewritten once this draw is done with it
+    if (fences[region])
+        glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
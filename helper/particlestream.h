@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "cpuparticles.h"
+
+// Vertex buffer the CPU rewrites every frame, for CpuParticles.
+//
+//   ParticleStream stream;
+//   stream.create(count);
+//   particles.update(&pool, deltaTime, settings, stream.map());
+//   stream.unmap();
+//   ...
+//   stream.draw();                     // with shader/particle.vert in use
+//
+// The buffer holds REGIONS copies of the vertices, used in turn and each
+// fenced after the draw that reads it, so the CPU fills one while the GPU
+// may still be drawing the others.  With glBufferStorage (GL 4.4 or
+// ARB_buffer_storage) it stays persistently mapped; otherwise each region
+// is mapped unsynchronized once its fence has passed.  Each region has its
+// own vertex array, set up with glVertexAttribPointer, so drawing needs no
+// more than GL 3.3.  drawSorted() takes ParticleSorter's indices, which
+// need compute shaders (GL 4.3) to make.
+class ParticleStream {
+public:
+    static const int REGIONS = 3;
+
+    ParticleStream();
+    ~ParticleStream();
+
+    ParticleStream(const ParticleStream &) = delete;
+    ParticleStream & operator=(const ParticleStream &) = delete;
+
+    // Room for count vertices in each region
+    bool create(size_t count);
+
+    // The next region, once the GPU has finished drawing it; count vertices
+    // must be written before unmap()
+    CpuParticles::Vertex *map();
+    void unmap();
+
+    // Points from attribute 0 (position) and 3 (size) of the region last unmapped
+    void draw();
+
+    // The same points in the order of an element buffer of vertex numbers,
+    // as ParticleSorter writes it; 0xFFFFFFFF entries are skipped
+    void drawSorted(GLuint indices, GLsizei count);
+
+    bool persistent() const { return persistentPointer != nullptr; }
+
+private:
+    GLuint buffer;
+    GLuint vertexArrays[REGIONS];   // attributes pointing into each region
+    CpuParticles::Vertex *persistentPointer;
+    GLsync fences[REGIONS];
+    size_t count;
+    int region;                 // last one written
+    bool mapped;
+
+    void release();
+    void fenceRegion();
+};
@@ -0,0 +1,135 @@
+#include "particlesystem.h"
+
+#include "cpuprofiler.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+const std::vector<std::string> ParticleSystem::VARYINGS = { "outPosition", "outVelocity", "outLife", "outSize" };
+
+ParticleSystem::ParticleSystem() : buffers{ 0, 0 }, vertexArrays{ 0, 0 }, feedbacks{ 0, 0 }, current(0), count(0),
+    program(nullptr) {}
+
+ParticleSystem::~ParticleSystem() {
+    release();
+}
+
+void ParticleSystem::release() {
+    if (buffers[0] != 0) {
+        glDeleteTransformFeedbacks(2, feedbacks);
+        glDeleteVertexArrays(2, vertexArrays);
+        glDeleteBuffers(2, buffers);
+    }
+    for (int i = 0; i < 2; i++)
+        buffers[i] = vertexArrays[i] = feedbacks[i] = 0;
+    count = 0;
+}
+
+std::vector<ParticleSystem::Particle> ParticleSystem::ring(size_t count, const Settings &settings, float size) {
+    // The same ring particle_update.vert respawns onto
+    std::vector<Particle> particles(count);
+    for (size_t i = 0; i < count; i++) {
+        float theta = glm::two_pi<float>() * (float(i) / float(count));
+        glm::vec3 direction(std::cos(theta), 0.0f, std::sin(theta));
+        particles[i].position = settings.emitterPosition + direction * settings.emitterRadius;
+        particles[i].velocity = glm::cross(direction, glm::vec3(0.0f, 1.0f, 0.0f)) * settings.speed;
+        particles[i].life = 1.0f;
+        particles[i].size = size;
+    }
+    return particles;
+}
+
+void ParticleSystem::setUpdateProgram(GLSLProgram &updateProgram) {
+    program = &updateProgram;
+    uniforms.emitterPosition = updateProgram.uniform<glm::vec3>("emitterPosition");
+    uniforms.deltaTime = updateProgram.uniform<float>("deltaTime");
+    uniforms.emitterRadius = updateProgram.uniform<float>("emitterRadius");
+    uniforms.particleSpeed = updateProgram.uniform<float>("particleSpeed");
+    uniforms.gravity = updateProgram.uniform<float>("gravity");
+    uniforms.lifeDecay = updateProgram.uniform<float>("lifeDecay");
+    uniforms.rotationSpeed = updateProgram.uniform<float>("rotationSpeed");
+    uniforms.particleCount = updateProgram.uniform<int>("particleCount");
+}
+
+void ParticleSystem::create(const std::vector<Particle> &particles) {
+    release();
+    count = particles.size();
+    current = 0;
+    glGenBuffers(2, buffers);
+    glGenVertexArrays(2, vertexArrays);
+    glGenTransformFeedbacks(2, feedbacks);
+
+    for (int i = 0; i < 2; i++) {
+        // Both the same size; only the first starts with data
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(Particle), i == 0 && count > 0 ? particles.data() : nullptr,
+                     GL_DYNAMIC_COPY);
+
+        glBindVertexArray(vertexArrays[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, velocity));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, life));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, size));
+
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedbacks[i]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[i]);
+    }
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleSystem::update(float deltaTime, const Settings &settings) {
+    if (!program || count == 0)
+        return;
+    PROFILE_SCOPE("ParticleSystem::update");
+
+    program->use();
+    program->setUniform(uniforms.deltaTime, deltaTime);
+    program->setUniform(uniforms.emitterPosition, settings.emitterPosition);
+    program->setUniform(uniforms.emitterRadius, settings.emitterRadius);
+    program->setUniform(uniforms.particleSpeed, settings.speed);
+    program->setUniform(uniforms.gravity, settings.gravity);
+    program->setUniform(uniforms.lifeDecay, settings.lifeDecay);
+    program->setUniform(uniforms.rotationSpeed, settings.rotationSpeed);
+    program->setUniform(uniforms.particleCount, (int)count);
+
+    // Read the current buffer, capture into the other; nothing is rasterized
+    int next = 1 - current;
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(vertexArrays[current]);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedbacks[next]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glEndTransformFeedback();
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    current = next;
+}
+
+void ParticleSystem::draw() const {
+    if (count == 0)
+        return;
+    glBindVertexArray(vertexArrays[current]);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glBindVertexArray(0);
+}
+
+void ParticleSystem::drawSorted(GLuint indices, GLsizei indexCount) const {
+    if (count == 0)
+        return;
+    glBindVertexArray(vertexArrays[current]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glDrawElements(GL_POINTS, indexCount, GL_UNSIGNED_INT, nullptr);
+    glDisable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "glslprogram.h"
+
+#include <vector>
+
+// Particles simulated entirely on the GPU with transform feedback.
+//
+//   ParticleSystem particles;
+//   particles.setUpdateProgram(updateProgram);  // shader/particle_update.vert
+//   particles.create(ParticleSystem::ring(count, settings));
+//   ...
+//   particles.update(deltaTime, settings);      // once a frame
+//   particles.draw();                           // with the drawing program in use
+//
+// The particles live in two buffers.  update() draws the current one as
+// points through the update program with the rasterizer off, capturing the
+// advanced particles into the other, and then swaps them; draw() renders
+// whichever holds the latest state.  Nothing is read back or mapped, so the
+// CPU cost is the same for a hundred particles as for millions.
+class ParticleSystem {
+public:
+    // Matches the update program's outputs, interleaved in VARYINGS order
+    struct Particle {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        float life;         // 1 when spawned, respawns at 0
+        float size;
+    };
+
+    struct Settings {
+        glm::vec3 emitterPosition = glm::vec3(0.0f);
+        float emitterRadius = 1.0f;     // particles spawn on a ring this wide in XZ
+        float speed = 1.0f;             // along the ring
+        float gravity = 0.0f;
+        float lifeDecay = 0.0f;         // life lost per second
+        float rotationSpeed = 0.0f;     // radians per second about the emitter
+    };
+
+    // Names for GLSLProgram::setTransformFeedbackVaryings on the update program
+    static const std::vector<std::string> VARYINGS;
+
+    ParticleSystem();
+    ~ParticleSystem();
+
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem & operator=(const ParticleSystem &) = delete;
+
+    // count particles spread evenly around the emitter, as update() respawns them
+    static std::vector<Particle> ring(size_t count, const Settings &settings, float size = 1.0f);
+
+    void setUpdateProgram(GLSLProgram &program);
+
+    // Replaces every particle
+    void create(const std::vector<Particle> &particles);
+
+    void update(float deltaTime, const Settings &settings);
+
+    // Points from attributes 0 (position), 1 (velocity), 2 (life), 3 (size)
+    void draw() const;
+
+    // The same points in the order of an element buffer of vertex numbers,
+    // as ParticleSorter writes it; 0xFFFFFFFF entries are skipped
+    void drawSorted(GLuint indices, GLsizei count) const;
+
+    size_t size() const { return count; }
+
+private:
+    GLuint buffers[2];
+    GLuint vertexArrays[2];     // reading buffers[i]
+    GLuint feedbacks[2];        // capturing into buffers[i]
+    int current;                // holds the latest particles
+    size_t count;
+
+    GLSLProgram *program;
+    struct {
+        UniformHandle<glm::vec3> emitterPosition;
+        UniformHandle<float> deltaTime, emitterRadius, particleSpeed, gravity, lifeDecay, rotationSpeed;
+        UniformHandle<int> particleCount;
+    } uniforms;
+
+    void release();
+};
@@ -0,0 +1,135 @@
+#include "pixeluploadring.h"
+
+#include <iostream>
+
+namespace {
+    const GLintptr ALIGNMENT = 64;
+
+    GLintptr alignUp(GLintptr value) {
+        return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+}
+
+PixelUploadRing::PixelUploadRing() :
+    handle(0), pointer(nullptr), capacity(0), head(0), nextId(1),
+    frame(0), retiredFrames(0), releasedThisFrame(false) {}
+
+PixelUploadRing::~PixelUploadRing() {
+    for (Fence &fence : fences)
+        glDeleteSync(fence.sync);
+    if (handle != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &handle);
+    }
+}
+
+bool PixelUploadRing::create(GLsizeiptr size) {
+    if (!glBufferStorage)
+        return false;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &handle);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    pointer = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!pointer) {
+        std::cerr << "Unable to map the pixel upload ring" << std::endl;
+        glDeleteBuffers(1, &handle);
+        handle = 0;
+        return false;
+    }
+    capacity = size;
+    return true;
+}
+
+bool PixelUploadRing::allocate(GLsizeiptr size, Allocation &allocation) {
+    if (!pointer || size <= 0 || size > capacity)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (blocks.empty())
+        head = 0;
+    GLintptr tail = blocks.empty() ? 0 : blocks.front().start;
+
+    // Free space is [head, capacity) then [0, tail) while the live blocks do
+    // not wrap, and [head, tail) once they do.  The strict comparisons keep
+    // head from catching up with tail, which would look like an empty ring.
+    GLintptr offset = alignUp(head);
+    if (blocks.empty() || head >= tail) {
+        if (offset + size > capacity) {
+            offset = 0;
+            if (!blocks.empty() && size >= tail)
+                return false;
+        }
+    } else if (offset + size >= tail) {
+        return false;
+    }
+
+    Block block;
+    block.id = nextId++;
+    block.start = head;
+    block.end = offset + size;
+    block.released = false;
+    block.frame = 0;
+    blocks.push_back(block);
+    head = block.end;
+
+    allocation.id = block.id;
+    allocation.offset = offset;
+    allocation.pointer = pointer + offset;
+    allocation.size = size;
+    return true;
+}
+
+void PixelUploadRing::release(const Allocation &allocation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Block &block : blocks) {
+        if (block.id == allocation.id) {
+            block.released = true;
+            block.frame = frame;
+            releasedThisFrame = true;
+            return;
+        }
+    }
+}
+
+void PixelUploadRing::endFrame() {
+    if (!pointer)
+        return;
+    if (releasedThisFrame) {
+        fences.push_back({ frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+        releasedThisFrame = false;
+    }
+    frame++;
+    retire();
+}
+
+void PixelUploadRing::retire() {
+    while (!fences.empty()) {
+        GLenum status = glClientWaitSync(fences.front().sync, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        retiredFrames = fences.front().frame + 1;
+        glDeleteSync(fences.front().sync);
+        fences.pop_front();
+    }
+    // Frames that released nothing have no fence but are done once a later one is
+    if (fences.empty() && !releasedThisFrame)
+        retiredFrames = frame;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!blocks.empty() && blocks.front().released && blocks.front().frame < retiredFrames)
+        blocks.pop_front();
+}
+
+GLsizeiptr PixelUploadRing::used() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (blocks.empty())
+        return 0;
+    GLintptr tail = blocks.front().start;
+    return head >= tail ? head - tail : capacity - tail + head;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// A persistently mapped GL_PIXEL_UNPACK_BUFFER used as a ring of staging
+// memory for texture uploads.
+//
+// Any thread may allocate and write into the mapping; only the GL thread
+// issues the uploads that read it.  Once the last command reading an
+// allocation has been issued, release() it; endFrame() then fences
+// everything released that frame and the space is reused once the GPU has
+// passed the fence.  Allocations are freed in the order they were made, so
+// a long-lived allocation holds back the ones after it.
+class PixelUploadRing {
+public:
+    struct Allocation {
+        uint64_t id = 0;
+        GLintptr offset = 0;       // into the buffer, for the pixels argument of glTexSubImage2D
+        unsigned char *pointer = nullptr;
+        GLsizeiptr size = 0;
+    };
+
+    PixelUploadRing();
+    ~PixelUploadRing();
+
+    PixelUploadRing(const PixelUploadRing &) = delete;
+    PixelUploadRing & operator=(const PixelUploadRing &) = delete;
+
+    // False if the driver lacks glBufferStorage (GL 4.4 / ARB_buffer_storage)
+    bool create(GLsizeiptr size);
+    bool valid() const { return pointer != nullptr; }
+
+    // Thread safe and never blocks; false if there is no room right now
+    bool allocate(GLsizeiptr size, Allocation &allocation);
+
+    // GL thread
+    void release(const Allocation &allocation);
+    void endFrame();
+
+    GLuint getHandle() const { return handle; }
+    GLsizeiptr getSize() const { return capacity; }
+    GLsizeiptr used() const;
+
+private:
+    struct Block {
+        uint64_t id;
+        GLintptr start, end;      // start includes alignment and wrap padding
+        bool released;
+        uint64_t frame;           // frame the block was released in
+    };
+
+    struct Fence {
+        uint64_t frame;
+        GLsync sync;
+    };
+
+    GLuint handle;
+    unsigned char *pointer;
+    GLsizeiptr capacity;
+
+    mutable std::mutex mutex;
+    std::deque<Block> blocks;
+    GLintptr head;
+    uint64_t nextId;
+
+    std::deque<Fence> fences;
+    uint64_t frame;
+    uint64_t retiredFrames;       // frames before this one are known to be complete
+    bool releasedThisFrame;
+
+    void retire();
+};
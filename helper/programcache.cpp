@@ -0,0 +1,191 @@
+#include "programcache.h"
+
+#include "cpuprofiler.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace ProgramBinaryCache {
+
+namespace {
+
+    const uint32_t MAGIC = 0x42504C47;     // "GLPB"
+    const uint32_t FILE_VERSION = 1;
+
+    std::string cacheDir;
+    bool requested = false;
+    int available = -1;     // binary formats checked on first use, once a context exists
+    int hitCount = 0;
+    int missCount = 0;
+
+    void makeDirectory(const std::string &path) {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    // FNV-1a, continued from h
+    uint64_t hashBytes(const void *data, size_t size, uint64_t h) {
+        const unsigned char *p = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++)
+            h = (h ^ p[i]) * 1099511628211ull;
+        return h;
+    }
+
+    std::string glString(GLenum name) {
+        const GLubyte *s = glGetString(name);
+        return s ? (const char *)s : "";
+    }
+
+    // Driver identity stored alongside each binary
+    std::string driverId() {
+        return glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+    }
+
+    std::string fileName(uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return cacheDir + "/" + name;
+    }
+
+    template <typename T>
+    bool readValue(std::ifstream &in, T &value) {
+        return (bool)in.read((char *)&value, sizeof(T));
+    }
+
+    template <typename T>
+    void writeValue(std::ofstream &out, const T &value) {
+        out.write((const char *)&value, sizeof(T));
+    }
+}
+
+void enable(const std::string &directory) {
+    cacheDir = directory;
+    requested = true;
+    available = -1;
+}
+
+void disable() {
+    requested = false;
+}
+
+bool enabled() {
+    if (!requested)
+        return false;
+
+    if (available < 0) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        available = formats > 0;
+        if (available)
+            makeDirectory(cacheDir);
+        else
+            std::cout << "Program binary cache disabled: driver has no binary formats" << std::endl;
+    }
+    return available > 0;
+}
+
+uint64_t key(const std::vector<ShaderSource> &sources) {
+    uint64_t h = 14695981039346656037ull;
+    h = hashBytes(&FILE_VERSION, sizeof(FILE_VERSION), h);
+    for (const ShaderSource &s : sources) {
+        h = hashBytes(&s.type, sizeof(s.type), h);
+        h = hashBytes(s.source.data(), s.source.size(), h);
+    }
+    std::string id = driverId();
+    return hashBytes(id.data(), id.size(), h);
+}
+
+bool load(GLuint program, uint64_t key) {
+    PROFILE_SCOPE("ProgramBinaryCache::load");
+    std::ifstream in(fileName(key), std::ios::binary);
+    if (!in) {
+        missCount++;
+        return false;
+    }
+
+    uint32_t magic = 0, version = 0, idLength = 0;
+    uint64_t storedKey = 0;
+    GLenum format = 0;
+    uint32_t length = 0;
+    bool ok = readValue(in, magic) && readValue(in, version) && readValue(in, storedKey) &&
+              readValue(in, idLength) && magic == MAGIC && version == FILE_VERSION && storedKey == key;
+
+    std::string id(ok ? idLength : 0, '\0');
+    ok = ok && in.read(&id[0], idLength) && id == driverId() &&
+         readValue(in, format) && readValue(in, length);
+
+    std::vector<char> binary(ok ? length : 0);
+    ok = ok && length > 0 && in.read(binary.data(), length);
+
+    if (ok) {
+        glProgramBinary(program, format, binary.data(), (GLsizei)length);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        ok = status == GL_TRUE;
+    }
+
+    if (ok)
+        hitCount++;
+    else
+        missCount++;
+    return ok;
+}
+
+bool store(GLuint program, uint64_t key) {
+    PROFILE_SCOPE("ProgramBinaryCache::store");
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return false;
+
+    // Write to a temporary name first so a crash never leaves a truncated entry
+    std::string path = fileName(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Unable to write program binary: " << tempPath << std::endl;
+            return false;
+        }
+
+        std::string id = driverId();
+        writeValue(out, MAGIC);
+        writeValue(out, FILE_VERSION);
+        writeValue(out, key);
+        writeValue(out, (uint32_t)id.size());
+        out.write(id.data(), id.size());
+        writeValue(out, format);
+        writeValue(out, (uint32_t)written);
+        out.write(binary.data(), written);
+        if (!out)
+            return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+int hits() {
+    return hitCount;
+}
+
+int misses() {
+    return missCount;
+}
+
+} // namespace ProgramBinaryCache
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+//
+// Entries are keyed by a hash of every shader stage's source together with
+// GL_VENDOR, GL_RENDERER and GL_VERSION, so editing a shader or updating the
+// driver simply misses and the program is compiled from source again.  The
+// strings are also stored in each file and compared on load, so a hash
+// collision cannot load the wrong program.  A binary the driver rejects is
+// treated as a miss and overwritten.
+namespace ProgramBinaryCache {
+
+    struct ShaderSource {
+        GLenum type;
+        std::string source;
+    };
+
+    // Enables the cache in the given directory, created on first use.  May be
+    // called before a context exists; the cache stays off if the driver turns
+    // out to offer no binary formats.
+    void enable(const std::string &directory);
+    void disable();
+    bool enabled();
+
+    uint64_t key(const std::vector<ShaderSource> &sources);
+
+    // Loads the cached binary for key into program; true if the program is now linked
+    bool load(GLuint program, uint64_t key);
+
+    // Saves a linked program that was linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    bool store(GLuint program, uint64_t key);
+
+    int hits();
+    int misses();
+}
@@ -22,6 +22,12 @@ public:
 	    width = w;
 	    height = h;
 	}
+
+    /**
+      Framebuffer the final image is rendered into.  0 is the
+      window's default framebuffer; headless runs use an FBO.
+      */
+    void setOutputFramebuffer( GLuint fbo ) { outputFBO = fbo; }
 	
     /**
       Load textures, initialize shaders, etc.
@@ -44,9 +50,33 @@ public:
       */
     virtual void resize(int, int) = 0;
     
+    /**
+      Camera driven by the scene, or nullptr if it has none.
+      Used by the runner to record and replay camera paths.
+      */
+    virtual Camera * getCamera() { return nullptr; }
+
+    /**
+      Blocks until assets still loading in the background are in
+      place.  Benchmarks call this so every run times the same frames.
+      */
+    virtual void finishLoading() { }
+
+    /**
+      Called after the last frame, while the context is still current,
+      to collect GPU results still in flight (timer queries).
+      */
+    virtual void finishFrames() { }
+
     void animate( bool value ) { m_animate = value; }
     bool animating() { return m_animate; }
+
+    // Keyboard/mouse input is ignored while disabled (benchmark replay)
+    void enableInput( bool value ) { m_input = value; }
+    bool inputEnabled() { return m_input; }
     
 protected:
 	bool m_animate;
+	bool m_input = true;
+	GLuint outputFBO = 0;
 };
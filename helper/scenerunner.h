@@ -2,10 +2,17 @@
 #include "scene.h"
 #include <GLFW/glfw3.h>
 #include "glutils.h"
+#include "benchmark.h"
+#include "cpuprofiler.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#ifdef SCENE_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #define WIN_WIDTH 800
 #define WIN_HEIGHT 600
 
@@ -13,17 +20,52 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <vector>
+
+#include "stb_image_write.h"
 
 class SceneRunner {
 public:
     GLFWwindow * window;
     int fbw, fbh;
 	bool debug;           // Set true to enable debug messages
+    bool headless;        // Render into an offscreen FBO instead of a window
+    int headlessFrames;   // Number of frames to render in headless mode
+    std::string headlessOutput;  // Optional PNG written from the last headless frame
+    bool benchmark;              // Replay a camera path at a fixed time step and time every frame
+    std::string benchmarkPath;   // Recorded camera path; a built-in orbit is used if empty
+    std::string benchmarkOutput; // Per-frame timings and percentiles (.json or .csv)
+    float benchmarkDt;           // Simulated seconds per frame during replay
+    int benchmarkWarmup;         // Untimed frames rendered before the replay starts
+    std::string recordPath;      // Record the camera path of an interactive run to this file
     static bool imguiInitialized;  // Add static flag
     static bool imguiBackendInitialized;  // Add backend initialization flag
 
+private:
+    // Offscreen render target used in headless mode
+    GLuint offscreenFBO = 0;
+    GLuint offscreenColor = 0;
+    GLuint offscreenDepth = 0;
+    std::chrono::steady_clock::time_point runStart;
+#ifdef SCENE_HEADLESS_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    EGLContext eglContext = EGL_NO_CONTEXT;
+#endif
+
 public:
-    SceneRunner(const std::string & windowTitle, int width = WIN_WIDTH, int height = WIN_HEIGHT, int samples = 0) : debug(true) {
+    SceneRunner(const std::string & windowTitle, int width = WIN_WIDTH, int height = WIN_HEIGHT, int samples = 0, bool headless = false) :
+        window(nullptr), debug(true), headless(headless), headlessFrames(100),
+        benchmark(false), benchmarkOutput("benchmark.json"), benchmarkDt(1.0f / 60.0f), benchmarkWarmup(5) {
+        if (headless) {
+            initHeadless(width, height);
+            return;
+        }
+
+#ifdef SCENE_HEADLESS_ONLY
+        std::cerr << "This build has no GLFW support, only headless mode is available." << std::endl;
+        exit( EXIT_FAILURE );
+#else
         // Initialize GLFW
         if( !glfwInit() ) exit( EXIT_FAILURE );
 
@@ -75,10 +117,13 @@ public:
 				GL_DEBUG_SEVERITY_NOTIFICATION, -1, "Start debugging");
 		}
 #endif
+#endif // SCENE_HEADLESS_ONLY
     }
 
     int run(Scene & scene) {
+        runStart = std::chrono::steady_clock::now();
         scene.setDimensions(fbw, fbh);
+        scene.setOutputFramebuffer(offscreenFBO);
         scene.initScene(window);
         scene.resize(fbw, fbh);
 
@@ -98,7 +143,10 @@ public:
         // Initialize ImGui backend (if not already initialized)
         if (imguiInitialized && !imguiBackendInitialized) {
             try {
-                ImGui_ImplGlfw_InitForOpenGL(window, true);
+#ifndef SCENE_HEADLESS_ONLY
+                if (window)
+                    ImGui_ImplGlfw_InitForOpenGL(window, true);
+#endif
                 ImGui_ImplOpenGL3_Init("#version 330 core");
                 imguiBackendInitialized = true;
             } catch (const std::exception& e) {
@@ -107,7 +155,13 @@ public:
         }
 
         // Enter the main loop
-        mainLoop(window, scene);
+        if (benchmark)
+            benchmarkLoop(scene);
+        else if (headless)
+            headlessLoop(scene);
+        else
+            mainLoop(window, scene);
+        scene.finishFrames();
 
 #ifndef __APPLE__
 		if( debug )
@@ -118,7 +172,10 @@ public:
         // ImGui cleanup
         if (imguiBackendInitialized) {
             ImGui_ImplOpenGL3_Shutdown();
-            ImGui_ImplGlfw_Shutdown();
+#ifndef SCENE_HEADLESS_ONLY
+            if (window)
+                ImGui_ImplGlfw_Shutdown();
+#endif
             imguiBackendInitialized = false;
         }
         if (imguiInitialized) {
@@ -126,8 +183,15 @@ public:
             imguiInitialized = false;
         }
 
+        if (headless) {
+            shutdownHeadless();
+            return EXIT_SUCCESS;
+        }
+
+#ifndef SCENE_HEADLESS_ONLY
         // Close window and terminate GLFW
         glfwTerminate();
+#endif
 
         // Exit program
         return EXIT_SUCCESS;
@@ -159,19 +223,243 @@ private:
         }
     }
 
+    void initHeadless(int width, int height) {
+#ifdef SCENE_HEADLESS_EGL
+        // Surfaceless EGL display (Mesa), no window system required
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (eglDisplay == EGL_NO_DISPLAY)
+            eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+            std::cerr << "Unable to initialize EGL display." << std::endl;
+            exit( EXIT_FAILURE );
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        // Core 4.5 is the highest llvmpipe exposes; none of the shaders need 4.6
+        EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 5,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_CONTEXT_OPENGL_DEBUG, debug ? EGL_TRUE : EGL_FALSE,
+            EGL_NONE
+        };
+        eglContext = eglCreateContext(eglDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+        if (eglContext == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+            std::cerr << "Unable to create headless OpenGL context." << std::endl;
+            eglTerminate(eglDisplay);
+            exit( EXIT_FAILURE );
+        }
+
+        // Load the OpenGL functions.
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) { exit(-1); }
+#else
+        std::cerr << "Headless mode requires a build with EGL support." << std::endl;
+        exit( EXIT_FAILURE );
+#endif
+
+        GLUtils::dumpGLInfo();
+
+        // There is no default framebuffer, so render into our own
+        fbw = width;
+        fbh = height;
+        glGenRenderbuffers(1, &offscreenColor);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, fbw, fbh);
+        glGenRenderbuffers(1, &offscreenDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, fbw, fbh);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &offscreenFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is not complete." << std::endl;
+            exit( EXIT_FAILURE );
+        }
+
+        glClearColor(0.1f,0.1f,0.1f,1.0f);
+        if (debug) {
+            glDebugMessageCallback(GLUtils::debugCallback, nullptr);
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+        }
+    }
+
+    void shutdownHeadless() {
+        glDeleteFramebuffers(1, &offscreenFBO);
+        glDeleteRenderbuffers(1, &offscreenColor);
+        glDeleteRenderbuffers(1, &offscreenDepth);
+#ifdef SCENE_HEADLESS_EGL
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+#endif
+    }
+
+    bool writeFramebuffer(const std::string & fileName) {
+        std::vector<unsigned char> pixels(fbw * fbh * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, offscreenFBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, fbw, fbh, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        stbi_flip_vertically_on_write(1);
+        return stbi_write_png(fileName.c_str(), fbw, fbh, 4, pixels.data(), fbw * 4) != 0;
+    }
+
+    void reportFirstFrame() {
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+        std::cout << "First frame after " << ms << " ms" << std::endl;
+    }
+
+    void headlessLoop(Scene & scene) {
+        auto start = std::chrono::steady_clock::now();
+        float lastTime = 0.0f;
+
+        for (int frame = 0; frame < headlessFrames; ++frame) {
+            PROFILE_SCOPE("Frame");
+            GLUtils::checkForOpenGLError(__FILE__,__LINE__);
+
+            float t = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+            if (imguiInitialized) {
+                // No platform backend, so feed ImGui the frame size and time ourselves
+                ImGuiIO& io = ImGui::GetIO();
+                io.DisplaySize = ImVec2((float)fbw, (float)fbh);
+                io.DeltaTime = t > lastTime ? t - lastTime : 1.0f / 60.0f;
+            }
+            lastTime = t;
+
+            // The written image should not depend on how far decoding got
+            if (frame == headlessFrames - 1 && !headlessOutput.empty())
+                scene.finishLoading();
+
+            scene.update(t);
+            scene.render(nullptr);
+
+            // Stand-in for the buffer swap: wait for the frame to complete
+            PROFILE_SCOPE("glFinish");
+            glFinish();
+            if (frame == 0)
+                reportFirstFrame();
+        }
+
+        if (!headlessOutput.empty()) {
+            if (writeFramebuffer(headlessOutput))
+                std::cout << "Wrote " << headlessOutput << std::endl;
+            else
+                std::cerr << "Unable to write " << headlessOutput << std::endl;
+        }
+    }
+
+    void benchmarkLoop(Scene & scene) {
+        Camera * camera = scene.getCamera();
+        CameraPath path;
+        if (!benchmarkPath.empty()) {
+            if (!path.load(benchmarkPath))
+                exit( EXIT_FAILURE );
+        } else {
+            path = CameraPath::orbit(headlessFrames, glm::vec3(0.0f, 0.0f, 0.0f), 12.0f, 3.0f);
+        }
+
+        // Same inputs every run: fixed time step, no live input, fixed random seed
+        scene.enableInput(false);
+        srand(0);
+        scene.finishLoading();
+
+        FrameBenchmark bench;
+        int totalFrames = benchmarkWarmup + (int)path.size();
+        for (int i = 0; i < totalFrames; ++i) {
+            PROFILE_SCOPE("Frame");
+            GLUtils::checkForOpenGLError(__FILE__,__LINE__);
+
+            // Warm-up frames hold the first pose at t = 0 so shader and texture
+            // first-use costs stay out of the measured frames
+            bool timed = i >= benchmarkWarmup;
+            int frame = timed ? i - benchmarkWarmup : 0;
+
+            if (camera)
+                path.apply(*camera, frame);
+            if (imguiInitialized && !window) {
+                ImGuiIO& io = ImGui::GetIO();
+                io.DisplaySize = ImVec2((float)fbw, (float)fbh);
+                io.DeltaTime = benchmarkDt;
+            }
+
+            if (timed)
+                bench.beginFrame();
+            scene.update(frame * benchmarkDt);
+            scene.render(window);
+            if (timed)
+                bench.endFrame();
+
+#ifndef SCENE_HEADLESS_ONLY
+            if (window) {
+                {
+                    PROFILE_SCOPE("SwapBuffers");
+                    glfwSwapBuffers(window);
+                }
+                glfwPollEvents();
+                if (glfwWindowShouldClose(window))
+                    break;
+                continue;
+            }
+#endif
+            PROFILE_SCOPE("glFinish");
+            glFinish();
+        }
+        bench.finish();
+
+        bench.printSummary();
+        if (bench.writeResults(benchmarkOutput))
+            std::cout << "Wrote " << benchmarkOutput << std::endl;
+
+        // Last replayed frame, for comparing renders between builds
+        if (!headlessOutput.empty() && !window) {
+            if (writeFramebuffer(headlessOutput))
+                std::cout << "Wrote " << headlessOutput << std::endl;
+            else
+                std::cerr << "Unable to write " << headlessOutput << std::endl;
+        }
+    }
+
     void mainLoop(GLFWwindow * window, Scene & scene) {
+#ifndef SCENE_HEADLESS_ONLY
+        CameraPath recording;
+        Camera * camera = scene.getCamera();
+        bool firstFrame = true;
+
         while( ! glfwWindowShouldClose(window) && !glfwGetKey(window, GLFW_KEY_ESCAPE) ) {
+            PROFILE_SCOPE("Frame");
             GLUtils::checkForOpenGLError(__FILE__,__LINE__);
 			
             scene.update(float(glfwGetTime()));
             scene.render(window);
 
-            glfwSwapBuffers(window);
+            if (!recordPath.empty() && camera)
+                recording.record(*camera);
+
+            {
+                PROFILE_SCOPE("SwapBuffers");
+                glfwSwapBuffers(window);
+            }
+            if (firstFrame) {
+                reportFirstFrame();
+                firstFrame = false;
+            }
 
             glfwPollEvents();
 			int state = glfwGetKey(window, GLFW_KEY_SPACE);
 			if (state == GLFW_PRESS)
 				scene.animate(!scene.animating());
         }
+
+        if (!recordPath.empty() && recording.save(recordPath))
+            std::cout << "Recorded " << recording.size() << " frames to " << recordPath << std::endl;
+#endif
     }
 };
@@ -0,0 +1,66 @@
+#include "shaderbatch.h"
+
+#include "cpuprofiler.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+void ShaderBatch::add(GLSLProgram &program, std::initializer_list<const char *> files) {
+    entries.push_back({ &program, std::vector<const char *>(files) });
+}
+
+void ShaderBatch::build() {
+    PROFILE_SCOPE("ShaderBatch::build");
+    std::string errors;
+    std::vector<bool> pending(entries.size(), true);
+
+    // Submit everything first; a program that fails here (missing file,
+    // unknown extension) is reported with the rest
+    {
+        PROFILE_SCOPE("ShaderBatch::submit");
+        for (size_t i = 0; i < entries.size(); i++) {
+            try {
+                for (const char *file : entries[i].files)
+                    entries[i].program->submitShader(file);
+                entries[i].program->submitLink();
+            }
+            catch (GLSLProgramException &e) {
+                errors += std::string(e.what()) + "\n";
+                pending[i] = false;
+            }
+        }
+    }
+
+    // Finish programs in whatever order the driver completes them
+    PROFILE_SCOPE("ShaderBatch::wait");
+    size_t remaining = 0;
+    for (bool p : pending)
+        remaining += p;
+    while (remaining > 0) {
+        // With one program left there is nothing to overlap, so let
+        // finishBuild() block on it instead of polling
+        bool wait = remaining == 1;
+        bool progress = false;
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (!pending[i] || (!wait && !entries[i].program->buildComplete()))
+                continue;
+            try {
+                entries[i].program->finishBuild();
+            }
+            catch (GLSLProgramException &e) {
+                errors += std::string(e.what()) + "\n";
+            }
+            pending[i] = false;
+            remaining--;
+            progress = true;
+        }
+        // Poll again shortly, without spinning a core the compiler threads could use
+        if (!progress)
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    entries.clear();
+    if (!errors.empty())
+        throw GLSLProgramException(errors);
+}
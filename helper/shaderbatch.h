@@ -0,0 +1,35 @@
+#pragma once
+
+#include "glslprogram.h"
+
+#include <initializer_list>
+#include <vector>
+
+// Builds several programs together.
+//
+//   ShaderBatch batch;
+//   batch.add(prog, { "shader/a.vert", "shader/a.frag" });
+//   batch.add(other, { "shader/b.vert", "shader/b.frag" });
+//   batch.build();
+//
+// Every compile and link is submitted before any status is read, so a driver
+// with KHR_parallel_shader_compile can spread them over its compiler threads.
+// Programs are then checked as they complete.  Without the extension the
+// result is the same as building each program in turn.
+class ShaderBatch {
+public:
+    void add(GLSLProgram &program, std::initializer_list<const char *> files);
+
+    // Throws GLSLProgramException listing every program that failed
+    void build();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        GLSLProgram *program;
+        std::vector<const char *> files;
+    };
+
+    std::vector<Entry> entries;
+};
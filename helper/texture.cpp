@@ -1,33 +1,40 @@
 #include "texture.h"
 #include "stb_image.h"
+#include "cpuprofiler.h"
+#include "imageresampler.h"
+#include "assetarchive.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 
 Texture::Texture() : textureID(0), width(0), height(0), channels(0) {}
 
 Texture::~Texture() {
     if (textureID != 0) {
+        pending.cancel();
         glDeleteTextures(1, &textureID);
     }
 }
 
-bool fileExists(const std::string& filename) {
-    std::ifstream file(filename.c_str());
-    return file.good();
-}
-
-bool Texture::loadTexture(const std::string& filename, bool flip) {
+bool Texture::loadTexture(const std::string& filename, bool flip, bool srgb, ThreadPool* mipmapPool) {
+    PROFILE_SCOPE("Texture::loadTexture");
     try {
-        if (!fileExists(filename)) {
+        AssetArchive::View file;
+        if (!AssetArchive::load(filename, file)) {
             std::cerr << "Texture file does not exist: " << filename << std::endl;
             return false;
         }
 
         std::cout << "Loading texture: " << filename << " (flip=" << (flip ? "true" : "false") << ")" << std::endl;
+
+        if (loadCache(filename, flip, srgb))
+            return true;
         
         stbi_set_flip_vertically_on_load(flip);
         
-        unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+        unsigned char* data = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 0);
+        // TextureLoader's worker threads expect the flag off
+        stbi_set_flip_vertically_on_load(false);
         if (!data) {
             std::cerr << "Failed to load texture: " << filename << " - " << stbi_failure_reason() << std::endl;
             return false;
@@ -43,6 +50,8 @@ bool Texture::loadTexture(const std::string& filename, bool flip) {
 
         if (textureID != 0) {
             std::cout << "Deleting old texture ID: " << textureID << std::endl;
+            pending.cancel();
+            pending = TextureHandle();
             glDeleteTextures(1, &textureID);
             textureID = 0;
         }
@@ -70,17 +79,36 @@ bool Texture::loadTexture(const std::string& filename, bool flip) {
             return false;
         }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        // Immutable storage for the whole chain, in a sized format
+        std::vector<ImageResampler::Level> levels = ImageResampler::mipLevels(width, height, channels);
+        glTexStorage2D(GL_TEXTURE_2D, (GLsizei)levels.size(), TextureLoader::internalFormat(channels, srgb), width, height);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
         
         // Check OpenGL error
         GLenum err = glGetError();
         if (err != GL_NO_ERROR) {
             std::cerr << "OpenGL error when creating texture: " << err << std::endl;
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
             stbi_image_free(data);
             return false;
         }
         
-        glGenerateMipmap(GL_TEXTURE_2D);
+        std::vector<unsigned char> chain;
+        if (mipmapPool) {
+            chain.resize(levels.back().offset + levels.back().size);
+            memcpy(chain.data(), data, levels[0].size);
+            if (!ImageResampler::generateMips(mipmapPool, chain.data(), levels, channels, srgb))
+                chain.clear();
+        }
+        if (chain.empty()) {
+            glGenerateMipmap(GL_TEXTURE_2D);
+        } else {
+            for (size_t i = 1; i < levels.size(); i++)
+                glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, levels[i].width, levels[i].height, format,
+                                GL_UNSIGNED_BYTE, chain.data() + levels[i].offset);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -105,6 +133,47 @@ bool Texture::loadTexture(const std::string& filename, bool flip) {
     }
 }
 
+bool Texture::loadCache(const std::string& filename, bool flip, bool srgb) {
+    CompressedTextureFile cache;
+    if (!cache.open(CompressedTextureFile::cachePath(filename)) || !cache.matches(filename, flip))
+        return false;
+    GLenum format = srgb ? CompressedTextureFile::srgbFormat(cache.format()) : cache.format();
+    std::vector<GLenum> formats = CompressedTextureFile::supportedFormats();
+    if (std::find(formats.begin(), formats.end(), format) == formats.end())
+        return false;
+
+    if (textureID != 0) {
+        pending.cancel();
+        pending = TextureHandle();
+        glDeleteTextures(1, &textureID);
+    }
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexStorage2D(GL_TEXTURE_2D, cache.levels(), format, cache.width(), cache.height());
+    cache.upload(GL_TEXTURE_2D, format);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    width = cache.width();
+    height = cache.height();
+    channels = cache.channels();
+    std::cout << "Texture loaded from cache: " << CompressedTextureFile::cachePath(filename) << ", ID: " << textureID << std::endl;
+    return true;
+}
+
+void Texture::loadTextureAsync(TextureLoader& loader, const std::string& filename, bool flip) {
+    if (textureID != 0) {
+        pending.cancel();
+        glDeleteTextures(1, &textureID);
+    }
+    // The image size is only known once decoded
+    width = height = channels = 0;
+    pending = loader.load2D(filename, flip);
+    textureID = pending.id;
+}
+
 void Texture::bind(GLenum textureUnit) {
     try {
         if (textureID == 0) {
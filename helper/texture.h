@@ -4,12 +4,19 @@
 #include <glad/glad.h>
 #include <string>
 
+#include "textureloader.h"
+
 class Texture {
 public:
     Texture();
     ~Texture();
 
-    bool loadTexture(const std::string& filename, bool flip = true);
+    // Immutable, sized storage (sRGB if asked).  With a pool the mip levels
+    // are built on the CPU across its threads instead of by glGenerateMipmap.
+    bool loadTexture(const std::string& filename, bool flip = true, bool srgb = false, ThreadPool* mipmapPool = nullptr);
+    // Decodes on the loader's threads; binds as a placeholder until loader.update() uploads it
+    void loadTextureAsync(TextureLoader& loader, const std::string& filename, bool flip = true);
+    bool isReady() const { return textureID != 0 && (!pending.state || pending.ready()); }
     void bind(GLenum textureUnit = GL_TEXTURE0);
     void unbind();
     GLuint getID() const { return textureID; }
@@ -19,6 +26,10 @@ private:
     int width;
     int height;
     int channels;
+    TextureHandle pending;
+
+    // Uses an up-to-date .ctex cache of filename instead of decoding it
+    bool loadCache(const std::string& filename, bool flip, bool srgb);
 };
 
 #endif // TEXTURE_H 
\ No newline at end of file
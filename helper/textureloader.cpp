@@ -0,0 +1,573 @@
+#include "textureloader.h"
+
+#include "stb_image.h"
+#include "cpuprofiler.h"
+#include "imageresampler.h"
+#include "assetarchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+    const unsigned char PLACEHOLDER[4] = { 128, 128, 128, 255 };
+
+    GLenum formatFor(int channels) {
+        switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 4: return GL_RGBA;
+        default: return GL_RGB;
+        }
+    }
+
+    // Index of the 1x1 level of a full mip chain
+    int lastLevel(int width, int height) {
+        int level = 0;
+        for (int size = std::max(width, height); size > 1; size >>= 1)
+            level++;
+        return level;
+    }
+
+    void copyRows(unsigned char *dst, const unsigned char *src, int height, size_t stride, bool flip) {
+        for (int y = 0; y < height; y++)
+            memcpy(dst + y * stride, src + (flip ? height - 1 - y : y) * stride, stride);
+    }
+
+    // Rows of one face of a cube map or one layer of an array, or of a 2D texture
+    void subImage(GLenum target, size_t face, GLint level, GLint y, GLsizei width, GLsizei rows,
+                  GLenum format, const void *data) {
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glTexSubImage3D(target, level, 0, y, (GLint)face, width, rows, 1, format, GL_UNSIGNED_BYTE, data);
+        else if (target == GL_TEXTURE_CUBE_MAP)
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)face, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE, data);
+        else
+            glTexSubImage2D(target, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE, data);
+    }
+
+    void compressedSubImage(GLenum target, size_t face, GLint level, const CompressedTextureFile::Level &size,
+                            GLenum format, const void *data) {
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glCompressedTexSubImage3D(target, level, 0, 0, (GLint)face, size.width, size.height, 1, format, (GLsizei)size.size, data);
+        else if (target == GL_TEXTURE_CUBE_MAP)
+            glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)face, level, 0, 0, size.width, size.height, format, (GLsizei)size.size, data);
+        else
+            glCompressedTexSubImage2D(target, level, 0, 0, size.width, size.height, format, (GLsizei)size.size, data);
+    }
+}
+
+TextureLoader::TextureLoader(unsigned threads) :
+    ringCreated(false), pool(threads), uploadBudget(DEFAULT_UPLOAD_BUDGET), frameBytes(0), cpuMipmaps(true),
+    maxTextureSize(0), deviceMaxTextureSize(0) {}
+
+GLenum TextureLoader::internalFormat(int channels, bool srgb) {
+    switch (channels) {
+    case 1: return GL_R8;
+    case 2: return GL_RG8;
+    case 4: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    default: return srgb ? GL_SRGB8 : GL_RGB8;
+    }
+}
+
+TextureHandle TextureLoader::createPlaceholder(GLenum target, GLsizei layers) {
+    // The ring and format list must exist before the first decode is submitted
+    if (!ringCreated) {
+        ringCreated = true;
+        if (!ring.create(DEFAULT_RING_SIZE))
+            std::cout << "Pixel unpack ring unavailable; textures upload from client memory" << std::endl;
+        compressedFormats = CompressedTextureFile::supportedFormats();
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &deviceMaxTextureSize);
+    }
+
+    TextureHandle handle;
+    handle.state = std::make_shared<TextureHandle::State>(TextureHandle::LOADING);
+    glGenTextures(1, &handle.id);
+    glBindTexture(target, handle.id);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (target == GL_TEXTURE_CUBE_MAP) {
+        for (GLenum face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    } else {
+        // A single level is already mipmap complete, so the final filter works from the start
+        if (target == GL_TEXTURE_2D_ARRAY) {
+            std::vector<unsigned char> grey;
+            for (GLsizei layer = 0; layer < layers; layer++)
+                grey.insert(grey.end(), PLACEHOLDER, PLACEHOLDER + 3);
+            glTexImage3D(target, 0, GL_RGB8, 1, 1, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, grey.data());
+        } else {
+            glTexImage2D(target, 0, GL_RGB8, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, PLACEHOLDER);
+        }
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    // Mutable until begin() replaces it with immutable storage of the real size
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return handle;
+}
+
+TextureHandle TextureLoader::load2D(const std::string &fileName, bool flip, bool srgb) {
+    TextureHandle handle = createPlaceholder(GL_TEXTURE_2D);
+    Request request;
+    request.target = GL_TEXTURE_2D;
+    request.texture = handle.id;
+    request.srgb = srgb;
+    request.state = handle.state;
+    request.futures.push_back(decode(fileName, flip, srgb, cpuMipmaps));
+    requests.push_back(std::move(request));
+    return handle;
+}
+
+TextureHandle TextureLoader::load2DArray(const std::vector<std::string> &layers, bool flip, bool srgb) {
+    TextureHandle handle = createPlaceholder(GL_TEXTURE_2D_ARRAY, std::max<GLsizei>(1, (GLsizei)layers.size()));
+    Request request;
+    request.target = GL_TEXTURE_2D_ARRAY;
+    request.texture = handle.id;
+    request.srgb = srgb;
+    request.flip = flip;
+    request.mips = cpuMipmaps;
+    request.state = handle.state;
+    for (const std::string &layer : layers)
+        request.futures.push_back(decode(layer, flip, srgb, cpuMipmaps));
+    requests.push_back(std::move(request));
+    return handle;
+}
+
+TextureHandle TextureLoader::loadCubemap(const std::vector<std::string> &faces, bool srgb) {
+    TextureHandle handle = createPlaceholder(GL_TEXTURE_CUBE_MAP);
+    Request request;
+    request.target = GL_TEXTURE_CUBE_MAP;
+    request.texture = handle.id;
+    request.srgb = srgb;
+    request.state = handle.state;
+    // Cube maps are sampled from level 0 only, so they need no mips
+    for (size_t i = 0; i < faces.size() && i < 6; i++)
+        request.futures.push_back(decode(faces[i], false, srgb, false));
+    requests.push_back(std::move(request));
+    return handle;
+}
+
+std::future<TextureLoader::Image> TextureLoader::decode(const std::string &fileName, bool flip, bool srgb, bool mips,
+                                                        bool useCache) {
+    PixelUploadRing *staging = ring.valid() ? &ring : nullptr;
+    ThreadPool *mipPool = &pool;
+    std::vector<GLenum> formats = useCache ? compressedFormats : std::vector<GLenum>();
+    int maxSize = deviceMaxTextureSize;
+    if (maxTextureSize > 0)
+        maxSize = maxSize > 0 ? std::min(maxSize, maxTextureSize) : maxTextureSize;
+    return pool.submit([fileName, flip, srgb, mips, maxSize, staging, mipPool, formats]() {
+        Image image;
+        image.fileName = fileName;
+        if (!formats.empty() && readCache(image, flip, srgb, maxSize, formats, staging))
+            return image;
+        return decodeFile(fileName, flip, srgb, mips, maxSize, staging, mipPool);
+    });
+}
+
+bool TextureLoader::readCache(Image &image, bool flip, bool srgb, int maxSize, const std::vector<GLenum> &formats,
+                              PixelUploadRing *ring) {
+    std::shared_ptr<CompressedTextureFile> cache = std::make_shared<CompressedTextureFile>();
+    std::string cacheName = CompressedTextureFile::cachePath(image.fileName);
+    if (!cache->open(cacheName))
+        return false;
+    GLenum format = srgb ? CompressedTextureFile::srgbFormat(cache->format()) : cache->format();
+    if (std::find(formats.begin(), formats.end(), format) == formats.end() || !cache->matches(image.fileName, flip)) {
+        std::cout << "Texture cache " << cacheName << " is stale or unsupported, decoding " << image.fileName << std::endl;
+        return false;
+    }
+
+    PROFILE_SCOPE("TextureLoader::readCache");
+    // Levels over the size limit are skipped; the rest make a smaller chain
+    int top = 0;
+    while (maxSize > 0 && top + 1 < cache->levels() &&
+           std::max(cache->level(top).width, cache->level(top).height) > maxSize)
+        top++;
+    image.width = cache->level(top).width;
+    image.height = cache->level(top).height;
+    image.channels = cache->channels();
+    image.compressedFormat = format;
+
+    // Levels are stored back to back, so one copy stages them all
+    size_t base = cache->level(top).offset;
+    for (int i = top; i < cache->levels(); i++) {
+        CompressedTextureFile::Level level = cache->level(i);
+        level.offset -= base;
+        image.levels.push_back(level);
+    }
+    size_t bytes = image.levels.back().offset + image.levels.back().size;
+    if (ring && ring->allocate((GLsizeiptr)bytes, image.staging))
+        memcpy(image.staging.pointer, cache->data() + base, bytes);
+    else
+        image.pixels = std::shared_ptr<unsigned char>(cache, (unsigned char *)cache->data() + base);
+    return true;
+}
+
+TextureLoader::Image TextureLoader::decodeFile(const std::string &fileName, bool flip, bool srgb, bool mips, int maxSize,
+                                              PixelUploadRing *ring, ThreadPool *mipPool) {
+    PROFILE_SCOPE("TextureLoader::decode");
+    Image image;
+    image.fileName = fileName;
+
+    // stbi_set_flip_vertically_on_load is global state shared with other
+    // threads, so the rows are flipped here instead
+    AssetArchive::View file;
+    if (!AssetArchive::load(fileName, file)) {
+        image.error = "can't open";
+        return image;
+    }
+    unsigned char *data = stbi_load_from_memory(file.data, (int)file.size, &image.width, &image.height, &image.channels, 0);
+    if (!data) {
+        const char *reason = stbi_failure_reason();
+        image.error = reason ? reason : "unknown error";
+        return image;
+    }
+    image.pixels.reset(data, stbi_image_free);
+
+    if (maxSize > 0 && std::max(image.width, image.height) > maxSize) {
+        // Keep the aspect ratio; Catmull-Rom keeps more detail than a box
+        // for the uneven ratios this usually needs
+        PROFILE_SCOPE("TextureLoader::downscale");
+        float scale = (float)maxSize / std::max(image.width, image.height);
+        int width = std::max(1, std::min(maxSize, (int)(image.width * scale + 0.5f)));
+        int height = std::max(1, std::min(maxSize, (int)(image.height * scale + 0.5f)));
+        std::shared_ptr<unsigned char> scaled(new unsigned char[(size_t)width * height * image.channels],
+                                              std::default_delete<unsigned char[]>());
+        if (!ImageResampler::resize(mipPool, data, image.width, image.height, scaled.get(), width, height,
+                                    image.channels, srgb, ImageResampler::FILTER_CATMULL_ROM)) {
+            image.error = "downscaling failed";
+            return image;
+        }
+        std::cout << "Texture " << fileName << " scaled from " << image.width << "x" << image.height
+                  << " to " << width << "x" << height << std::endl;
+        image.width = width;
+        image.height = height;
+        image.pixels = scaled;
+        data = scaled.get();
+    }
+
+    size_t stride = image.stride();
+    if (mips) {
+        // The whole chain in one block, level 0 first; the bands of each
+        // level are shared with idle workers through the pool
+        std::vector<ImageResampler::Level> chain = ImageResampler::mipLevels(image.width, image.height, image.channels);
+        size_t bytes = chain.back().offset + chain.back().size;
+        std::shared_ptr<unsigned char> levels(new unsigned char[bytes], std::default_delete<unsigned char[]>());
+        copyRows(levels.get(), data, image.height, stride, flip);
+        image.pixels = levels;
+        if (!ImageResampler::generateMips(mipPool, levels.get(), chain, image.channels, srgb)) {
+            image.error = "mipmap generation failed";
+            return image;
+        }
+        for (const ImageResampler::Level &level : chain)
+            image.levels.push_back({ level.width, level.height, level.offset, level.size });
+
+        if (ring && ring->allocate((GLsizeiptr)bytes, image.staging)) {
+            PROFILE_SCOPE("TextureLoader::stage");
+            memcpy(image.staging.pointer, levels.get(), bytes);
+            image.pixels.reset();
+        }
+        return image;
+    }
+
+    GLsizeiptr bytes = (GLsizeiptr)(stride * image.height);
+    if (ring && ring->allocate(bytes, image.staging)) {
+        // Straight into the mapped buffer; the decoded copy is no longer needed
+        PROFILE_SCOPE("TextureLoader::stage");
+        copyRows(image.staging.pointer, data, image.height, stride, flip);
+        image.pixels.reset();
+    } else if (flip) {
+        std::vector<unsigned char> row(stride);
+        for (int y = 0; y < image.height / 2; y++) {
+            unsigned char *top = data + y * stride;
+            unsigned char *bottom = data + (image.height - 1 - y) * stride;
+            memcpy(row.data(), top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row.data(), stride);
+        }
+    }
+    return image;
+}
+
+bool TextureLoader::decoded(Request &request) {
+    if (request.futures.empty())
+        return true;
+    for (std::future<Image> &image : request.futures) {
+        if (image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+    }
+    for (std::future<Image> &image : request.futures)
+        request.images.push_back(image.get());
+    request.futures.clear();
+
+    // Cube map faces and array layers have to match; if only some came from
+    // the cache, decode them all.  Failures are reported by begin().
+    for (const Image &image : request.images) {
+        const Image &first = request.images[0];
+        if (!image.error.empty() || !first.error.empty())
+            continue;
+        if (image.compressedFormat != first.compressedFormat || image.levels.size() != first.levels.size()) {
+            std::cout << "Texture faces or layers are not all cached, decoding " << first.fileName << " and the rest" << std::endl;
+            discard(request);
+            std::vector<Image> images;
+            images.swap(request.images);
+            for (const Image &face : images)
+                request.futures.push_back(decode(face.fileName, request.flip, request.srgb, request.mips, false));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TextureLoader::begin(Request &request) {
+    bool ok = *request.state != TextureHandle::CANCELLED;
+    for (const Image &image : request.images) {
+        if (!image.error.empty()) {
+            std::cerr << "Failed to load texture: " << image.fileName << " - " << image.error << std::endl;
+            ok = false;
+        }
+    }
+    if (!ok) {
+        // The placeholder stays bound in its place
+        if (*request.state == TextureHandle::LOADING)
+            *request.state = TextureHandle::FAILED;
+        discard(request);
+        return false;
+    }
+
+    // Immutable storage needs one size and format for every face
+    const Image &first = request.images[0];
+    for (const Image &image : request.images) {
+        if (image.width != first.width || image.height != first.height || image.channels != first.channels) {
+            std::cerr << "Failed to load texture: " << image.fileName << " - size or channels differ from "
+                      << first.fileName << std::endl;
+            *request.state = TextureHandle::FAILED;
+            discard(request);
+            return false;
+        }
+    }
+
+    // Allocate every level now, replacing the mutable placeholder, and keep
+    // sampling a grey or real 1x1 last level until every row or level below
+    // it has arrived, so a half-uploaded image is never visible
+    PROFILE_SCOPE("TextureLoader::begin");
+    glBindTexture(request.target, request.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int last = first.compressedFormat ? (int)first.levels.size() - 1 : lastLevel(first.width, first.height);
+    GLenum storage = first.compressedFormat ? first.compressedFormat : internalFormat(first.channels, request.srgb);
+    if (request.target == GL_TEXTURE_2D_ARRAY)
+        glTexStorage3D(request.target, last + 1, storage, first.width, first.height, (GLsizei)request.images.size());
+    else
+        glTexStorage2D(request.target, last + 1, storage, first.width, first.height);
+    for (size_t i = 0; i < request.images.size(); i++) {
+        Image &image = request.images[i];
+        if (image.compressedFormat) {
+            // The smallest precomputed level; the rest follow largest last
+            const CompressedTextureFile::Level &level = image.levels[last];
+            PixelUploadRing::Allocation band;
+            const void *data = source(image, level.offset, (GLsizeiptr)level.size, band);
+            compressedSubImage(request.target, i, last, level, image.compressedFormat, data);
+            if (band.size > 0)
+                ring.release(band);
+        } else if (last > 0) {
+            subImage(request.target, i, last, 0, 1, 1, formatFor(image.channels), PLACEHOLDER);
+        }
+    }
+    glTexParameteri(request.target, GL_TEXTURE_BASE_LEVEL, last);
+    glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, last);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (first.compressedFormat) {
+        // Cube maps are sampled without mipmaps, so only level 0 is still needed
+        request.level = request.target == GL_TEXTURE_CUBE_MAP ? 0 : last - 1;
+        if (last == 0)
+            request.face = request.images.size();
+    }
+    request.started = true;
+    return true;
+}
+
+const void * TextureLoader::source(Image &image, size_t offset, GLsizeiptr bytes, PixelUploadRing::Allocation &band) {
+    if (image.staging.size > 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.getHandle());
+        return (const void *)(image.staging.offset + offset);
+    }
+    if (ring.allocate(bytes, band)) {
+        memcpy(band.pointer, image.pixels.get() + offset, bytes);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.getHandle());
+        return (const void *)band.offset;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return image.pixels.get() + offset;
+}
+
+GLsizeiptr TextureLoader::upload(Request &request, GLsizeiptr budget) {
+    PROFILE_SCOPE("TextureLoader::upload");
+    glBindTexture(request.target, request.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GLsizeiptr spent = request.images[0].compressedFormat ? uploadLevels(request, budget) : uploadRows(request, budget);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return spent;
+}
+
+GLsizeiptr TextureLoader::uploadRows(Request &request, GLsizeiptr budget) {
+    // Level 0 in bands of rows, then any precomputed mips, largest first
+    GLsizeiptr spent = 0;
+    while (request.face < request.images.size() && spent < budget) {
+        Image &image = request.images[request.face];
+        int levels = std::max<int>(1, (int)image.levels.size());
+        int width = image.levels.empty() ? image.width : image.levels[request.level].width;
+        int height = image.levels.empty() ? image.height : image.levels[request.level].height;
+        size_t base = image.levels.empty() ? 0 : image.levels[request.level].offset;
+        GLsizeiptr stride = (GLsizeiptr)width * image.channels;
+        // At least one row, so a tiny budget still makes progress
+        int rows = (int)std::min<GLsizeiptr>(height - request.row, std::max<GLsizeiptr>(1, (budget - spent) / stride));
+        GLsizeiptr bytes = rows * stride;
+
+        PixelUploadRing::Allocation band;
+        const void *data = source(image, base + (size_t)(request.row * stride), bytes, band);
+        subImage(request.target, request.face, request.level, request.row, width, rows, formatFor(image.channels), data);
+        if (band.size > 0)
+            ring.release(band);
+
+        spent += bytes;
+        request.row += rows;
+        if (request.row < height)
+            continue;
+        request.row = 0;
+        if (++request.level < levels)
+            continue;
+        if (image.staging.size > 0)
+            ring.release(image.staging);
+        image.staging = PixelUploadRing::Allocation();
+        image.pixels.reset();
+        request.face++;
+        request.level = 0;
+    }
+    return spent;
+}
+
+GLsizeiptr TextureLoader::uploadLevels(Request &request, GLsizeiptr budget) {
+    // Whole levels, one face at a time; a level is never split
+    GLsizeiptr spent = 0;
+    while (request.face < request.images.size() && spent < budget) {
+        Image &image = request.images[request.face];
+        const CompressedTextureFile::Level &level = image.levels[request.level];
+
+        PixelUploadRing::Allocation band;
+        const void *data = source(image, level.offset, (GLsizeiptr)level.size, band);
+        compressedSubImage(request.target, request.face, request.level, level, image.compressedFormat, data);
+        if (band.size > 0)
+            ring.release(band);
+        spent += (GLsizeiptr)level.size;
+
+        if (++request.face < request.images.size())
+            continue;
+
+        // Every face has this level now, so sampling can start from it
+        glTexParameteri(request.target, GL_TEXTURE_BASE_LEVEL, request.level);
+        if (request.target == GL_TEXTURE_CUBE_MAP)
+            glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, request.level);
+        if (request.level == 0)
+            break;
+        request.level = request.target == GL_TEXTURE_CUBE_MAP ? 0 : request.level - 1;
+        request.face = 0;
+    }
+    return spent;
+}
+
+void TextureLoader::complete(Request &request) {
+    PROFILE_SCOPE("TextureLoader::complete");
+    const Image &image = request.images[0];
+    glBindTexture(request.target, request.texture);
+    if (!image.compressedFormat) {
+        glTexParameteri(request.target, GL_TEXTURE_BASE_LEVEL, 0);
+        if (request.target != GL_TEXTURE_CUBE_MAP) {
+            glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, 1000);
+            if (image.levels.empty())
+                glGenerateMipmap(request.target);
+        } else {
+            glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+    }
+
+    *request.state = TextureHandle::READY;
+    std::cout << "Loaded texture: " << image.fileName;
+    if (request.images.size() > 1)
+        std::cout << " (+" << request.images.size() - 1 << (request.target == GL_TEXTURE_CUBE_MAP ? " faces)" : " layers)");
+    std::cout << ", " << image.width << "x" << image.height;
+    if (image.compressedFormat)
+        std::cout << " from " << CompressedTextureFile::cachePath(image.fileName);
+    std::cout << std::endl;
+    discard(request);
+}
+
+void TextureLoader::discard(Request &request) {
+    for (Image &image : request.images) {
+        if (image.staging.size > 0)
+            ring.release(image.staging);
+        image.staging = PixelUploadRing::Allocation();
+        image.pixels.reset();
+    }
+}
+
+int TextureLoader::update() {
+    PROFILE_SCOPE("TextureLoader::update");
+    int completed = 0;
+    GLsizeiptr spent = 0;
+    for (size_t i = 0; i < requests.size() && spent < uploadBudget; ) {
+        Request &request = requests[i];
+        if (!decoded(request)) {
+            i++;
+            continue;
+        }
+        if (*request.state == TextureHandle::CANCELLED || (!request.started && !begin(request))) {
+            discard(request);
+            requests.erase(requests.begin() + i);
+            continue;
+        }
+
+        spent += upload(request, uploadBudget - spent);
+        if (request.face == request.images.size()) {
+            complete(request);
+            requests.erase(requests.begin() + i);
+            completed++;
+        } else {
+            i++;
+        }
+    }
+    frameBytes = spent;
+    ring.endFrame();
+    return completed;
+}
+
+void TextureLoader::finish() {
+    PROFILE_SCOPE("TextureLoader::finish");
+    for (Request &request : requests) {
+        do {
+            for (std::future<Image> &image : request.futures)
+                image.wait();
+        } while (!decoded(request));
+        if (*request.state == TextureHandle::CANCELLED || (!request.started && !begin(request))) {
+            discard(request);
+            continue;
+        }
+        upload(request, std::numeric_limits<GLsizeiptr>::max());
+        complete(request);
+    }
+    requests.clear();
+    ring.endFrame();
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "threadpool.h"
+#include "pixeluploadring.h"
+#include "compressedtexture.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A texture that may still be decoding.  The GL name is valid immediately and
+// samples a 1x1 grey placeholder until TextureLoader::update() has uploaded
+// the real image into the same name, so it can be bound straight away.
+struct TextureHandle {
+    enum State { LOADING, READY, FAILED, CANCELLED };
+
+    GLuint id = 0;
+    std::shared_ptr<State> state;
+
+    bool ready() const { return state && *state == READY; }
+    bool failed() const { return state && *state == FAILED; }
+
+    // Call before deleting the texture if it may still be loading, so the
+    // loader does not upload into a name that has been freed or reused
+    void cancel() { if (state && *state == LOADING) *state = CANCELLED; }
+};
+
+// Decodes image files on a thread pool while the GL thread only uploads.
+//
+//   TextureLoader loader;
+//   GLuint wood = loader.load2D("media/textures/wood.png").id;
+//   ...
+//   loader.update();   // once per frame, on the GL thread
+//
+// Workers copy decoded pixels straight into a persistently mapped
+// PixelUploadRing, and update() streams them into the textures in bands of
+// rows, at most uploadBudget bytes per frame, so a large image is spread over
+// several frames instead of stalling one.  Images that do not fit in the
+// ring, or drivers without buffer storage, upload from client memory under
+// the same budget.
+//
+// Textures get immutable storage (glTexStorage2D) in a sized format, sRGB
+// when asked for.  The full mip chain of a 2D texture is box filtered on the
+// workers as part of the decode, unless CPU mipmaps are turned off, in which
+// case glGenerateMipmap builds it once the texture is complete.  Images
+// larger than the maximum texture size are scaled down on the workers with
+// a Catmull-Rom filter before their mips are built.
+//
+// When an image has an up-to-date .ctex cache next to it (see texconvert)
+// and the driver supports its format, the worker maps that instead of
+// decoding, and its precomputed mip levels are uploaded smallest first,
+// each one sharpening the texture until the full level 0 arrives.  The
+// created textures belong to the caller.
+class TextureLoader {
+public:
+    static const GLsizeiptr DEFAULT_RING_SIZE = 32 << 20;
+    static const GLsizeiptr DEFAULT_UPLOAD_BUDGET = 4 << 20;
+
+    explicit TextureLoader(unsigned threads = 0);
+
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader & operator=(const TextureLoader &) = delete;
+
+    // Mipmapped, repeating 2D texture.  srgb stores colour data in an sRGB
+    // format, so sampling returns linear values.
+    TextureHandle load2D(const std::string &fileName, bool flip = false, bool srgb = false);
+
+    // Cube map from six faces in +X, -X, +Y, -Y, +Z, -Z order and of one
+    // size, each decoded as a separate job; shown once every face has been uploaded
+    TextureHandle loadCubemap(const std::vector<std::string> &faces, bool srgb = false);
+
+    // Mipmapped, repeating 2D array texture with one layer per file, all of
+    // one size; shown once every layer has been uploaded
+    TextureHandle load2DArray(const std::vector<std::string> &layers, bool flip = false, bool srgb = false);
+
+    // Streams decoded pixels into their textures, up to the upload budget,
+    // and returns how many textures became ready
+    int update();
+
+    // Waits for every outstanding decode and uploads it, ignoring the budget
+    void finish();
+
+    // Bytes of pixel data uploaded per update(); takes effect on the next update
+    void setUploadBudget(GLsizeiptr bytesPerFrame) { uploadBudget = bytesPerFrame > 0 ? bytesPerFrame : 1; }
+    GLsizeiptr getUploadBudget() const { return uploadBudget; }
+
+    // Build 2D mip chains on the workers (the default) rather than with
+    // glGenerateMipmap on the GL thread; applies to later loads
+    void setCpuMipmaps(bool enabled) { cpuMipmaps = enabled; }
+    bool getCpuMipmaps() const { return cpuMipmaps; }
+
+    // Largest width or height to upload, 0 for the driver's limit; larger
+    // images are downscaled and cached ones start at a smaller level.
+    // Applies to later loads.
+    void setMaxTextureSize(int size) { maxTextureSize = size > 0 ? size : 0; }
+    int getMaxTextureSize() const { return maxTextureSize; }
+
+    // Sized internal format for 8-bit images with this many channels
+    static GLenum internalFormat(int channels, bool srgb);
+
+    size_t pending() const { return requests.size(); }
+    GLsizeiptr lastFrameBytes() const { return frameBytes; }
+    const PixelUploadRing & uploadRing() const { return ring; }
+
+private:
+    struct Image {
+        std::string fileName;
+        int width = 0, height = 0, channels = 0;
+        std::shared_ptr<unsigned char> pixels;   // decoded rows, or the levels of a mapped cache file
+        PixelUploadRing::Allocation staging;     // used instead of pixels when staging.size > 0
+        std::string error;
+
+        GLenum compressedFormat = 0;             // set when read from a .ctex cache
+        std::vector<CompressedTextureFile::Level> levels;   // precomputed mips, offsets from pixels or staging
+
+        size_t stride() const { return (size_t)width * channels; }
+    };
+
+    struct Request {
+        GLenum target;
+        GLuint texture;
+        bool srgb = false;
+        bool flip = false;                       // decode settings, kept for a re-decode
+        bool mips = false;
+        std::vector<std::future<Image>> futures;
+        std::vector<Image> images;               // filled once every future is ready
+        std::shared_ptr<TextureHandle::State> state;
+        bool started = false;                    // full-size storage allocated
+        size_t face = 0;                         // next face, mip level and row to upload
+        int row = 0;
+        int level = 0;
+    };
+
+    // Declared before the pool so workers are joined before the ring is unmapped
+    PixelUploadRing ring;
+    bool ringCreated;
+    ThreadPool pool;
+    std::vector<GLenum> compressedFormats;    // usable cache formats, queried on the GL thread
+    std::vector<Request> requests;
+    GLsizeiptr uploadBudget;
+    GLsizeiptr frameBytes;
+    bool cpuMipmaps;
+    int maxTextureSize;
+    GLint deviceMaxTextureSize;               // GL_MAX_TEXTURE_SIZE
+
+    TextureHandle createPlaceholder(GLenum target, GLsizei layers = 1);
+    std::future<Image> decode(const std::string &fileName, bool flip, bool srgb, bool mips, bool useCache = true);
+    bool decoded(Request &request);
+    bool begin(Request &request);
+    const void * source(Image &image, size_t offset, GLsizeiptr bytes, PixelUploadRing::Allocation &band);
+    GLsizeiptr upload(Request &request, GLsizeiptr budget);
+    GLsizeiptr uploadRows(Request &request, GLsizeiptr budget);
+    GLsizeiptr uploadLevels(Request &request, GLsizeiptr budget);
+    void complete(Request &request);
+    void discard(Request &request);
+
+    static Image decodeFile(const std::string &fileName, bool flip, bool srgb, bool mips, int maxSize,
+                            PixelUploadRing *ring, ThreadPool *mipPool);
+    static bool readCache(Image &image, bool flip, bool srgb, int maxSize, const std::vector<GLenum> &formats,
+                          PixelUploadRing *ring);
+};
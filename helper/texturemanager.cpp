@@ -0,0 +1,340 @@
+#include "texturemanager.h"
+
+#include "cpuprofiler.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+    size_t texelBytes(GLint internalFormat) {
+        switch (internalFormat) {
+        case GL_R8: return 1;
+        case GL_RG8: return 2;
+        default: return 4;      // RGB8 and SRGB8 are padded to four bytes by most drivers
+        }
+    }
+
+    std::string displayName(const std::string &fileName) {
+        size_t slash = fileName.find_last_of("/\\");
+        return slash == std::string::npos ? fileName : fileName.substr(slash + 1);
+    }
+
+    // Faces of a cube map or layers of an array, each the size of a level
+    int layerCount(GLenum target, size_t files) {
+        return target == GL_TEXTURE_CUBE_MAP ? 6 : target == GL_TEXTURE_2D_ARRAY ? (int)files : 1;
+    }
+
+    void deleteTexture(TextureHandle &texture) {
+        texture.cancel();
+        if (texture.id != 0)
+            glDeleteTextures(1, &texture.id);
+        texture = TextureHandle();
+    }
+}
+
+TextureManager::TextureManager(TextureLoader &loader) : loader(loader), budget(DEFAULT_BUDGET), frame(0) {}
+
+TextureManager::~TextureManager() {
+    for (Entry &entry : entries) {
+        deleteTexture(entry.texture);
+        deleteTexture(entry.reload);
+    }
+}
+
+TextureManager::Handle TextureManager::acquire2D(const std::string &fileName, bool flip, bool srgb) {
+    std::string key = fileName + (flip ? "|flip" : "") + (srgb ? "|srgb" : "");
+    return acquire(key, GL_TEXTURE_2D, { fileName }, flip, srgb);
+}
+
+TextureManager::Handle TextureManager::acquireCubemap(const std::vector<std::string> &faces, bool srgb) {
+    std::string key;
+    for (const std::string &face : faces)
+        key += face + "|";
+    key += srgb ? "cube|srgb" : "cube";
+    return acquire(key, GL_TEXTURE_CUBE_MAP, faces, false, srgb);
+}
+
+TextureManager::Handle TextureManager::acquire2DArray(const std::vector<std::string> &layers, bool flip, bool srgb) {
+    std::string key;
+    for (const std::string &layer : layers)
+        key += layer + "|";
+    key += std::string("array") + (flip ? "|flip" : "") + (srgb ? "|srgb" : "");
+    return acquire(key, GL_TEXTURE_2D_ARRAY, layers, flip, srgb);
+}
+
+TextureManager::Handle TextureManager::acquire(const std::string &key, GLenum target,
+                                               const std::vector<std::string> &files, bool flip, bool srgb) {
+    Handle handle;
+    auto found = lookup.find(key);
+    if (found != lookup.end()) {
+        entries[found->second].refs++;
+        handle.index = found->second;
+        return handle;
+    }
+
+    // Reuse a released slot if there is one
+    for (size_t i = 0; i < entries.size() && !handle.valid(); i++) {
+        if (entries[i].refs == 0)
+            handle.index = (int)i;
+    }
+    if (!handle.valid()) {
+        handle.index = (int)entries.size();
+        entries.emplace_back();
+    }
+
+    Entry &entry = entries[handle.index];
+    entry = Entry();
+    entry.key = key;
+    entry.files = files;
+    entry.target = target;
+    entry.flip = flip;
+    entry.srgb = srgb;
+    entry.refs = 1;
+    entry.lastUsed = frame;   // a frame's grace before it counts as unused
+    entry.texture = load(entry);
+    lookup[key] = handle.index;
+    return handle;
+}
+
+void TextureManager::release(Handle &handle) {
+    if (!handle.valid())
+        return;
+    Entry &entry = entries[handle.index];
+    handle.index = -1;
+    if (--entry.refs > 0)
+        return;
+
+    current.bytes -= entry.bytes;
+    deleteTexture(entry.texture);
+    deleteTexture(entry.reload);
+    lookup.erase(entry.key);
+    entry = Entry();
+}
+
+TextureHandle TextureManager::load(const Entry &entry) {
+    if (entry.target == GL_TEXTURE_CUBE_MAP)
+        return loader.loadCubemap(entry.files, entry.srgb);
+    if (entry.target == GL_TEXTURE_2D_ARRAY)
+        return loader.load2DArray(entry.files, entry.flip, entry.srgb);
+    return loader.load2D(entry.files[0], entry.flip, entry.srgb);
+}
+
+void TextureManager::bind(Handle handle, GLuint unit) {
+    if (!handle.valid())
+        return;
+    Entry &entry = entries[handle.index];
+    entry.lastUsed = frame;
+
+    if (entry.texture.id == 0) {
+        // Evicted; the placeholder stands in until it has loaded again
+        entry.texture = load(entry);
+        entry.droppedLevels = 0;
+        current.reloads++;
+    } else if (entry.droppedLevels > 0 && entry.reload.id == 0 && !entry.restoreFailed &&
+               current.bytes - entry.bytes + entry.fullBytes <= budget) {
+        // Trimmed and there is room again; keep the smaller one until the reload is ready
+        entry.reload = load(entry);
+        current.reloads++;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(entry.target, entry.texture.id);
+}
+
+GLuint TextureManager::id(Handle handle) const {
+    return handle.valid() ? entries[handle.index].texture.id : 0;
+}
+
+void TextureManager::measure(Entry &entry) {
+    GLenum face = entry.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : entry.target;
+    size_t faces = (size_t)layerCount(entry.target, entry.files.size());
+
+    // Immutable storage holds every level whether or not it is sampled;
+    // a failed load keeps its mutable 1x1 placeholder
+    glBindTexture(entry.target, entry.texture.id);
+    GLint levels = 0;
+    glGetTexParameteriv(entry.target, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    levels = std::max(1, levels);
+
+    size_t bytes = 0;
+    for (GLint level = 0; level < levels; level++) {
+        GLint width = 0, height = 0, compressed = 0, format = 0;
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(face, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(face, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            // The size of an array level already covers every layer
+            bytes += (size_t)size * (entry.target == GL_TEXTURE_2D_ARRAY ? 1 : faces);
+        } else {
+            glGetTexLevelParameteriv(face, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            bytes += (size_t)width * height * texelBytes(format) * faces;
+        }
+        if (level == 0) {
+            entry.width = width;
+            entry.height = height;
+        }
+    }
+
+    current.bytes = current.bytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+    entry.levels = levels;
+    if (entry.droppedLevels == 0)
+        entry.fullBytes = bytes;
+    entry.measured = true;
+}
+
+void TextureManager::evict(Entry &entry) {
+    current.bytes -= entry.bytes;
+    deleteTexture(entry.texture);
+    entry.bytes = 0;
+    entry.measured = false;
+    current.evictions++;
+}
+
+bool TextureManager::trim(Entry &entry) {
+    if (entry.levels < 2 || std::max(entry.width, entry.height) / 2 < MIN_TRIM_SIZE)
+        return false;
+
+    // Only textures that sample their mips have anything in them to keep
+    GLuint old = entry.texture.id;
+    glBindTexture(entry.target, old);
+    GLint maxLevel = 0, minFilter = 0, magFilter = 0, wrapS = 0, wrapT = 0, wrapR = 0, format = 0;
+    glGetTexParameteriv(entry.target, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    if (maxLevel < 1)
+        return false;
+    glGetTexParameteriv(entry.target, GL_TEXTURE_MIN_FILTER, &minFilter);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_MAG_FILTER, &magFilter);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_S, &wrapS);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_T, &wrapT);
+    glGetTexParameteriv(entry.target, GL_TEXTURE_WRAP_R, &wrapR);
+    GLenum face = entry.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : entry.target;
+    glGetTexLevelParameteriv(face, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+    // New storage one level shorter, filled on the GPU from levels 1 .. n
+    PROFILE_SCOPE("TextureManager::trim");
+    TextureHandle smaller;
+    smaller.state = std::make_shared<TextureHandle::State>(TextureHandle::READY);
+    glGenTextures(1, &smaller.id);
+    glBindTexture(entry.target, smaller.id);
+    int layers = layerCount(entry.target, entry.files.size());
+    if (entry.target == GL_TEXTURE_2D_ARRAY)
+        glTexStorage3D(entry.target, entry.levels - 1, (GLenum)format,
+                       std::max(1, entry.width / 2), std::max(1, entry.height / 2), layers);
+    else
+        glTexStorage2D(entry.target, entry.levels - 1, (GLenum)format,
+                       std::max(1, entry.width / 2), std::max(1, entry.height / 2));
+    for (int level = 1; level < entry.levels; level++) {
+        GLint width = 0, height = 0;
+        glGetTexLevelParameteriv(face, level - 1, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(face, level - 1, GL_TEXTURE_HEIGHT, &height);
+        glCopyImageSubData(old, entry.target, level, 0, 0, 0, smaller.id, entry.target, level - 1, 0, 0, 0,
+                           width, height, layers);
+    }
+    glTexParameteri(entry.target, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(entry.target, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_S, wrapS);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_T, wrapT);
+    glTexParameteri(entry.target, GL_TEXTURE_WRAP_R, wrapR);
+    glTexParameteri(entry.target, GL_TEXTURE_MAX_LEVEL, maxLevel - 1);
+
+    glDeleteTextures(1, &old);
+    entry.texture = smaller;
+    entry.droppedLevels++;
+    measure(entry);
+    current.trims++;
+    return true;
+}
+
+void TextureManager::update() {
+    PROFILE_SCOPE("TextureManager::update");
+    frame++;
+
+    current.textures = current.resident = 0;
+    for (Entry &entry : entries) {
+        if (entry.refs == 0)
+            continue;
+
+        if (entry.reload.id != 0 && *entry.reload.state != TextureHandle::LOADING) {
+            if (entry.reload.ready()) {
+                deleteTexture(entry.texture);
+                entry.texture = entry.reload;
+                entry.droppedLevels = 0;
+                entry.measured = false;
+            } else {
+                deleteTexture(entry.reload);
+                entry.restoreFailed = true;
+            }
+            entry.reload = TextureHandle();
+        }
+        if (!entry.measured && entry.texture.id != 0 && *entry.texture.state != TextureHandle::LOADING)
+            measure(entry);
+
+        current.textures++;
+        if (entry.texture.id != 0)
+            current.resident++;
+    }
+    enforceBudget();
+}
+
+void TextureManager::enforceBudget() {
+    while (current.bytes > budget) {
+        // Textures still loading or being restored are left alone
+        std::vector<Entry *> candidates;
+        for (Entry &entry : entries) {
+            if (entry.refs > 0 && entry.measured && entry.texture.id != 0 && entry.reload.id == 0)
+                candidates.push_back(&entry);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b) {
+            return a->lastUsed != b->lastUsed ? a->lastUsed < b->lastUsed : a->bytes > b->bytes;
+        });
+
+        // Not bound last frame: evict outright
+        if (!candidates.empty() && candidates[0]->lastUsed + 1 < frame) {
+            std::cout << "Evicting texture " << candidates[0]->files[0] << std::endl;
+            evict(*candidates[0]);
+            current.resident--;
+            continue;
+        }
+
+        // Everything left is in use: give up detail, least recently used first
+        bool trimmed = false;
+        for (size_t i = 0; i < candidates.size() && !trimmed; i++)
+            trimmed = trim(*candidates[i]);
+        if (!trimmed)
+            break;
+    }
+}
+
+void TextureManager::drawUI() const {
+    double mb = 1.0 / (1024.0 * 1024.0);
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.1f / %.0f MB", current.bytes * mb, budget * mb);
+    ImGui::Text("Textures: %d of %d resident", current.resident, current.textures);
+    ImGui::ProgressBar(budget > 0 ? (float)current.bytes / budget : 1.0f, ImVec2(280.0f, 0.0f), overlay);
+    if (current.evictions > 0 || current.trims > 0)
+        ImGui::Text("Evicted %llu, trimmed %llu, reloaded %llu", (unsigned long long)current.evictions,
+                    (unsigned long long)current.trims, (unsigned long long)current.reloads);
+
+    if (ImGui::TreeNode("Texture residency")) {
+        for (const Entry &entry : entries) {
+            if (entry.refs == 0)
+                continue;
+            std::string name = displayName(entry.files[0]) + (entry.target == GL_TEXTURE_CUBE_MAP ? " (cube)"
+                             : entry.target == GL_TEXTURE_2D_ARRAY ? " (array)" : "");
+            const char *state = entry.texture.id == 0 ? "evicted"
+                              : entry.texture.failed() ? "failed"
+                              : !entry.measured ? "loading"
+                              : entry.reload.id != 0 ? "restoring"
+                              : "";
+            ImGui::Text("%-16s %4dx%-4d %7.2f MB  refs %d  idle %llu%s  %s", name.c_str(), entry.width, entry.height,
+                        entry.bytes * mb, entry.refs, (unsigned long long)(frame - entry.lastUsed),
+                        entry.droppedLevels > 0 ? "  trimmed" : "", state);
+        }
+        ImGui::TreePop();
+    }
+}
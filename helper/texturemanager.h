@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "textureloader.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Shared, reference-counted textures kept under a VRAM budget.
+//
+//   TextureManager textures(loader);
+//   TextureManager::Handle wood = textures.acquire2D("media/textures/wood.png");
+//   ...
+//   textures.update();        // once per frame, after TextureLoader::update()
+//   textures.bind(wood, 0);   // marks it used this frame
+//   ...
+//   textures.release(wood);
+//
+// Acquiring a file that is already loaded with the same flags shares its
+// texture and adds a reference; the GL texture is deleted with the last
+// reference.  Each texture's VRAM is estimated from its storage once it has
+// loaded.  While the total is over budget, update() evicts the least
+// recently bound textures that were not bound last frame, then drops the
+// top mip level of the least recently bound of the rest, down to
+// MIN_TRIM_SIZE.  An evicted texture is loaded again when next bound and
+// samples the loader's placeholder until then; a trimmed one is reloaded at
+// full size once it fits in the budget again.
+//
+// Textures are only reached through their handles, since trimming and
+// reloading replace the GL name.
+class TextureManager {
+public:
+    static const size_t DEFAULT_BUDGET = (size_t)256 << 20;
+    static const int MIN_TRIM_SIZE = 256;   // textures are not trimmed below this width or height
+
+    struct Handle {
+        int index = -1;
+        bool valid() const { return index >= 0; }
+    };
+
+    struct Stats {
+        size_t bytes = 0;          // estimated VRAM of every resident texture
+        int textures = 0;          // acquired, resident or not
+        int resident = 0;
+        uint64_t evictions = 0;    // since startup
+        uint64_t trims = 0;
+        uint64_t reloads = 0;
+    };
+
+    explicit TextureManager(TextureLoader &loader);
+    ~TextureManager();
+
+    TextureManager(const TextureManager &) = delete;
+    TextureManager & operator=(const TextureManager &) = delete;
+
+    // As TextureLoader::load2D, loadCubemap and load2DArray, shared by file
+    // names and flags
+    Handle acquire2D(const std::string &fileName, bool flip = false, bool srgb = false);
+    Handle acquireCubemap(const std::vector<std::string> &faces, bool srgb = false);
+    Handle acquire2DArray(const std::vector<std::string> &layers, bool flip = false, bool srgb = false);
+    void release(Handle &handle);
+
+    // Binds the texture to a texture unit and marks it used this frame; an
+    // evicted texture starts loading again
+    void bind(Handle handle, GLuint unit);
+
+    // Current GL name, 0 while evicted; may change after update()
+    GLuint id(Handle handle) const;
+
+    // Measures new textures, swaps in reloads and enforces the budget
+    void update();
+
+    void setBudget(size_t bytes) { budget = bytes; }
+    size_t getBudget() const { return budget; }
+    const Stats & stats() const { return current; }
+
+    // Budget bar and a per-texture table, for the scene's ImGui window
+    void drawUI() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<std::string> files;
+        GLenum target = GL_TEXTURE_2D;
+        bool flip = false, srgb = false;
+        int refs = 0;
+
+        TextureHandle texture;      // id 0 while evicted
+        TextureHandle reload;       // full-size replacement still loading
+        bool measured = false;
+        size_t bytes = 0;           // estimated VRAM at the current size
+        size_t fullBytes = 0;       // and at full size
+        int width = 0, height = 0;
+        int levels = 0;
+        int droppedLevels = 0;
+        bool restoreFailed = false; // a reload failed; stay trimmed
+        uint64_t lastUsed = 0;      // frame of the last bind
+    };
+
+    TextureLoader &loader;
+    std::vector<Entry> entries;             // indexed by Handle::index; refs == 0 marks a free slot
+    std::unordered_map<std::string, int> lookup;
+    size_t budget;
+    uint64_t frame;
+    Stats current;
+
+    Handle acquire(const std::string &key, GLenum target, const std::vector<std::string> &files, bool flip, bool srgb);
+    TextureHandle load(const Entry &entry);
+    void measure(Entry &entry);
+    void evict(Entry &entry);
+    bool trim(Entry &entry);
+    void enforceBudget();
+};
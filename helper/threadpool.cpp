@@ -0,0 +1,88 @@
+#include "threadpool.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threads) : stopping(false) {
+    if (threads == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        threads = cores > 1 ? cores - 1 : 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        // Unstarted jobs are destroyed here; their futures report broken_promise
+        jobs.clear();
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> &fn) {
+    if (count <= 0)
+        return;
+
+    // Shared with the helper jobs, which may only start after this returns;
+    // by then no index is left, so they never call fn
+    struct State {
+        std::function<void(int)> fn;
+        std::atomic<int> next, done;
+        int count;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<State> state = std::make_shared<State>();
+    state->fn = fn;
+    state->next = 0;
+    state->done = 0;
+    state->count = count;
+
+    auto work = [state]() {
+        for (int i = state->next++; i < state->count; i = state->next++) {
+            state->fn(i);
+            if (++state->done == state->count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+    int helpers = std::min<int>(count - 1, (int)workers.size());
+    for (int i = 0; i < helpers; i++)
+        enqueue(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        PROFILE_SCOPE("ThreadPool::job");
+        job();
+    }
+}
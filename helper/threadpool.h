@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running jobs in submission order.
+//
+//   ThreadPool pool;
+//   std::future<int> result = pool.submit([]() { return slowWork(); });
+//
+// Jobs must not touch GL: only the thread that owns the context may.  The
+// destructor drops jobs that have not started and waits for running ones.
+class ThreadPool {
+public:
+    // 0 picks one worker per core, leaving a core for the GL thread
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    template <typename Fn>
+    std::future<typename std::invoke_result<Fn>::type> submit(Fn fn) {
+        typedef typename std::invoke_result<Fn>::type Result;
+        // std::function needs a copyable target and packaged_task is move-only
+        std::shared_ptr<std::packaged_task<Result()>> task =
+            std::make_shared<std::packaged_task<Result()>>(std::move(fn));
+        std::future<Result> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // Runs fn(0) .. fn(count - 1) across the workers and returns when all
+    // have finished.  The calling thread takes indices too, so this may be
+    // called from inside a job without waiting on a busy pool.
+    void parallelFor(int count, const std::function<void(int)> &fn);
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+};
@@ -0,0 +1,106 @@
+#include "transparencytargets.h"
+
+#include "cpuprofiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+TransparencyTargets::TransparencyTargets() :
+    accumulation(0), revealage(0), framebuffer(0), vertexArray(0), size{ 0, 0 }, composite(nullptr) {}
+
+TransparencyTargets::~TransparencyTargets() {
+    release();
+}
+
+void TransparencyTargets::release() {
+    GLuint textures[] = { accumulation, revealage };
+    for (GLuint texture : textures) {
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+    }
+    if (framebuffer != 0)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (vertexArray != 0)
+        glDeleteVertexArrays(1, &vertexArray);
+    accumulation = revealage = framebuffer = vertexArray = 0;
+}
+
+void TransparencyTargets::setCompositeProgram(GLSLProgram &program) {
+    composite = &program;
+    accumulationUniform = program.uniform<int>("accumulation");
+    revealageUniform = program.uniform<int>("revealage");
+}
+
+void TransparencyTargets::create(int width, int height) {
+    release();
+    size[0] = std::max(1, width);
+    size[1] = std::max(1, height);
+
+    auto target = [this](GLenum format) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, size[0], size[1]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return texture;
+    };
+    accumulation = target(GL_RGBA16F);
+    revealage = target(GL_R16F);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Leaves the caller's framebuffer bound, which need not be 0
+    GLint previous = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, revealage, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "TransparencyTargets: accumulation framebuffer is not complete" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+
+    glGenVertexArrays(1, &vertexArray);
+}
+
+void TransparencyTargets::beginWeighted() {
+    if (framebuffer == 0)
+        return;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    const GLfloat noColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const GLfloat allRevealed[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, noColor);
+    glClearBufferfv(GL_COLOR, 1, allRevealed);
+
+    // Sums in the first target, products of 1 - alpha in the second
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+void TransparencyTargets::resolveWeighted(GLuint target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    if (!composite || framebuffer == 0)
+        return;
+    PROFILE_SCOPE("TransparencyTargets::resolveWeighted");
+
+    // The average colour over the scene, by how much the particles cover it
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    composite->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, accumulation);
+    composite->setUniform(accumulationUniform, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, revealage);
+    composite->setUniform(revealageUniform, 1);
+    glBindVertexArray(vertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
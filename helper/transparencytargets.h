@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "glslprogram.h"
+
+// Render targets for particles drawn over the finished opaque scene.
+//
+//   TransparencyTargets targets;
+//   targets.setCompositeProgram(compositeProgram);   // shader/fullscreen.vert, oit_composite.frag
+//   targets.create(width, height);
+//   ...
+//   targets.beginWeighted();
+//   // draw the particles, writing accumulation and revealage
+//   targets.resolveWeighted(framebuffer);
+//
+// The weighted pass is weighted blended order-independent transparency
+// (McGuire and Bavoil, 2013): fragments add their weighted premultiplied
+// colour to an RGBA16F target and multiply an R16F revealage target by
+// 1 - alpha, in any order, and the resolve divides out the weights and
+// blends the average over the scene.  The accumulation targets have no
+// depth buffer, so the particle shader tests against a copy of the scene's
+// depth itself (DepthCopy).
+class TransparencyTargets {
+public:
+    TransparencyTargets();
+    ~TransparencyTargets();
+
+    TransparencyTargets(const TransparencyTargets &) = delete;
+    TransparencyTargets & operator=(const TransparencyTargets &) = delete;
+
+    void setCompositeProgram(GLSLProgram &program);
+
+    // (Re)allocates for a framebuffer of this size
+    void create(int width, int height);
+
+    // Binds and clears the accumulation targets and sets their blending;
+    // fragment outputs 0 and 1 are accumulation and revealage
+    void beginWeighted();
+
+    // Binds framebuffer again and blends the accumulated particles over it
+    void resolveWeighted(GLuint framebuffer);
+
+private:
+    GLuint accumulation;    // RGBA16F, weighted premultiplied colour and weighted alpha
+    GLuint revealage;       // R16F, product of 1 - alpha
+    GLuint framebuffer;
+    GLuint vertexArray;     // empty; fullscreen.vert makes its own triangle
+    int size[2];
+
+    GLSLProgram *composite;
+    UniformHandle<int> accumulationUniform;
+    UniformHandle<int> revealageUniform;
+
+    void release();
+};
@@ -0,0 +1,39 @@
+#include "uniformbuffer.h"
+
+UniformBuffer::UniformBuffer() : handle(0), size(0) {}
+
+UniformBuffer::~UniformBuffer() {
+    if (handle != 0)
+        glDeleteBuffers(1, &handle);
+}
+
+void UniformBuffer::create(GLsizeiptr bufferSize, GLenum usage) {
+    if (handle == 0)
+        glGenBuffers(1, &handle);
+    size = bufferSize;
+    glBindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferData(GL_UNIFORM_BUFFER, size, nullptr, usage);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::update(const void *data, GLsizeiptr dataSize, GLintptr offset) {
+    glBindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, dataSize, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::bindBase(GLuint binding) const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+}
+
+void UniformBuffer::bindRange(GLuint binding, GLintptr offset, GLsizeiptr rangeSize) const {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, handle, offset, rangeSize);
+}
+
+GLsizeiptr UniformBuffer::alignedSize(GLsizeiptr blockSize) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0)
+        alignment = 256;
+    return (blockSize + alignment - 1) / alignment * alignment;
+}
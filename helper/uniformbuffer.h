@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// A GL_UNIFORM_BUFFER holding one or more std140 blocks.  Programs read it
+// through a fixed binding point (see GLSLProgram::bindUniformBlock), so a
+// value shared by several programs is uploaded once instead of per program.
+class UniformBuffer {
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer & operator=(const UniformBuffer &) = delete;
+
+    void create(GLsizeiptr size, GLenum usage = GL_DYNAMIC_DRAW);
+    void update(const void *data, GLsizeiptr size, GLintptr offset = 0);
+
+    // Whole buffer, or one block of it, at the given binding point
+    void bindBase(GLuint binding) const;
+    void bindRange(GLuint binding, GLintptr offset, GLsizeiptr size) const;
+
+    GLuint getHandle() const { return handle; }
+    GLsizeiptr getSize() const { return size; }
+
+    // Rounds a block size up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, for
+    // packing several blocks into one buffer and selecting them with bindRange
+    static GLsizeiptr alignedSize(GLsizeiptr blockSize);
+
+private:
+    GLuint handle;
+    GLsizeiptr size;
+};
@@ -2,19 +2,191 @@
 #include "helper/scene.h"
 #include "helper/scenerunner.h"
 #include "scenebasic_uniform.h"
+#include "helper/programcache.h"
+#include "helper/assetarchive.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <memory>
 
 // Main program entry point
+//   --headless [frames]  render offscreen through EGL instead of opening a window
+//   --output file.png    save the last headless frame
+//   --benchmark [path]   replay a recorded camera path (or a built-in orbit) and time every frame
+//   --bench-output file  benchmark results, .json or .csv (default benchmark.json)
+//   --bench-dt seconds   simulated time step during replay (default 1/60)
+//   --bench-warmup n     untimed frames before the replay (default 5)
+//   --record-path file   record the camera path of an interactive run
+//   --gpu-trace file     write per-pass GPU timings as a Chrome trace on exit
+//   --cpu-trace file     write CPU scope timings as a Chrome trace on exit
+//   --shader-cache dir   directory for cached program binaries (default shader_cache)
+//   --no-shader-cache    always compile shaders from source
+//   --archive file       packed asset archive to load shaders and textures from (default assets.pak, if present)
+//   --no-archive         always load the loose files
+//   --upload-budget mb   texture data streamed to the GPU per frame (default 4)
+//   --gpu-mips           build texture mipmaps with glGenerateMipmap instead of on the loader threads
+//   --max-texture-size n scale down textures wider or taller than n pixels when loading
+//   --texture-budget mb  estimated VRAM for textures before the least recently used are evicted or trimmed (default 256)
+//   --items n            scatter n collectible items around the scene, drawn in one instanced call (default 0)
+//   --classic-submission draw each kind of object with its own calls instead of one multi-draw indirect per pass
+//   --no-culling         draw every object instead of culling against each pass's frustum (and last frame's depth, on the GPU)
+//   --particles n        particles in the ring (default 100)
+//   --classic-particles  simulate the ring with transform feedback instead of the compute particle engine
+//   --cpu-particles      simulate the ring on the CPU with SIMD, streamed through a mapped buffer
+//   --particle-blend m   additive (default), sorted (GPU depth sort, alpha over) or weighted (order-independent)
+//   --hard-particles     let particles cut into the scene instead of fading where they meet it
+//   --particle-budget ms shed particle detail to keep their pass within ms of GPU time (default off)
 int main(int argc, char* argv[]) {
     try {
+#ifdef SCENE_HEADLESS_ONLY
+        bool headless = true;
+#else
+        bool headless = false;
+#endif
+        int frames = 100;
+        std::string output;
+        bool benchmark = false;
+        std::string benchmarkPath, benchmarkOutput = "benchmark.json", recordPath, gpuTrace, cpuTrace;
+        std::string shaderCache = "shader_cache";
+        std::string archive = "assets.pak";
+        bool archiveRequired = false;
+        float benchmarkDt = 1.0f / 60.0f;
+        int benchmarkWarmup = 5;
+        float uploadBudgetMB = 0.0f;
+        bool gpuMips = false;
+        int maxTextureSize = 0;
+        float textureBudgetMB = 0.0f;
+        int itemCount = 0;
+        bool classicSubmission = false;
+        bool gpuCulling = true;
+        int particleCount = 100;
+        bool classicParticles = false;
+        bool cpuParticles = false;
+        SceneBasic_Uniform::ParticleBlend particleBlend = SceneBasic_Uniform::PARTICLE_BLEND_ADDITIVE;
+        bool softParticles = true;
+        float particleBudgetMs = 0.0f;
+        for (int i = 1; i < argc; i++) {
+            if (strcmp(argv[i], "--headless") == 0) {
+                headless = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-')
+                    frames = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+                output = argv[++i];
+            } else if (strcmp(argv[i], "--benchmark") == 0) {
+                benchmark = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-')
+                    benchmarkPath = argv[++i];
+            } else if (strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc) {
+                benchmarkOutput = argv[++i];
+            } else if (strcmp(argv[i], "--bench-dt") == 0 && i + 1 < argc) {
+                benchmarkDt = (float)atof(argv[++i]);
+            } else if (strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc) {
+                benchmarkWarmup = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--record-path") == 0 && i + 1 < argc) {
+                recordPath = argv[++i];
+            } else if (strcmp(argv[i], "--gpu-trace") == 0 && i + 1 < argc) {
+                gpuTrace = argv[++i];
+            } else if (strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc) {
+                cpuTrace = argv[++i];
+            } else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc) {
+                shaderCache = argv[++i];
+            } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+                shaderCache.clear();
+            } else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) {
+                archive = argv[++i];
+                archiveRequired = true;
+            } else if (strcmp(argv[i], "--no-archive") == 0) {
+                archive.clear();
+            } else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc) {
+                uploadBudgetMB = (float)atof(argv[++i]);
+            } else if (strcmp(argv[i], "--gpu-mips") == 0) {
+                gpuMips = true;
+            } else if (strcmp(argv[i], "--max-texture-size") == 0 && i + 1 < argc) {
+                maxTextureSize = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+                textureBudgetMB = (float)atof(argv[++i]);
+            } else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc) {
+                itemCount = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--classic-submission") == 0) {
+                classicSubmission = true;
+            } else if (strcmp(argv[i], "--no-culling") == 0) {
+                gpuCulling = false;
+            } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+                particleCount = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--classic-particles") == 0) {
+                classicParticles = true;
+            } else if (strcmp(argv[i], "--cpu-particles") == 0) {
+                cpuParticles = true;
+            } else if (strcmp(argv[i], "--particle-blend") == 0 && i + 1 < argc &&
+                       (strcmp(argv[i + 1], "additive") == 0 || strcmp(argv[i + 1], "sorted") == 0 || strcmp(argv[i + 1], "weighted") == 0)) {
+                i++;
+                if (strcmp(argv[i], "sorted") == 0)
+                    particleBlend = SceneBasic_Uniform::PARTICLE_BLEND_SORTED;
+                else if (strcmp(argv[i], "weighted") == 0)
+                    particleBlend = SceneBasic_Uniform::PARTICLE_BLEND_WEIGHTED;
+                else
+                    particleBlend = SceneBasic_Uniform::PARTICLE_BLEND_ADDITIVE;
+            } else if (strcmp(argv[i], "--hard-particles") == 0) {
+                softParticles = false;
+            } else if (strcmp(argv[i], "--particle-budget") == 0 && i + 1 < argc) {
+                particleBudgetMs = (float)atof(argv[++i]);
+            } else {
+                std::cerr << "Usage: " << argv[0] << " [--headless [frames]] [--output file.png]"
+                          << " [--benchmark [path]] [--bench-output file] [--bench-dt seconds] [--bench-warmup n]"
+                          << " [--record-path file] [--gpu-trace file] [--cpu-trace file]"
+                          << " [--shader-cache dir] [--no-shader-cache] [--archive file] [--no-archive]"
+                          << " [--upload-budget mb] [--gpu-mips]"
+                          << " [--max-texture-size n] [--texture-budget mb] [--items n] [--classic-submission] [--no-culling]"
+                          << " [--particles n] [--classic-particles] [--cpu-particles]"
+                          << " [--particle-blend additive|sorted|weighted] [--hard-particles] [--particle-budget ms]" << std::endl;
+                return 1;
+            }
+        }
+
+        if (!shaderCache.empty())
+            ProgramBinaryCache::enable(shaderCache);
+        // Anything missing from the archive still loads from the loose files
+        if (!archive.empty() && !AssetArchive::mount(archive) && archiveRequired)
+            std::cerr << "Unable to open asset archive " << archive << "; loading loose files" << std::endl;
+
         // Create scene runner
         std::cout << "OPEN OPENGL..." << std::endl;
-        SceneRunner runner("Shader_Basics");
+        SceneRunner runner("Shader_Basics", WIN_WIDTH, WIN_HEIGHT, 0, headless);
+        runner.headlessFrames = frames;
+        runner.headlessOutput = output;
+        runner.benchmark = benchmark;
+        runner.benchmarkPath = benchmarkPath;
+        runner.benchmarkOutput = benchmarkOutput;
+        runner.benchmarkDt = benchmarkDt;
+        runner.benchmarkWarmup = benchmarkWarmup;
+        runner.recordPath = recordPath;
         
         // Create scene
-        std::unique_ptr<Scene> scene = std::unique_ptr<Scene>(new SceneBasic_Uniform());
+        SceneBasic_Uniform* basicScene = new SceneBasic_Uniform();
+        std::unique_ptr<Scene> scene = std::unique_ptr<Scene>(basicScene);
+        if (uploadBudgetMB > 0.0f)
+            basicScene->setTextureUploadBudget((GLsizeiptr)(uploadBudgetMB * 1024.0f * 1024.0f));
+        basicScene->setCpuMipmaps(!gpuMips);
+        basicScene->setMaxTextureSize(maxTextureSize);
+        if (textureBudgetMB > 0.0f)
+            basicScene->setTextureBudget((size_t)(textureBudgetMB * 1024.0f * 1024.0f));
+        basicScene->setItemCount(itemCount);
+        basicScene->setIndirectSubmission(!classicSubmission);
+        basicScene->setCulling(gpuCulling);
+        basicScene->setParticleCount(particleCount);
+        basicScene->setComputeParticles(!classicParticles);
+        basicScene->setCpuParticles(cpuParticles);
+        basicScene->setParticleBlend(particleBlend);
+        basicScene->setSoftParticles(softParticles);
+        basicScene->setParticleBudget(particleBudgetMs);
         
         // Run scene
-        return runner.run(*scene);
+        int result = runner.run(*scene);
+        if (!gpuTrace.empty())
+            basicScene->exportGpuTrace(gpuTrace);
+        if (!cpuTrace.empty())
+            basicScene->exportCpuTrace(cpuTrace);
+        return result;
     }
     catch(const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
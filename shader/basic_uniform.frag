@@ -6,28 +6,38 @@ in VS_OUT {
     vec3 Normal;
     vec2 TexCoords;
     vec4 FragPosLightSpace; // Received from vertex shader
+    vec3 Tint;
+    flat float Layer;
+    flat int MaterialIndex;
 } fs_in;
 
-// Material structure
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+// Per-material data (MaterialUniforms in scenebasic_uniform.h)
 struct Material {
-    vec3 albedo;         // base color
-    float metallic;      // metallic (0=non-metal, 1=metal)
-    float roughness;     // roughness (0=smooth, 1=rough)
-    float ao;            // ambient occlusion
     vec3 specular;       // specular color
     float shininess;     // shininess
+    vec3 overrideColor;  // used instead of the texture if r >= 0
+    float reflectivity;  // environment reflection strength
+};
+
+// Every material, indexed by the vertex stage (MATERIAL_COUNT entries)
+layout(std140) uniform MaterialData {
+    Material materials[2];
 };
 
-uniform Material material;
 uniform sampler2D ballTexture;
+uniform sampler2DArray itemTextures; // one layer per item texture
 uniform samplerCube skybox;
 uniform sampler2D shadowMap; // Depth map texture
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 overrideColor;
-uniform float reflectivity;
-
 float ShadowCalculation(vec4 fragPosLightSpace)
 {
     // perspective divide
@@ -40,7 +50,7 @@ float ShadowCalculation(vec4 fragPosLightSpace)
     float currentDepth = projCoords.z;
     // check whether current frag pos is in shadow
     vec3 normal = normalize(fs_in.Normal);
-    vec3 lightDir = normalize(lightPos - fs_in.FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - fs_in.FragPos);
     float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
     
     float shadow = 0.0;
@@ -71,18 +81,22 @@ void main()
 */
 
     // --- Restore Original Lighting Code --- 
+    Material material = materials[fs_in.MaterialIndex];
+
     // Base color
-    vec3 color = texture(ballTexture, fs_in.TexCoords).rgb;
+    vec3 color = fs_in.Layer >= 0.0 ? texture(itemTextures, vec3(fs_in.TexCoords, fs_in.Layer)).rgb
+                                    : texture(ballTexture, fs_in.TexCoords).rgb;
+    color *= fs_in.Tint;
     
     // If override color exists, use it
-    if (overrideColor.r >= 0.0) {
-        color = overrideColor;
+    if (material.overrideColor.r >= 0.0) {
+        color = material.overrideColor;
     }
     
     // Basic lighting calculation
     vec3 normal = normalize(fs_in.Normal);
-    vec3 lightDir = normalize(lightPos - fs_in.FragPos);
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - fs_in.FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - fs_in.FragPos);
     
     // Ambient light
     vec3 ambient = 0.3 * color; // Slightly higher ambient
@@ -98,7 +112,7 @@ void main()
     
     // Environment reflection
     vec3 R = reflect(-viewDir, normal);
-    vec3 reflection = texture(skybox, R).rgb * reflectivity;
+    vec3 reflection = texture(skybox, R).rgb * material.reflectivity;
 
     // Calculate shadow
     float shadow = ShadowCalculation(fs_in.FragPosLightSpace); // <<< Re-enable shadow calculation
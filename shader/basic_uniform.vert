@@ -2,6 +2,9 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// Per instance, from ItemRenderer's instance buffer
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in vec4 instanceColor;    // rgb tint, w texture array layer
 
 // declare an interface block; see 'Advanced GLSL' for what these are.
 out VS_OUT {
@@ -9,19 +12,33 @@ out VS_OUT {
     vec3 Normal;
     vec2 TexCoords;
     vec4 FragPosLightSpace; // Output position in light space
+    vec3 Tint;
+    flat float Layer;       // < 0 samples ballTexture instead of the item array
+    flat int MaterialIndex;
 } vs_out;
 
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
 uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
-uniform vec3 viewPos;
-uniform mat4 lightSpaceMatrix; // Matrix to transform to light space
+uniform bool instanced;     // take the model, tint and layer from the instance
+uniform int materialIndex;  // into the MaterialData block
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+    mat4 world = instanced ? instanceModel : model;
+    vs_out.FragPos = vec3(world * vec4(aPos, 1.0));
+    vs_out.Normal = transpose(inverse(mat3(world))) * aNormal;
     vs_out.TexCoords = aTexCoords;
     vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vs_out.Tint = instanced ? instanceColor.rgb : vec3(1.0);
+    vs_out.Layer = instanced ? instanceColor.w : -1.0;
+    vs_out.MaterialIndex = materialIndex;
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
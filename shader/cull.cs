@@ -0,0 +1,101 @@
+#version 430 core
+// Frustum and Hi-Z occlusion culling for GpuScene: every visible object is
+// appended to its command's run of the visible list, and the command's
+// instanceCount counts them
+layout(local_size_x = 64) in;
+
+// Per-object data (GpuScene::Object)
+struct Object {
+    mat4 model;
+    vec4 color;
+    uint material;
+    float radius;           // bounding sphere about the object's origin, before scaling
+    uint command;           // index of the draw command that draws it
+    uint padding;
+};
+
+// Layout read by glMultiDrawElementsIndirect (GpuScene::Command)
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectData {
+    Object objects[];
+};
+
+layout(std430, binding = 1) buffer CommandData {
+    Command commands[];
+};
+
+layout(std430, binding = 2) writeonly buffer VisibleData {
+    uint visible[];
+};
+
+uniform uint objectCount;
+uniform vec4 planes[6];             // world space, inside where dot(xyz, p) + w >= 0
+
+uniform bool occlusion;
+uniform sampler2D hiZ;              // farthest depth per texel (HiZPyramid)
+uniform mat4 hiZViewProjection;     // of the frame the pyramid was built from
+uniform vec2 hiZFramebufferSize;  // the pyramid's level 0 is half of it, rounded down
+uniform int hiZLevels;
+
+bool occluded(vec3 center, float radius)
+{
+    // Screen rectangle and nearest depth of the sphere's bounding box
+    vec3 lo = vec3(1.0e30), hi = vec3(-1.0e30);
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0,
+                                             (i & 2) != 0 ? 1.0 : -1.0,
+                                             (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0)
+            return false;   // reaches behind the camera
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc);
+        hi = max(hi, ndc);
+    }
+    vec2 uvLo = clamp(lo.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvHi = clamp(hi.xy * 0.5 + 0.5, 0.0, 1.0);
+    float nearest = lo.z * 0.5 + 0.5;
+
+    // The level where the rectangle covers at most 2x2 texels
+    vec2 extent = (uvHi - uvLo) * hiZFramebufferSize * 0.5;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+
+    // Texel t of a level covers framebuffer pixels [t, t + 1) << (level + 1),
+    // and the last one the rows and columns left over as well, so texels are
+    // found from the pixels rather than from the level's own size
+    ivec2 size = textureSize(hiZ, level);
+    ivec2 a = min(ivec2(uvLo * hiZFramebufferSize) >> (level + 1), size - 1);
+    ivec2 b = min(ivec2(uvHi * hiZFramebufferSize) >> (level + 1), size - 1);
+    float farthest = max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));
+    return nearest > farthest;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= objectCount)
+        return;
+
+    Object object = objects[index];
+    vec3 center = object.model[3].xyz;
+    float scale = max(length(object.model[0].xyz), max(length(object.model[1].xyz), length(object.model[2].xyz)));
+    float radius = object.radius * scale;
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius)
+            return;
+    }
+    if (occlusion && occluded(center, radius))
+        return;
+
+    uint slot = atomicAdd(commands[object.command].instanceCount, 1u);
+    visible[commands[object.command].baseInstance + slot] = index;
+}
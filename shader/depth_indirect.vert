@@ -0,0 +1,31 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 8) in uint drawIndex;    // object of this instance (GpuScene::ATTRIBUTE_DRAW_INDEX)
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+// Per-object data (GpuScene::Object)
+struct Object {
+    mat4 model;
+    vec4 color;
+    uint material;
+    float radius;
+    uint command;
+    uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectData {
+    Object objects[];
+};
+
+void main()
+{
+    gl_Position = lightSpaceMatrix * objects[drawIndex].model * vec4(aPos, 1.0);
+}
@@ -1,10 +1,20 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 instanceModel;    // per instance, from ItemRenderer
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
 
-uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
+uniform bool instanced;
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * (instanced ? instanceModel : model) * vec4(aPos, 1.0);
 } 
\ No newline at end of file
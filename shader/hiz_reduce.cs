@@ -0,0 +1,37 @@
+#version 430 core
+// One level of the Hi-Z pyramid (HiZPyramid): each texel keeps the farthest
+// depth of the 2x2 texels below it, in the depth buffer for level 0 and in
+// the level above for the rest
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 0) readonly uniform image2D source;        // level - 1
+layout(r32f, binding = 1) writeonly uniform image2D destination;  // level
+uniform sampler2D depth;
+uniform int level;
+
+float farthestIn(ivec2 texel)
+{
+    return level == 0 ? texelFetch(depth, texel, 0).r : imageLoad(source, texel).r;
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (texel.x >= size.x || texel.y >= size.y)
+        return;
+
+    // 2x2, plus the leftover row or column of an odd source on the last texel
+    ivec2 sourceSize = level == 0 ? textureSize(depth, 0) : imageSize(source);
+    ivec2 base = texel * 2;
+    ivec2 last = min(base + ivec2(1), sourceSize - 1);
+    if (texel.x == size.x - 1)
+        last.x = sourceSize.x - 1;
+    if (texel.y == size.y - 1)
+        last.y = sourceSize.y - 1;
+    float farthest = 0.0;
+    for (int y = base.y; y <= last.y; y++)
+        for (int x = base.x; x <= last.x; x++)
+            farthest = max(farthest, farthestIn(ivec2(x, y)));
+    imageStore(destination, texel, vec4(farthest));
+}
@@ -0,0 +1,18 @@
+#version 430 core
+// Resolves weighted blended transparency (TransparencyTargets): the
+// weighted average colour, blended over the scene by the particles' coverage
+uniform sampler2D accumulation;     // rgb weighted premultiplied colour, a weighted alpha
+uniform sampler2D revealage;        // product of 1 - alpha
+
+out vec4 fragColor;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float revealed = texelFetch(revealage, texel, 0).r;
+    if (revealed >= 1.0)
+        discard;
+
+    vec4 sum = texelFetch(accumulation, texel, 0);
+    fragColor = vec4(sum.rgb / max(sum.a, 1e-5), 1.0 - revealed);
+}
@@ -1,16 +1,33 @@
 #version 430
 
 in vec3 outPosition;
-in vec3 outVelocity;
-in float outLifetime;
-in float outSize;
 flat in vec3 particleColorOut;
 
-out vec4 fragColor;
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out float revealage;   // weighted blending only
 
-uniform vec3 cameraRight;
-uniform vec3 cameraUp;
-uniform vec3 cameraPosition;
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+// ParticleBlend in scenebasic_uniform.h
+const int BLEND_ADDITIVE = 0;
+const int BLEND_SORTED = 1;     // drawn back to front, alpha over
+const int BLEND_WEIGHTED = 2;   // into TransparencyTargets' accumulation targets
+
+uniform int blendMode;
+uniform sampler2D sceneDepth;   // the opaque scene's depth, read for soft particles and weighted blending
+uniform float softDistance;     // world units over which particles fade into the scene; 0 for a hard edge
+
+// Distance along the view axis of a window depth
+float viewDepth(float depth) {
+    return projection[3][2] / (depth * 2.0 - 1.0 + projection[2][2]);
+}
 
 void main() {
     // Calculate distance for circular point sprite
@@ -27,10 +44,28 @@ void main() {
     glow = pow(glow, 0.2);  // Restore to previous glow intensity
     
     // Calculate distance to camera
-    float distanceToCamera = length(outPosition - cameraPosition);
+    float distanceToCamera = length(outPosition - viewPos.xyz);
     float distanceFactor = 1.0 - smoothstep(0.0, 100.0, distanceToCamera);
     
+    // Fade out close in front of the scene instead of cutting through it.
+    // The weighted targets have no depth buffer, so they rely on this test.
+    float visibility = 1.0;
+    if (softDistance > 0.0 || blendMode == BLEND_WEIGHTED) {
+        float gap = viewDepth(texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r) - viewDepth(gl_FragCoord.z);
+        visibility = softDistance > 0.0 ? clamp(gap / softDistance, 0.0, 1.0) : step(0.0, gap);
+    }
+
     // Output color with enhanced glow effect
     vec3 finalColor = particleColorOut * (1.0 + glow * 15.0);  // Reduce glow intensity
-    fragColor = vec4(finalColor, glow * distanceFactor); // Restore transparency calculation
+    float alpha = glow * distanceFactor * visibility;
+    if (blendMode == BLEND_WEIGHTED) {
+        // McGuire and Bavoil's depth weight; the colour is clamped as a
+        // fixed-point framebuffer would, which keeps the sums within half floats
+        float z = viewDepth(gl_FragCoord.z);
+        float weight = alpha * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+        fragColor = vec4(min(finalColor, vec3(1.0)) * alpha, alpha) * weight;
+        revealage = alpha;
+    } else {
+        fragColor = vec4(finalColor, alpha);
+    }
 } 
\ No newline at end of file
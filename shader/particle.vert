@@ -1,82 +1,54 @@
 #version 430
 
-// Input variables
+// Draws the particles ParticleSystem last updated (shader/particle_update.vert)
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inVelocity;
-layout(location = 2) in float inLifetime;
 layout(location = 3) in float inSize;
 
 // Output variables
 out vec3 outPosition;
-out vec3 outVelocity;
-out float outLifetime;
-out float outSize;
 flat out vec3 particleColorOut;
 
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
 // Uniform variables
-uniform float deltaTime;
-uniform vec3 emitterPosition;
-uniform float emitterRadius;
-uniform float particleSpeed;
-uniform float gravity;
-uniform float lifeDecay;
 uniform vec3 particleColor;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 cameraRight;
-uniform vec3 cameraUp;
-uniform float rotationSpeed;
-uniform int particleCount;
+
+// Level of detail (ParticleLod): at most maxPointSize pixels, and below
+// thinPointSize kept with probability (size / thinPointSize)^2 and grown to
+// it, but never past maxPointSize
+uniform float maxPointSize;
+uniform float thinPointSize;
+
+// False for a particle thinned out; id must stay with the particle from frame to frame
+bool lodKeep(float size, uint id) {
+    if (size >= thinPointSize)
+        return true;
+    // PCG hash, to a number in [0, 1)
+    uint h = id * 747796405u + 2891336453u;
+    h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+    h = (h >> 22u) ^ h;
+    float ratio = size / thinPointSize;
+    return float(h) / 4294967296.0 < ratio * ratio;
+}
 
 void main() {
-    // Update particle position
     outPosition = inPosition;
-    
-    // Calculate rotation angle
-    float angle = rotationSpeed * deltaTime;
-    
-    // Create rotation matrix (only in XZ plane)
-    mat3 rotationMatrix = mat3(
-        cos(angle), 0.0, sin(angle),
-        0.0, 1.0, 0.0,
-        -sin(angle), 0.0, cos(angle)
-    );
-    
-    // Apply rotation
-    outPosition = emitterPosition + rotationMatrix * (outPosition - emitterPosition);
-    
-    // Update velocity
-    vec3 direction = normalize(outPosition - emitterPosition);
-    outVelocity = cross(direction, vec3(0.0, 1.0, 0.0)) * particleSpeed;
-    
-    // Update particle lifetime
-    outLifetime = inLifetime - lifeDecay * deltaTime;
-    
-    // Pass other attributes
-    outSize = 1.5;  // Adjust to a smaller but visible size
     particleColorOut = particleColor;
-    
-    // If particle lifetime ends, reinitialize
-    if (outLifetime <= 0.0) {
-        // Create a ring in the XZ plane
-        float theta = radians(360.0 * (float(gl_VertexID) / float(particleCount)));
-        outPosition = emitterPosition + vec3(
-            emitterRadius * cos(theta),
-            0.0,  // Keep in XZ plane
-            emitterRadius * sin(theta)
-        );
-        
-        // Set initial velocity
-        vec3 direction = normalize(outPosition - emitterPosition);
-        outVelocity = cross(direction, vec3(0.0, 1.0, 0.0)) * particleSpeed;
-        
-        outLifetime = 1.0;
-    }
-    
+
     // Calculate particle position in screen space
-    vec4 pos = projection * view * vec4(outPosition, 1.0);
+    vec4 pos = projection * view * vec4(inPosition, 1.0);
     gl_Position = pos;
-    
-    // Set point size, greatly increased
-    gl_PointSize = outSize * 100.0 * (1.0 / pos.w); // Significantly reduce point size factor
-} 
\ No newline at end of file
+
+    // Shrinks with distance, within ParticleLod's limits
+    float pointSize = min(inSize * 100.0 / pos.w, maxPointSize);
+    if (!lodKeep(pointSize, uint(gl_VertexID)))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);     // beyond the far plane, so clipped
+    gl_PointSize = min(max(pointSize, thinPointSize), maxPointSize);
+}
@@ -0,0 +1,81 @@
+#version 430
+
+// Draws ParticleEngine's live particles: vertex i is the particle at entry i
+// of the alive list, so glDrawArraysIndirect needs no vertex buffer
+struct Particle {
+    vec4 positionLife;      // xyz, w life from 1 down to 0
+    vec3 velocity;
+    uint emitter;
+};
+
+struct Emitter {
+    vec4 positionRadius;
+    vec4 colorSize;         // rgb, w point size
+    float speed;
+    float gravity;
+    float lifeDecay;
+    float rotationSpeed;
+    uint shape;
+    uint padding[3];
+};
+
+layout(std430, binding = 0) readonly buffer ParticleData {
+    Particle particles[];
+};
+
+layout(std430, binding = 2) readonly buffer AliveList {
+    uint alive[];
+};
+
+layout(std430, binding = 5) readonly buffer EmitterData {
+    Emitter emitters[];
+};
+
+// Level of detail (ParticleLod): at most maxPointSize pixels, and below
+// thinPointSize kept with probability (size / thinPointSize)^2 and grown to
+// it, but never past maxPointSize
+uniform float maxPointSize;
+uniform float thinPointSize;
+
+// False for a particle thinned out; id must stay with the particle from frame to frame
+bool lodKeep(float size, uint id) {
+    if (size >= thinPointSize)
+        return true;
+    // PCG hash, to a number in [0, 1)
+    uint h = id * 747796405u + 2891336453u;
+    h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+    h = (h >> 22u) ^ h;
+    float ratio = size / thinPointSize;
+    return float(h) / 4294967296.0 < ratio * ratio;
+}
+
+// Output variables
+out vec3 outPosition;
+flat out vec3 particleColorOut;
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+void main() {
+    Particle p = particles[alive[gl_VertexID]];
+    Emitter e = emitters[p.emitter];
+    outPosition = p.positionLife.xyz;
+
+    // Fade out over the last quarter of the particle's life
+    particleColorOut = e.colorSize.rgb * clamp(p.positionLife.w * 4.0, 0.0, 1.0);
+
+    vec4 pos = projection * view * vec4(outPosition, 1.0);
+    gl_Position = pos;
+
+    // Shrinks with distance, within ParticleLod's limits
+    float pointSize = min(e.colorSize.w * 100.0 / pos.w, maxPointSize);
+    if (!lodKeep(pointSize, alive[gl_VertexID]))
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);     // beyond the far plane, so clipped
+    gl_PointSize = min(max(pointSize, thinPointSize), maxPointSize);
+}
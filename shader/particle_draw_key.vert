@@ -0,0 +1,41 @@
+#version 430
+
+// Sort keys for ParticleSorter: the view depth and vertex number of every
+// particle particle_draw.vert draws, run with the rasterizer off
+struct Particle {
+    vec4 positionLife;      // xyz, w life from 1 down to 0
+    vec3 velocity;
+    uint emitter;
+};
+
+layout(std430, binding = 0) readonly buffer ParticleData {
+    Particle particles[];
+};
+
+layout(std430, binding = 2) readonly buffer AliveList {
+    uint alive[];
+};
+
+layout(std430, binding = 6) writeonly buffer SortKeys {
+    uint sortKeys[];
+};
+
+layout(std430, binding = 7) writeonly buffer SortIndices {
+    uint sortIndices[];
+};
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+void main() {
+    // Farther particles get larger keys; behind the camera they are clipped anyway
+    vec4 pos = projection * view * vec4(particles[alive[gl_VertexID]].positionLife.xyz, 1.0);
+    sortKeys[gl_VertexID] = floatBitsToUint(max(pos.w, 0.0));
+    sortIndices[gl_VertexID] = uint(gl_VertexID);
+}
@@ -0,0 +1,115 @@
+#version 430 core
+// Spawns particles for ParticleEngine: each thread pops a free slot off the
+// dead list, starts a particle from an emitter in it and appends it to the
+// current alive list
+layout(local_size_x = 64) in;
+
+// ParticleEngine::Particle
+struct Particle {
+    vec4 positionLife;      // xyz, w life from 1 down to 0
+    vec3 velocity;
+    uint emitter;
+};
+
+// ParticleEngine::EmitterData
+struct Emitter {
+    vec4 positionRadius;
+    vec4 colorSize;
+    float speed;
+    float gravity;
+    float lifeDecay;
+    float rotationSpeed;
+    uint shape;             // 0 ring, 1 sphere
+    uint padding[3];
+};
+
+// Layout read by glDrawArraysIndirect (ParticleEngine::DrawCommand)
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) writeonly buffer ParticleData {
+    Particle particles[];
+};
+
+layout(std430, binding = 1) readonly buffer DeadList {
+    uint dead[];
+};
+
+layout(std430, binding = 2) writeonly buffer AliveList {
+    uint alive[];
+};
+
+layout(std430, binding = 4) buffer CounterData {
+    DrawCommand draws[2];
+    uint groups[3];
+    int deadCount;
+};
+
+layout(std430, binding = 5) readonly buffer EmitterData {
+    Emitter emitters[];
+};
+
+uniform uint emitter;
+uniform uint first;         // of this dispatch, within count
+uniform uint count;         // particles spawned together
+uniform uint seed;
+uniform uint current;       // alive list to append to
+uniform vec3 position;      // of the emitter for this spawn
+uniform float angle;        // where a ring starts
+
+const uint SHAPE_RING = 0u;
+
+uint hash(uint value)
+{
+    // PCG
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random(inout uint state)
+{
+    state = hash(state);
+    return float(state) * (1.0 / 4294967296.0);
+}
+
+void main()
+{
+    uint i = first + gl_GlobalInvocationID.x;
+    if (i >= count)
+        return;
+
+    // Nothing is spawned once every slot is taken
+    int top = atomicAdd(deadCount, -1);
+    if (top <= 0) {
+        atomicAdd(deadCount, 1);
+        return;
+    }
+    uint index = dead[top - 1];
+
+    Emitter e = emitters[emitter];
+    vec3 direction;
+    vec3 velocity;
+    if (e.shape == SHAPE_RING) {
+        // Evenly around the ring, moving along it
+        float theta = angle + 6.28318530718 * (float(i) / float(count));
+        direction = vec3(cos(theta), 0.0, sin(theta));
+        velocity = cross(direction, vec3(0.0, 1.0, 0.0)) * e.speed;
+    } else {
+        // Uniformly over the sphere, moving outwards
+        uint state = hash(i ^ hash(seed));
+        float z = random(state) * 2.0 - 1.0;
+        float phi = 6.28318530718 * random(state);
+        direction = vec3(sqrt(1.0 - z * z) * cos(phi), z, sqrt(1.0 - z * z) * sin(phi));
+        velocity = direction * e.speed * mix(0.5, 1.0, random(state));
+    }
+    particles[index].positionLife = vec4(position + direction * e.positionRadius.w, 1.0);
+    particles[index].velocity = velocity;
+    particles[index].emitter = emitter;
+
+    alive[atomicAdd(draws[current].count, 1u)] = index;
+}
@@ -0,0 +1,29 @@
+#version 430
+
+// Sort keys for ParticleSorter: the view depth and vertex number of every
+// particle particle.vert draws, run with the rasterizer off
+layout(location = 0) in vec3 inPosition;
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+layout(std430, binding = 6) writeonly buffer SortKeys {
+    uint sortKeys[];
+};
+
+layout(std430, binding = 7) writeonly buffer SortIndices {
+    uint sortIndices[];
+};
+
+void main() {
+    // Farther particles get larger keys; behind the camera they are clipped anyway
+    vec4 pos = projection * view * vec4(inPosition, 1.0);
+    sortKeys[gl_VertexID] = floatBitsToUint(max(pos.w, 0.0));
+    sortIndices[gl_VertexID] = uint(gl_VertexID);
+}
@@ -0,0 +1,34 @@
+#version 430 core
+// One thread between emitting and updating in ParticleEngine: sizes the
+// update's indirect dispatch from the current alive count and empties the
+// list the update appends the survivors to
+layout(local_size_x = 1) in;
+
+// Layout read by glDrawArraysIndirect (ParticleEngine::DrawCommand)
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 4) buffer CounterData {
+    DrawCommand draws[2];
+    uint groups[3];         // read by glDispatchComputeIndirect
+    int deadCount;
+};
+
+uniform uint current;
+
+const uint GROUP_SIZE = 64u;        // local_size_x in particle_simulate.cs
+const uint MAX_GROUPS = 65535u;     // the least GL_MAX_COMPUTE_WORK_GROUP_COUNT allowed
+
+void main()
+{
+    // Rows of up to MAX_GROUPS groups, so millions of particles still fit
+    uint needed = (draws[current].count + GROUP_SIZE - 1u) / GROUP_SIZE;
+    groups[0] = min(needed, MAX_GROUPS);
+    groups[1] = (needed + MAX_GROUPS - 1u) / MAX_GROUPS;
+    groups[2] = 1u;
+    draws[1u - current].count = 0u;
+}
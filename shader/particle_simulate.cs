@@ -0,0 +1,92 @@
+#version 430 core
+// Advances every live particle of ParticleEngine by one frame.  Survivors
+// move to the other alive list and expired particles back to the dead list.
+layout(local_size_x = 64) in;
+
+// ParticleEngine::Particle
+struct Particle {
+    vec4 positionLife;      // xyz, w life from 1 down to 0
+    vec3 velocity;
+    uint emitter;
+};
+
+// ParticleEngine::EmitterData
+struct Emitter {
+    vec4 positionRadius;
+    vec4 colorSize;
+    float speed;
+    float gravity;
+    float lifeDecay;
+    float rotationSpeed;
+    uint shape;
+    uint padding[3];
+};
+
+// Layout read by glDrawArraysIndirect (ParticleEngine::DrawCommand)
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) buffer ParticleData {
+    Particle particles[];
+};
+
+layout(std430, binding = 1) writeonly buffer DeadList {
+    uint dead[];
+};
+
+layout(std430, binding = 2) readonly buffer AliveList {
+    uint alive[];
+};
+
+layout(std430, binding = 3) writeonly buffer NextAliveList {
+    uint nextAlive[];
+};
+
+layout(std430, binding = 4) buffer CounterData {
+    DrawCommand draws[2];
+    uint groups[3];
+    int deadCount;
+};
+
+layout(std430, binding = 5) readonly buffer EmitterData {
+    Emitter emitters[];
+};
+
+uniform uint current;       // alive list to read
+uniform float deltaTime;
+
+void main()
+{
+    // The dispatch is rows of groups (particle_prepare.cs)
+    uint i = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+    if (i >= draws[current].count)
+        return;
+    uint index = alive[i];
+    Particle p = particles[index];
+    Emitter e = emitters[p.emitter];
+
+    p.positionLife.w -= e.lifeDecay * deltaTime;
+    if (p.positionLife.w <= 0.0) {
+        dead[atomicAdd(deadCount, 1)] = index;
+        return;
+    }
+
+    // Orbit the emitter in the XZ plane, then move and fall
+    float angle = e.rotationSpeed * deltaTime;
+    mat3 rotation = mat3(
+        cos(angle), 0.0, sin(angle),
+        0.0, 1.0, 0.0,
+        -sin(angle), 0.0, cos(angle)
+    );
+    vec3 center = e.positionRadius.xyz;
+    p.velocity = rotation * p.velocity;
+    p.velocity.y -= e.gravity * deltaTime;
+    p.positionLife.xyz = center + rotation * (p.positionLife.xyz - center) + p.velocity * deltaTime;
+    particles[index] = p;
+
+    nextAlive[atomicAdd(draws[1u - current].count, 1u)] = index;
+}
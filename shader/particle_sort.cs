@@ -0,0 +1,88 @@
+#version 430 core
+// Bitonic sort of ParticleSorter's depth keys, largest first, carrying the
+// vertex numbers along.  Each group owns a block of 1024 keys; the steps
+// that compare within a block run in shared memory, the wider ones on the
+// buffers one step per dispatch.
+layout(local_size_x = 512) in;
+
+layout(std430, binding = 6) buffer SortKeys {
+    uint keys[];
+};
+
+layout(std430, binding = 7) buffer SortIndices {
+    uint indices[];
+};
+
+uniform uint pass;          // 0 sorts each block, 1 one step across blocks, 2 finishes a merge within each block
+uniform uint blockSize;     // length of the sequences being merged (passes 1 and 2)
+uniform uint stride;        // distance between the compared keys (pass 1)
+
+const uint BLOCK = 1024u;
+
+shared uint localKeys[BLOCK];
+shared uint localIndices[BLOCK];
+
+// Sequences alternate direction so each pair of them forms a bitonic one;
+// the final merge spans everything and runs largest first
+bool descending(uint position, uint size)
+{
+    return (position & size) == 0u;
+}
+
+void localStep(uint pair, uint base, uint size, uint distance)
+{
+    uint i = (pair / distance) * 2u * distance + pair % distance;
+    uint j = i + distance;
+    if ((localKeys[i] < localKeys[j]) == descending(base + i, size)) {
+        uint key = localKeys[i];
+        localKeys[i] = localKeys[j];
+        localKeys[j] = key;
+        uint index = localIndices[i];
+        localIndices[i] = localIndices[j];
+        localIndices[j] = index;
+    }
+    memoryBarrierShared();
+    barrier();
+}
+
+void main()
+{
+    uint pair = gl_LocalInvocationID.x;
+
+    if (pass == 1u) {
+        uint global = gl_GlobalInvocationID.x;
+        uint i = (global / stride) * 2u * stride + global % stride;
+        uint j = i + stride;
+        if ((keys[i] < keys[j]) == descending(i, blockSize)) {
+            uint key = keys[i];
+            keys[i] = keys[j];
+            keys[j] = key;
+            uint index = indices[i];
+            indices[i] = indices[j];
+            indices[j] = index;
+        }
+        return;
+    }
+
+    uint base = gl_WorkGroupID.x * BLOCK;
+    localKeys[pair] = keys[base + pair];
+    localKeys[pair + BLOCK / 2u] = keys[base + pair + BLOCK / 2u];
+    localIndices[pair] = indices[base + pair];
+    localIndices[pair + BLOCK / 2u] = indices[base + pair + BLOCK / 2u];
+    memoryBarrierShared();
+    barrier();
+
+    if (pass == 0u) {
+        for (uint size = 2u; size <= BLOCK; size <<= 1)
+            for (uint distance = size / 2u; distance > 0u; distance >>= 1)
+                localStep(pair, base, size, distance);
+    } else {
+        for (uint distance = BLOCK / 2u; distance > 0u; distance >>= 1)
+            localStep(pair, base, blockSize, distance);
+    }
+
+    keys[base + pair] = localKeys[pair];
+    keys[base + pair + BLOCK / 2u] = localKeys[pair + BLOCK / 2u];
+    indices[base + pair] = localIndices[pair];
+    indices[base + pair + BLOCK / 2u] = localIndices[pair + BLOCK / 2u];
+}
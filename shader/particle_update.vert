@@ -0,0 +1,55 @@
+#version 430
+
+// Advances each particle one frame.  Run with the rasterizer off; the outputs
+// are captured by transform feedback into the other particle buffer
+// (ParticleSystem in helper/particlesystem.h).
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inVelocity;
+layout(location = 2) in float inLife;
+layout(location = 3) in float inSize;
+
+out vec3 outPosition;
+out vec3 outVelocity;
+out float outLife;
+out float outSize;
+
+uniform float deltaTime;
+uniform vec3 emitterPosition;
+uniform float emitterRadius;
+uniform float particleSpeed;
+uniform float gravity;
+uniform float lifeDecay;
+uniform float rotationSpeed;
+uniform int particleCount;
+
+// Moving along the ring, tangent to it in XZ
+vec3 ringVelocity(vec3 position) {
+    vec3 direction = normalize(position - emitterPosition);
+    return cross(direction, vec3(0.0, 1.0, 0.0)) * particleSpeed;
+}
+
+void main() {
+    // Orbit the emitter in the XZ plane; gravity only acts vertically
+    float angle = rotationSpeed * deltaTime;
+    mat3 rotation = mat3(
+        cos(angle), 0.0, sin(angle),
+        0.0, 1.0, 0.0,
+        -sin(angle), 0.0, cos(angle)
+    );
+    float fall = inVelocity.y - gravity * deltaTime;
+    outPosition = emitterPosition + rotation * (inPosition - emitterPosition);
+    outPosition.y += fall * deltaTime;
+    outVelocity = ringVelocity(outPosition);
+    outVelocity.y = fall;
+    outLife = inLife - lifeDecay * deltaTime;
+    outSize = inSize;
+
+    // Respawn at this particle's own place on the ring
+    if (outLife <= 0.0) {
+        float theta = radians(360.0 * (float(gl_VertexID) / float(particleCount)));
+        outPosition = emitterPosition + vec3(emitterRadius * cos(theta), 0.0, emitterRadius * sin(theta));
+        outVelocity = ringVelocity(outPosition);
+        outLife = 1.0;
+    }
+}
@@ -0,0 +1,52 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 8) in uint drawIndex;    // object of this instance (GpuScene::ATTRIBUTE_DRAW_INDEX)
+
+// Same outputs as basic_uniform.vert, so basic_uniform.frag shades both
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+    vec4 FragPosLightSpace;
+    vec3 Tint;
+    flat float Layer;
+    flat int MaterialIndex;
+} vs_out;
+
+// Per-frame camera and light data, shared by all programs (FrameUniforms in scenebasic_uniform.h)
+layout(std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    mat4 lightSpaceMatrix;
+    vec4 viewPos;           // xyz
+    vec4 lightPos;          // xyz
+};
+
+// Per-object data (GpuScene::Object)
+struct Object {
+    mat4 model;
+    vec4 color;             // rgb tint, w texture array layer
+    uint material;
+    float radius;           // used by culling only
+    uint command;
+    uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer ObjectData {
+    Object objects[];
+};
+
+void main()
+{
+    Object object = objects[drawIndex];
+    vs_out.FragPos = vec3(object.model * vec4(aPos, 1.0));
+    vs_out.Normal = transpose(inverse(mat3(object.model))) * aNormal;
+    vs_out.TexCoords = aTexCoords;
+    vs_out.FragPosLightSpace = lightSpaceMatrix * vec4(vs_out.FragPos, 1.0);
+    vs_out.Tint = object.color.rgb;
+    vs_out.Layer = object.color.w;
+    vs_out.MaterialIndex = int(object.material);
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
+}
@@ -1,2 +1,6 @@
 #define STB_IMAGE_IMPLEMENTATION
-#include "helper/stb_image.h"
\ No newline at end of file
+#include "helper/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "helper/stb_image_write.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb_image_resize.h"
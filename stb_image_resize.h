@@ -17,6 +17,19 @@ extern "C" {
 #define STBIR_FILTER_CATMULLROM  4  // An interpolating cubic spline
 #define STBIR_FILTER_MITCHELL    5  // Mitchell-Netrevalli filter with B=1/3, C=1/3
 
+#define STBIR_TYPE_UINT8         0
+#define STBIR_TYPE_FLOAT         3
+
+#define STBIR_COLORSPACE_LINEAR  0
+#define STBIR_COLORSPACE_SRGB    1
+
+#define STBIR_ALPHA_CHANNEL_NONE -1
+
+// This implementation supports the box and triangle filters, clamped edges
+// and 8-bit or float pixels; the other filters fall back to those
+// (STBIR_FILTER_DEFAULT: box when shrinking, triangle when enlarging), the
+// other edge modes to clamping.  A stride of 0 means tightly packed rows.
+
 // The following functions use the "default" resampling filter specified at compile time.
 // For better quality, you can call the more general functions below.
 
@@ -44,6 +57,19 @@ int stbir_resize_float_generic( const float *input_pixels , int input_w , int in
                                      int num_channels, float s0, float t0, float s1, float t1, float *transform,
                                      int edge_wrap_mode);
 
+// Resizes the region (s0, t0) - (s1, t1) of the input, in 0..1 texture
+// coordinates, onto the whole output.  Splitting the output into bands of
+// rows with matching t0 / t1 gives the same pixels as one call, so bands can
+// be resized on separate threads.  In the sRGB colour space every channel
+// but alpha_channel is filtered in linear light.
+int stbir_resize_region(const void *input_pixels , int input_w , int input_h , int input_stride_in_bytes,
+                              void *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
+                        int datatype, int num_channels, int alpha_channel, int flags,
+                        int edge_mode_horizontal, int edge_mode_vertical,
+                        int filter_horizontal, int filter_vertical,
+                        int space, void *alloc_context,
+                        float s0, float t0, float s1, float t1);
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,9 +84,6 @@ int stbir_resize_float_generic( const float *input_pixels , int input_w , int in
 
 #ifdef _MSC_VER
 #define STBIR__NOTUSED(v)  (void)(v)
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
 #else
 #define STBIR__NOTUSED(v)  (void)sizeof(v)
 #endif
@@ -69,191 +92,227 @@ int stbir_resize_float_generic( const float *input_pixels , int input_w , int in
 
 #define STBIR_MAX_CHANNELS 64
 
+// Input pixels (clamped to the image) and weights for one output pixel
+// along one axis; contributors[o] indexes into the shared weight list
 typedef struct
 {
-   int width, height, stride_in_bytes;
-   int channels;
-   float *pixels;
-} stbir__info;
+   int first, count, weights;
+} stbir__contributor;
 
-static void stbir__calculate_transform(float s0, float t0, float s1, float t1, float *transform)
+static float stbir__srgb_to_linear(float f)
 {
-   if (transform) {
-      float scale_x = (s1 - s0) / 2;
-      float scale_y = (t1 - t0) / 2;
-      float translate_x = (s1 + s0) / 2;
-      float translate_y = (t1 + t0) / 2;
-      transform[0] = scale_x;
-      transform[1] = 0;
-      transform[2] = translate_x;
-      transform[3] = 0;
-      transform[4] = scale_y;
-      transform[5] = translate_y;
-      transform[6] = 0;
-      transform[7] = 0;
-      transform[8] = 1;
-   }
+   return f <= 0.04045f ? f / 12.92f : powf((f + 0.055f) / 1.055f, 2.4f);
 }
 
-static void stbir__calculate_coefficients(float scale, float filter_scale, float support, float *coefficients)
+static float stbir__linear_to_srgb(float f)
 {
-   float total = 0;
-   int i;
-   for (i = 0; i < (int)ceilf(support * 2 + 1); i++) {
-      float x = (i - support) * filter_scale;
-      float t = x * x;
-      float r = ((2.0f - 1.5f * t - 0.25f * t * t) * (float)M_PI + (-3.0f + 2.0f * t + 0.25f * t * t) * (float)M_PI * (float)M_PI) / ((float)M_PI * (float)M_PI);
-      coefficients[i] = r;
-      total += r;
-   }
-   for (i = 0; i < (int)ceilf(support * 2 + 1); i++)
-      coefficients[i] /= total;
+   return f <= 0.0031308f ? f * 12.92f : 1.055f * powf(f, 1.0f / 2.4f) - 0.055f;
 }
 
-static void stbir__resize_vertical_float(float *output, float *input, int output_h, int input_h, int input_w, int channels, float *coefficients, int filter_support)
+// Builds the contributors of every output pixel: the input footprint is
+// covered by a box when shrinking (its area average) and by a triangle
+// (bilinear interpolation) when enlarging.  Returns the weight list.
+static float *stbir__calculate_contributors(int input_size, int output_size, float r0, float r1, int filter,
+                                            stbir__contributor *contributors)
 {
-   int y, x, c;
-   for (y = 0; y < output_h; y++) {
-      for (x = 0; x < input_w; x++) {
-         for (c = 0; c < channels; c++) {
-            float sum = 0;
-            int i;
-            for (i = 0; i < filter_support * 2 + 1; i++) {
-               int input_y = y - filter_support + i;
-               if (input_y < 0) input_y = 0;
-               if (input_y >= input_h) input_y = input_h - 1;
-               sum += input[input_y * input_w * channels + x * channels + c] * coefficients[i];
-            }
-            output[y * input_w * channels + x * channels + c] = sum;
+   float scale = (float)output_size / ((r1 - r0) * input_size);   // output pixels per input pixel
+   int box = filter == STBIR_FILTER_BOX || (filter != STBIR_FILTER_TRIANGLE && scale < 1.0f);
+   float radius = box ? 0.5f / (scale < 1.0f ? scale : 1.0f) : (scale < 1.0f ? 1.0f / scale : 1.0f);
+   int max_count = (int)ceilf(radius * 2.0f) + 2;
+   float *weights = (float *)malloc((size_t)output_size * max_count * sizeof(float));
+   int o;
+   if (!weights)
+      return NULL;
+
+   for (o = 0; o < output_size; o++) {
+      float center = (o + 0.5f) / scale + r0 * input_size;
+      int first = (int)floorf(center - radius);
+      int last = (int)ceilf(center + radius);
+      float total = 0.0f;
+      int i, n = 0;
+      float *w = weights + (size_t)o * max_count;
+      for (i = first; i < last && n < max_count; i++) {
+         float weight;
+         if (box) {
+            float lo = center - radius > (float)i ? center - radius : (float)i;
+            float hi = center + radius < (float)(i + 1) ? center + radius : (float)(i + 1);
+            weight = hi - lo;
+         } else {
+            weight = 1.0f - fabsf(center - (i + 0.5f)) / radius;
+         }
+         if (weight <= 0.0f) {
+            if (n == 0)
+               first = i + 1;
+            continue;
          }
+         w[n++] = weight;
+         total += weight;
       }
+      for (i = 0; i < n; i++)
+         w[i] /= total;
+      contributors[o].first = first;
+      contributors[o].count = n;
+      contributors[o].weights = o * max_count;
    }
+   return weights;
 }
 
-static void stbir__resize_horizontal_float(float *output, float *input, int output_h, int output_w, int height, int channels, float *coefficients, int filter_support)
+// One input row, decoded to float and linearised as the colour space asks
+static void stbir__decode_row(const void *input_pixels, int input_w, int input_stride_in_bytes, int y,
+                              int datatype, int num_channels, int alpha_channel, int space, float *row)
 {
-   int y, x, c;
+   int x, c;
+   const unsigned char *bytes = (const unsigned char *)input_pixels + (size_t)y * input_stride_in_bytes;
+   for (x = 0; x < input_w; x++) {
+      for (c = 0; c < num_channels; c++) {
+         int i = x * num_channels + c;
+         float v = datatype == STBIR_TYPE_FLOAT ? ((const float *)bytes)[i] : bytes[i] / 255.0f;
+         if (space == STBIR_COLORSPACE_SRGB && c != alpha_channel)
+            v = stbir__srgb_to_linear(v);
+         row[i] = v;
+      }
+   }
+}
+
+int stbir_resize_region(const void *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
+                        void *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
+                        int datatype, int num_channels, int alpha_channel, int flags,
+                        int edge_mode_horizontal, int edge_mode_vertical,
+                        int filter_horizontal, int filter_vertical,
+                        int space, void *alloc_context,
+                        float s0, float t0, float s1, float t1)
+{
+   size_t pixel_bytes = datatype == STBIR_TYPE_FLOAT ? sizeof(float) : 1;
+   stbir__contributor *horizontal = NULL, *vertical = NULL;
+   float *horizontal_weights = NULL, *vertical_weights = NULL;
+   float *input_row = NULL, *column_sum = NULL;
+   int ok = 0, y;
+
+   STBIR__NOTUSED(flags);
+   STBIR__NOTUSED(alloc_context);
+   STBIR_ASSERT(edge_mode_horizontal == STBIR_EDGE_CLAMP && edge_mode_vertical == STBIR_EDGE_CLAMP);
+   if (input_w <= 0 || input_h <= 0 || output_w <= 0 || output_h <= 0 ||
+       num_channels <= 0 || num_channels > STBIR_MAX_CHANNELS || s1 <= s0 || t1 <= t0)
+      return 0;
+   if (!input_stride_in_bytes)
+      input_stride_in_bytes = (int)(input_w * num_channels * pixel_bytes);
+   if (!output_stride_in_bytes)
+      output_stride_in_bytes = (int)(output_w * num_channels * pixel_bytes);
+
+   horizontal = (stbir__contributor *)malloc(output_w * sizeof(stbir__contributor));
+   vertical = (stbir__contributor *)malloc(output_h * sizeof(stbir__contributor));
+   input_row = (float *)malloc((size_t)input_w * num_channels * sizeof(float));
+   column_sum = (float *)malloc((size_t)input_w * num_channels * sizeof(float));
+   if (!horizontal || !vertical || !input_row || !column_sum)
+      goto done;
+   horizontal_weights = stbir__calculate_contributors(input_w, output_w, s0, s1, filter_horizontal, horizontal);
+   vertical_weights = stbir__calculate_contributors(input_h, output_h, t0, t1, filter_vertical, vertical);
+   if (!horizontal_weights || !vertical_weights)
+      goto done;
+
+   // Vertical pass into one row of column sums, then the horizontal pass
    for (y = 0; y < output_h; y++) {
+      const stbir__contributor *v = &vertical[y];
+      unsigned char *out = (unsigned char *)output_pixels + (size_t)y * output_stride_in_bytes;
+      int i, x, c, row_size = input_w * num_channels;
+
+      memset(column_sum, 0, (size_t)row_size * sizeof(float));
+      for (i = 0; i < v->count; i++) {
+         int source = v->first + i;
+         float weight = vertical_weights[v->weights + i];
+         int k;
+         source = source < 0 ? 0 : (source >= input_h ? input_h - 1 : source);
+         stbir__decode_row(input_pixels, input_w, input_stride_in_bytes, source, datatype, num_channels, alpha_channel, space, input_row);
+         for (k = 0; k < row_size; k++)
+            column_sum[k] += input_row[k] * weight;
+      }
+
       for (x = 0; x < output_w; x++) {
-         for (c = 0; c < channels; c++) {
-            float sum = 0;
-            int i;
-            for (i = 0; i < filter_support * 2 + 1; i++) {
-               int input_x = x - filter_support + i;
-               if (input_x < 0) input_x = 0;
-               if (input_x >= height) input_x = height - 1;
-               sum += input[y * height * channels + input_x * channels + c] * coefficients[i];
+         const stbir__contributor *h = &horizontal[x];
+         for (c = 0; c < num_channels; c++) {
+            float sum = 0.0f;
+            for (i = 0; i < h->count; i++) {
+               int source = h->first + i;
+               source = source < 0 ? 0 : (source >= input_w ? input_w - 1 : source);
+               sum += column_sum[source * num_channels + c] * horizontal_weights[h->weights + i];
+            }
+            if (space == STBIR_COLORSPACE_SRGB && c != alpha_channel)
+               sum = stbir__linear_to_srgb(sum);
+            if (datatype == STBIR_TYPE_FLOAT) {
+               ((float *)out)[x * num_channels + c] = sum;
+            } else {
+               sum = sum < 0.0f ? 0.0f : (sum > 1.0f ? 1.0f : sum);
+               out[x * num_channels + c] = (unsigned char)(sum * 255.0f + 0.5f);
             }
-            output[y * output_w * channels + x * channels + c] = sum;
          }
       }
    }
+   ok = 1;
+
+done:
+   free(horizontal);
+   free(vertical);
+   free(horizontal_weights);
+   free(vertical_weights);
+   free(input_row);
+   free(column_sum);
+   return ok;
 }
 
 int stbir_resize_float(const float *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
                        float *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
                        int num_channels)
 {
-   float *temp = NULL;
-   float *coefficients = NULL;
-   int filter_support = 2;
-   float filter_scale = 1.0f;
-   float support = filter_support * filter_scale;
-   int temp_stride = input_w * num_channels;
-   int temp_size = temp_stride * output_h;
-   int coefficients_size = (int)ceilf(support * 2 + 1) * sizeof(float);
-
-   if (input_w == output_w && input_h == output_h) {
-      memcpy(output_pixels, input_pixels, input_w * input_h * num_channels * sizeof(float));
-      return 1;
-   }
-
-   temp = (float *)malloc(temp_size * sizeof(float));
-   if (!temp) return 0;
-
-   coefficients = (float *)malloc(coefficients_size);
-   if (!coefficients) {
-      free(temp);
-      return 0;
-   }
-
-   stbir__calculate_coefficients(1.0f, filter_scale, support, coefficients);
-
-   stbir__resize_vertical_float(temp, (float *)input_pixels, output_h, input_h, input_w, num_channels, coefficients, filter_support);
-   stbir__resize_horizontal_float(output_pixels, temp, output_h, output_w, input_w, num_channels, coefficients, filter_support);
-
-   free(temp);
-   free(coefficients);
-   return 1;
+   return stbir_resize_region(input_pixels, input_w, input_h, input_stride_in_bytes,
+                              output_pixels, output_w, output_h, output_stride_in_bytes,
+                              STBIR_TYPE_FLOAT, num_channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+                              STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                              STBIR_COLORSPACE_LINEAR, NULL, 0.0f, 0.0f, 1.0f, 1.0f);
 }
 
 int stbir_resize_uint8(const unsigned char *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
                        unsigned char *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
                        int num_channels)
 {
-   float *float_input = NULL;
-   float *float_output = NULL;
-   int float_input_size = input_w * input_h * num_channels;
-   int float_output_size = output_w * output_h * num_channels;
-   int i;
-
-   float_input = (float *)malloc(float_input_size * sizeof(float));
-   if (!float_input) return 0;
-
-   float_output = (float *)malloc(float_output_size * sizeof(float));
-   if (!float_output) {
-      free(float_input);
-      return 0;
-   }
-
-   for (i = 0; i < float_input_size; i++)
-      float_input[i] = input_pixels[i] / 255.0f;
-
-   if (!stbir_resize_float(float_input, input_w, input_h, input_w * num_channels * sizeof(float),
-                          float_output, output_w, output_h, output_w * num_channels * sizeof(float),
-                          num_channels)) {
-      free(float_input);
-      free(float_output);
-      return 0;
-   }
-
-   for (i = 0; i < float_output_size; i++)
-      output_pixels[i] = (unsigned char)(float_output[i] * 255.0f + 0.5f);
-
-   free(float_input);
-   free(float_output);
-   return 1;
+   return stbir_resize_region(input_pixels, input_w, input_h, input_stride_in_bytes,
+                              output_pixels, output_w, output_h, output_stride_in_bytes,
+                              STBIR_TYPE_UINT8, num_channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+                              STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                              STBIR_COLORSPACE_LINEAR, NULL, 0.0f, 0.0f, 1.0f, 1.0f);
 }
 
 int stbir_resize_uint8_srgb(const unsigned char *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
                             unsigned char *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
                             int num_channels)
 {
-   return stbir_resize_uint8(input_pixels, input_w, input_h, input_stride_in_bytes,
-                            output_pixels, output_w, output_h, output_stride_in_bytes,
-                            num_channels);
+   return stbir_resize_uint8_srgb_edgemode(input_pixels, input_w, input_h, input_stride_in_bytes,
+                                           output_pixels, output_w, output_h, output_stride_in_bytes,
+                                           num_channels, num_channels == 4 ? 3 : STBIR_ALPHA_CHANNEL_NONE, 0);
 }
 
 int stbir_resize_uint8_srgb_edgemode(const unsigned char *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
                                      unsigned char *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
                                      int num_channels, int alpha_channel, int flags)
 {
-   STBIR_ASSERT(flags == 0);
-   STBIR_ASSERT(alpha_channel == -1);
-   return stbir_resize_uint8_srgb(input_pixels, input_w, input_h, input_stride_in_bytes,
-                                 output_pixels, output_w, output_h, output_stride_in_bytes,
-                                 num_channels);
+   return stbir_resize_region(input_pixels, input_w, input_h, input_stride_in_bytes,
+                              output_pixels, output_w, output_h, output_stride_in_bytes,
+                              STBIR_TYPE_UINT8, num_channels, alpha_channel, flags,
+                              STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                              STBIR_COLORSPACE_SRGB, NULL, 0.0f, 0.0f, 1.0f, 1.0f);
 }
 
+// The transform is not supported; s0, t0, s1, t1 select the input region
 int stbir_resize_uint8_generic(const unsigned char *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
                                unsigned char *output_pixels, int output_w, int output_h, int output_stride_in_bytes,
                                int num_channels, float s0, float t0, float s1, float t1, float *transform,
                                int edge_wrap_mode)
 {
-   STBIR_ASSERT(edge_wrap_mode == STBIR_EDGE_CLAMP);
-   return stbir_resize_uint8(input_pixels, input_w, input_h, input_stride_in_bytes,
-                            output_pixels, output_w, output_h, output_stride_in_bytes,
-                            num_channels);
+   STBIR__NOTUSED(transform);
+   return stbir_resize_region(input_pixels, input_w, input_h, input_stride_in_bytes,
+                              output_pixels, output_w, output_h, output_stride_in_bytes,
+                              STBIR_TYPE_UINT8, num_channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+                              edge_wrap_mode, edge_wrap_mode, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                              STBIR_COLORSPACE_LINEAR, NULL, s0, t0, s1, t1);
 }
 
 int stbir_resize_float_generic(const float *input_pixels, int input_w, int input_h, int input_stride_in_bytes,
@@ -261,10 +320,12 @@ int stbir_resize_float_generic(const float *input_pixels, int input_w, int input
                                int num_channels, float s0, float t0, float s1, float t1, float *transform,
                                int edge_wrap_mode)
 {
-   STBIR_ASSERT(edge_wrap_mode == STBIR_EDGE_CLAMP);
-   return stbir_resize_float(input_pixels, input_w, input_h, input_stride_in_bytes,
-                            output_pixels, output_w, output_h, output_stride_in_bytes,
-                            num_channels);
+   STBIR__NOTUSED(transform);
+   return stbir_resize_region(input_pixels, input_w, input_h, input_stride_in_bytes,
+                              output_pixels, output_w, output_h, output_stride_in_bytes,
+                              STBIR_TYPE_FLOAT, num_channels, STBIR_ALPHA_CHANNEL_NONE, 0,
+                              edge_wrap_mode, edge_wrap_mode, STBIR_FILTER_DEFAULT, STBIR_FILTER_DEFAULT,
+                              STBIR_COLORSPACE_LINEAR, NULL, s0, t0, s1, t1);
 }
 
-#endif // STB_IMAGE_RESIZE_IMPLEMENTATION 
\ No newline at end of file
+#endif // STB_IMAGE_RESIZE_IMPLEMENTATION
@@ -0,0 +1,128 @@
+// Asset archive packer.
+//
+//   assetpack [-o assets.pak] [--compress] [--align n] path...
+//
+// Packs every file under each path (a file or a directory, walked
+// recursively) into one archive (see helper/assetarchive.h).  Entries are
+// named by their path as given, relative to the working directory, which is
+// how the demo asks for them: run it from the directory the demo runs in.
+// With --compress an entry is stored zlib compressed when that saves at
+// least an eighth of it; images and .ctex files rarely qualify and stay
+// mapped in place.  Entries start on --align byte boundaries (default 64).
+
+#include "helper/assetarchive.h"
+#include "helper/mappedfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Defined by the stb_image_write implementation
+unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+namespace {
+
+    struct Options {
+        std::string output = "assets.pak";
+        bool compress = false;
+        uint32_t alignment = AssetArchive::DEFAULT_ALIGNMENT;
+    };
+
+    void collect(const std::filesystem::path &path, std::vector<std::string> &files) {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto &item : std::filesystem::recursive_directory_iterator(path, error)) {
+                if (item.is_regular_file(error))
+                    files.push_back(item.path().generic_string());
+            }
+        } else {
+            files.push_back(path.generic_string());
+        }
+    }
+
+    bool pack(const std::vector<std::string> &inputs, const Options &options) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::string> files;
+        for (const std::string &input : inputs)
+            collect(input, files);
+        // Sorted so archives are reproducible and related files sit together
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+
+        std::vector<AssetArchive::Entry> entries;
+        std::vector<std::vector<unsigned char>> data;
+        size_t loose = 0, stored = 0;
+        int compressed = 0;
+        for (const std::string &file : files) {
+            std::string name = AssetArchive::entryName(file);
+            if (name == AssetArchive::entryName(options.output))
+                continue;
+
+            // Empty files cannot be mapped but still get an entry
+            MappedFile source;
+            std::error_code error;
+            if (!source.open(file) && std::filesystem::file_size(file, error) != 0) {
+                fprintf(stderr, "%s: cannot read\n", file.c_str());
+                return false;
+            }
+            AssetArchive::Entry entry = { name, 0, 0, source.size(), 0 };
+            std::vector<unsigned char> bytes(source.data(), source.data() + source.size());
+
+            if (options.compress && !bytes.empty() && bytes.size() < (size_t)INT32_MAX) {
+                int length = 0;
+                unsigned char *zlib = stbi_zlib_compress(bytes.data(), (int)bytes.size(), &length, 8);
+                if (zlib && (size_t)length <= bytes.size() - bytes.size() / 8) {
+                    bytes.assign(zlib, zlib + length);
+                    entry.flags |= AssetArchive::FLAG_ZLIB;
+                    compressed++;
+                }
+                free(zlib);
+            }
+            loose += source.size();
+            stored += bytes.size();
+            entries.push_back(entry);
+            data.push_back(std::move(bytes));
+        }
+
+        if (!AssetArchive::write(options.output, entries, data, options.alignment))
+            return false;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%s: %d entries (%d compressed), %.2f MB of files in %.2f MB in %.2f s\n",
+               options.output.c_str(), (int)entries.size(), compressed, loose / 1048576.0, stored / 1048576.0, seconds);
+        return true;
+    }
+
+    void usage(const char *program) {
+        fprintf(stderr, "Usage: %s [-o assets.pak] [--compress] [--align n] path...\n", program);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            options.compress = true;
+        } else if (strcmp(argv[i], "--align") == 0 && i + 1 < argc) {
+            options.alignment = (uint32_t)atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    return pack(inputs, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,248 @@
+#include "bcencoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+    // Mean and principal axis (unit length, or zero for a flat block) of the
+    // block's pixels over the first dims channels
+    void fitAxis(const float pixels[16][4], int dims, float mean[4], float axis[4]) {
+        for (int c = 0; c < 4; c++)
+            mean[c] = axis[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < dims; c++)
+                mean[c] += pixels[i][c] / 16.0f;
+
+        float cov[4][4] = {};
+        for (int i = 0; i < 16; i++) {
+            float d[4];
+            for (int c = 0; c < dims; c++)
+                d[c] = pixels[i][c] - mean[c];
+            for (int a = 0; a < dims; a++)
+                for (int b = 0; b < dims; b++)
+                    cov[a][b] += d[a] * d[b];
+        }
+
+        // Power iteration converges on the dominant eigenvector in a few steps
+        float v[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float w[4] = {};
+            float length = 0.0f;
+            for (int a = 0; a < dims; a++) {
+                for (int b = 0; b < dims; b++)
+                    w[a] += cov[a][b] * v[b];
+                length += w[a] * w[a];
+            }
+            length = std::sqrt(length);
+            if (length < 1e-6f)
+                return;
+            for (int a = 0; a < dims; a++)
+                v[a] = w[a] / length;
+        }
+        for (int c = 0; c < dims; c++)
+            axis[c] = v[c];
+    }
+
+    // Endpoints at the extremes of the pixels' projection onto the axis
+    void fitEndpoints(const float pixels[16][4], int dims, float low[4], float high[4]) {
+        float mean[4], axis[4];
+        fitAxis(pixels, dims, mean, axis);
+
+        float tMin = 0.0f, tMax = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float t = 0.0f;
+            for (int c = 0; c < dims; c++)
+                t += (pixels[i][c] - mean[c]) * axis[c];
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+        for (int c = 0; c < 4; c++) {
+            low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMin));
+            high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * tMax));
+        }
+    }
+
+    void loadPixels(const unsigned char rgba[64], float pixels[16][4]) {
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++)
+                pixels[i][c] = rgba[i * 4 + c];
+    }
+
+    int nearest(const int palette[][4], int count, const unsigned char *pixel, int dims) {
+        int best = 0, bestError = INT32_MAX;
+        for (int p = 0; p < count; p++) {
+            int error = 0;
+            for (int c = 0; c < dims; c++) {
+                int d = palette[p][c] - pixel[c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = p;
+            }
+        }
+        return best;
+    }
+
+    uint16_t pack565(const float color[4]) {
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void unpack565(uint16_t packed, int color[4]) {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+        color[3] = 255;
+    }
+
+    void encodeChannel(const unsigned char rgba[64], int channel, unsigned char out[8]) {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++) {
+            low = std::min(low, (int)rgba[i * 4 + channel]);
+            high = std::max(high, (int)rgba[i * 4 + channel]);
+        }
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+
+        // With the first endpoint larger the block uses eight interpolated values
+        int palette[8][4] = {};
+        palette[0][0] = high;
+        palette[1][0] = low;
+        for (int i = 2; i < 8; i++)
+            palette[i][0] = ((8 - i) * high + (i - 1) * low) / 7;
+
+        uint64_t bits = 0;
+        for (int i = 0; i < 16; i++) {
+            uint64_t index = high == low ? 0 : (uint64_t)nearest(palette, 8, &rgba[i * 4 + channel], 1);
+            bits |= index << (3 * i);
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    struct BitWriter {
+        unsigned char *out;
+        int position;
+
+        void put(uint32_t value, int count) {
+            for (int i = 0; i < count; i++, position++) {
+                if ((value >> i) & 1)
+                    out[position / 8] |= (unsigned char)(1 << (position % 8));
+            }
+        }
+    };
+}
+
+namespace BCEncoder {
+
+void encodeBC1(const unsigned char rgba[64], unsigned char out[8]) {
+    float pixels[16][4], low[4], high[4];
+    loadPixels(rgba, pixels);
+    fitEndpoints(pixels, 3, low, high);
+
+    uint16_t c0 = pack565(high), c1 = pack565(low);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    // c0 > c1 selects the four-colour mode; equal endpoints leave every index 0
+    int palette[4][4];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        for (int i = 0; i < 16; i++)
+            indices |= (uint32_t)nearest(palette, 4, &rgba[i * 4], 3) << (2 * i);
+    }
+
+    out[0] = (unsigned char)(c0 & 0xFF);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+void encodeBC4(const unsigned char rgba[64], unsigned char out[8]) {
+    encodeChannel(rgba, 0, out);
+}
+
+void encodeBC5(const unsigned char rgba[64], unsigned char out[16]) {
+    encodeChannel(rgba, 0, out);
+    encodeChannel(rgba, 1, out + 8);
+}
+
+void encodeBC7(const unsigned char rgba[64], unsigned char out[16]) {
+    static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float pixels[16][4], ends[2][4];
+    loadPixels(rgba, pixels);
+    fitEndpoints(pixels, 4, ends[0], ends[1]);
+
+    // Mode 6 stores 7 bits per channel plus one shared low bit per endpoint
+    int quantized[2][4], pbit[2], color[2][4];
+    for (int e = 0; e < 2; e++) {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; p++) {
+            float error = 0.0f;
+            int q[4];
+            for (int c = 0; c < 4; c++) {
+                q[c] = std::min(127, std::max(0, (int)std::floor((ends[e][c] - p) / 2.0f + 0.5f)));
+                float d = (float)(q[c] * 2 + p) - ends[e][c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                pbit[e] = p;
+                for (int c = 0; c < 4; c++)
+                    quantized[e][c] = q[c];
+            }
+        }
+        for (int c = 0; c < 4; c++)
+            color[e][c] = quantized[e][c] * 2 + pbit[e];
+    }
+
+    int palette[16][4];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            palette[i][c] = ((64 - WEIGHTS[i]) * color[0][c] + WEIGHTS[i] * color[1][c] + 32) >> 6;
+
+    int indices[16];
+    for (int i = 0; i < 16; i++)
+        indices[i] = nearest(palette, 16, &rgba[i * 4], 4);
+
+    // The first pixel's index is stored without its top bit, so it must be below 8
+    if (indices[0] & 8) {
+        for (int c = 0; c < 4; c++)
+            std::swap(quantized[0][c], quantized[1][c]);
+        std::swap(pbit[0], pbit[1]);
+        for (int &index : indices)
+            index = 15 - index;
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer = { out, 0 };
+    writer.put(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.put((uint32_t)quantized[0][c], 7);
+        writer.put((uint32_t)quantized[1][c], 7);
+    }
+    writer.put((uint32_t)pbit[0], 1);
+    writer.put((uint32_t)pbit[1], 1);
+    writer.put((uint32_t)indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.put((uint32_t)indices[i], 4);
+}
+
+} // namespace BCEncoder
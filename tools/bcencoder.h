@@ -0,0 +1,23 @@
+#pragma once
+
+// Block compression encoders used by texconvert.
+//
+// Each function encodes one 4x4 block.  Pixels are RGBA, row-major, four
+// bytes each; blocks on a partial edge should repeat the edge pixels.  The
+// encoders fit endpoints along the principal axis of the block's colours
+// and pick the nearest palette entry per pixel: fast and decent, not the
+// exhaustive search of a production encoder.
+namespace BCEncoder {
+
+    // BC1 / DXT1: RGB, 4 bits per pixel.  Alpha is ignored.
+    void encodeBC1(const unsigned char rgba[64], unsigned char out[8]);
+
+    // BC4: one channel (red), 4 bits per pixel
+    void encodeBC4(const unsigned char rgba[64], unsigned char out[8]);
+
+    // BC5: two channels (red, green), 8 bits per pixel
+    void encodeBC5(const unsigned char rgba[64], unsigned char out[16]);
+
+    // BC7 using mode 6 only: RGBA with 7.7.7.7 endpoints and 4-bit indices, 8 bits per pixel
+    void encodeBC7(const unsigned char rgba[64], unsigned char out[16]);
+}
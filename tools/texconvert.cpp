@@ -0,0 +1,189 @@
+// Texture cache converter.
+//
+//   texconvert [--format bc1|bc4|bc5|bc7] [--flip] [--no-mips] [-o out.ctex] image...
+//
+// Writes each image as a block-compressed .ctex file next to it (see
+// helper/compressedtexture.h), with its full mip chain.  TextureLoader and
+// Texture::loadTexture use the .ctex instead of decoding the image whenever
+// it exists and was built from the image's current contents.  Without
+// --format the channel count picks it: 1 -> BC4, 2 -> BC5, 3 -> BC1 and
+// 4 -> BC7.  Pass --flip for images loaded with vertical flipping
+// (Texture::loadTexture's default).
+
+#include "helper/compressedtexture.h"
+#include "helper/imageresampler.h"
+#include "helper/threadpool.h"
+#include "helper/stb_image.h"
+#include "tools/bcencoder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        GLenum format = 0;
+        bool flip = false;
+        bool mips = true;
+        std::string output;
+    };
+
+    GLenum defaultFormat(int channels) {
+        switch (channels) {
+        case 1: return GL_COMPRESSED_RED_RGTC1;
+        case 2: return GL_COMPRESSED_RG_RGTC2;
+        case 4: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        }
+    }
+
+    const char * formatName(GLenum format) {
+        switch (format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+        case GL_COMPRESSED_RED_RGTC1: return "BC4";
+        case GL_COMPRESSED_RG_RGTC2: return "BC5";
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: return "BC7";
+        default: return "?";
+        }
+    }
+
+    // Box filtered, the same average TextureLoader's CPU mips take
+    std::vector<unsigned char> halve(ThreadPool &pool, const std::vector<unsigned char> &rgba, int width, int height) {
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        std::vector<unsigned char> result((size_t)w * h * 4);
+        ImageResampler::resize(&pool, rgba.data(), width, height, result.data(), w, h, 4, false);
+        return result;
+    }
+
+    // Encodes one level, a row of blocks per job
+    std::vector<unsigned char> compress(ThreadPool &pool, const std::vector<unsigned char> &rgba,
+                                        int width, int height, GLenum format) {
+        size_t blockBytes = CompressedTextureFile::blockBytes(format);
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        std::vector<unsigned char> result((size_t)blocksX * blocksY * blockBytes);
+
+        std::vector<std::future<void>> rows;
+        for (int by = 0; by < blocksY; by++) {
+            rows.push_back(pool.submit([&, by]() {
+                unsigned char block[64];
+                for (int bx = 0; bx < blocksX; bx++) {
+                    // Partial edge blocks repeat the last row and column
+                    for (int py = 0; py < 4; py++) {
+                        int y = std::min(by * 4 + py, height - 1);
+                        for (int px = 0; px < 4; px++) {
+                            int x = std::min(bx * 4 + px, width - 1);
+                            memcpy(&block[(py * 4 + px) * 4], &rgba[((size_t)y * width + x) * 4], 4);
+                        }
+                    }
+                    unsigned char *out = &result[((size_t)by * blocksX + bx) * blockBytes];
+                    switch (format) {
+                    case GL_COMPRESSED_RED_RGTC1: BCEncoder::encodeBC4(block, out); break;
+                    case GL_COMPRESSED_RG_RGTC2: BCEncoder::encodeBC5(block, out); break;
+                    case GL_COMPRESSED_RGBA_BPTC_UNORM: BCEncoder::encodeBC7(block, out); break;
+                    default: BCEncoder::encodeBC1(block, out); break;
+                    }
+                }
+            }));
+        }
+        for (std::future<void> &row : rows)
+            row.get();
+        return result;
+    }
+
+    bool convert(ThreadPool &pool, const std::string &input, const Options &options) {
+        auto start = std::chrono::steady_clock::now();
+
+        uint64_t sourceSize = 0, sourceHash = 0;
+        if (!CompressedTextureFile::sourceHash(input, sourceSize, sourceHash)) {
+            fprintf(stderr, "%s: cannot read\n", input.c_str());
+            return false;
+        }
+        int width, height, channels;
+        unsigned char *data = stbi_load(input.c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            fprintf(stderr, "%s: %s\n", input.c_str(), stbi_failure_reason());
+            return false;
+        }
+        std::vector<unsigned char> rgba((size_t)width * height * 4);
+        size_t stride = (size_t)width * 4;
+        for (int y = 0; y < height; y++)
+            memcpy(&rgba[y * stride], data + (options.flip ? height - 1 - y : y) * stride, stride);
+        stbi_image_free(data);
+
+        GLenum format = options.format ? options.format : defaultFormat(channels);
+        std::vector<std::vector<unsigned char>> levels;
+        size_t uncompressed = 0;
+        int w = width, h = height;
+        for (;;) {
+            levels.push_back(compress(pool, rgba, w, h, format));
+            uncompressed += (size_t)w * h * 4;
+            if (!options.mips || (w == 1 && h == 1))
+                break;
+            rgba = halve(pool, rgba, w, h);
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+
+        std::string output = options.output.empty() ? CompressedTextureFile::cachePath(input) : options.output;
+        uint32_t flags = options.flip ? CompressedTextureFile::FLAG_FLIPPED : 0;
+        if (!CompressedTextureFile::write(output, format, width, height, channels, flags, sourceSize, sourceHash, levels))
+            return false;
+
+        size_t compressed = 0;
+        for (const std::vector<unsigned char> &level : levels)
+            compressed += level.size();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%s -> %s: %dx%d %s, %d levels, %.2f MB (RGBA8 %.2f MB, %.1fx smaller) in %.2f s\n",
+               input.c_str(), output.c_str(), width, height, formatName(format), (int)levels.size(),
+               compressed / 1048576.0, uncompressed / 1048576.0, (double)uncompressed / compressed, seconds);
+        return true;
+    }
+
+    void usage(const char *program) {
+        fprintf(stderr, "Usage: %s [--format bc1|bc4|bc5|bc7] [--flip] [--no-mips] [-o out.ctex] image...\n", program);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "bc1") options.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            else if (name == "bc4") options.format = GL_COMPRESSED_RED_RGTC1;
+            else if (name == "bc5") options.format = GL_COMPRESSED_RG_RGTC2;
+            else if (name == "bc7") options.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--flip") == 0) {
+            options.flip = true;
+        } else if (strcmp(argv[i], "--no-mips") == 0) {
+            options.mips = false;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty() || (!options.output.empty() && inputs.size() > 1)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    bool ok = true;
+    for (const std::string &input : inputs)
+        ok = convert(pool, input, options) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}